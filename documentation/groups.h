@@ -7,6 +7,9 @@
  *   @defgroup driver_counter Counter
  *   The Counter driver for millisecond-resolution time
  *
+ *   @defgroup driver_crc CRC
+ *   CRC-32 over flash and RAM on the CRC peripheral, fed by DMA
+ *
  *   @defgroup driver_debug Debug
  *
  *   @defgroup driver_exti EXTI
@@ -18,9 +21,24 @@
  *   @defgroup driver_filesystem Filesystem
  *   The Filesystem driver that interacts with Flash
  *
+ *   @defgroup driver_flash Flash
+ *   Flash erase and programming that runs from SRAM
+ *
+ *   @defgroup driver_kv KV Store
+ *   Log-structured key/value store holding the System Variables
+ *
+ *   @defgroup driver_lz LZ
+ *   Streaming LZSS decoder for compressed apps
+ *
+ *   @defgroup driver_mem Memory
+ *   Heap and stack usage reporting
+ *
  *   @defgroup driver_oled OLED
  *   The OLED display for ouputting to the display
  *
+ *   @defgroup driver_pt Protothreads
+ *   Stackless coroutines for driver sequences that wait
+ *
  *   @defgroup driver_speaker Speaker
  *   The Speaker driver
  *
@@ -58,6 +76,10 @@
  *   @defgroup feature_gesture Gesture Detection
  *   Gesture Detection detects advanced touchpanel input such as swipes.
  *
+ *   @defgroup feature_event Event Loop
+ *   The Event Loop dispatches events posted by interrupts to handlers
+ *   registered per event type, highest priority first, and sleeps when idle.
+ *
  *   @defgroup feature_power Power Management
  *   Power Management allows developers to easily put a Blox into a low power
  *   state and wake it up on various input events.
@@ -72,6 +94,7 @@
  * @{
  * @defgroup base_ui Base Program UI
  * @defgroup base_transfer Transfer
+ * @defgroup base_sim Host Simulator
  * @}
  * @defgroup blox_setup Blox Setup
  * @}
@@ -0,0 +1,52 @@
+/**
+ * @file    blox_crc.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   CRC-32 on the CRC peripheral, fed by DMA for long blocks, with a
+ *          software fallback that gives the same result.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BLOX_CRC_H
+#define __BLOX_CRC_H
+
+#include "blox_system.h"
+#include "stm32f10x_crc.h"
+#include "stm32f10x_dma.h"
+#include "stm32f10x_rcc.h"
+
+/**
+ * @ingroup driver_crc
+ * @{
+ */
+#define CRC_DMA_CHANNEL     DMA2_Channel5
+#define CRC_DMA_FLAG_TC     DMA2_FLAG_TC5
+#define CRC_DMA_CLK         RCC_AHBPeriph_DMA2
+#define CRC_DMA_MIN_WORDS   64      /**< Shorter blocks are fed by the CPU */
+#define CRC_NONE            0xFFFFFFFF  /**< Stands for no CRC having been stored */
+
+void Blox_CRC_Init(void);
+uint32_t Blox_CRC_Calc(const uint32_t *data, uint32_t words);
+uint32_t Blox_CRC_Software(const uint32_t *data, uint32_t words);
+/** @} */
+#endif
@@ -30,7 +30,10 @@
 #define __BLOX_FILESYSTEM_H
 
 #include "blox_system.h"
-#include "stm32f10x_flash.h"
+#include "blox_flash.h"
+#include "blox_kv.h"
+#include "blox_lz.h"
+#include "blox_crc.h"
 #include "misc.h"
 
 #include "string.h"
@@ -44,7 +47,9 @@
  * @brief Enum containing the status of the filesystem.
  */
 typedef enum {
-  FS_CREATE_FAIL = -6,
+  FS_BAD_IMAGE = -8,
+  FS_NO_MEM,
+  FS_CREATE_FAIL,
   FS_BAD_WRITE,
 	FS_FULL,
 	FS_FILE_NOT_INIT,
@@ -57,10 +62,35 @@ typedef enum {
  * For our processor, Flash goes from 0x08000000 - 0x08080000, 512K 
  * 512K total, 2K page, 4K sector size
  */
-#define FS_MAX_FILES 16
-#define FS_MAGIC 0xdeadbeef
+#define FS_DIR_PAGES 4            /**< Directory pages in use, the rest of the pool are spares */
+#define FS_DIR_POOL (MEM_DIR_SIZE/PAGE_SIZE)
+#define FS_DIR_SPARES (FS_DIR_POOL - FS_DIR_PAGES)  /**< Directory pages one FS_Commit can write */
+#define FS_DIR_PER_PAGE (PAGE_SIZE/sizeof(FS_File))
+#define FS_MAX_FILES (FS_DIR_PAGES*FS_DIR_PER_PAGE)
+#define FS_MAX_FREE (FS_MAX_FILES+1)
+#define FS_INDEX_SIZE 256         /**< Slots in the name index, more than FS_MAX_FILES */
+#define FS_MAGIC 0xdeadbef4
+#define FS_MAGIC_V1 0xdeadbeef  /**< FATs that packed files with no free list */
+#define FS_MAGIC_V2 0xdeadbef0  /**< FATs with a free list, kept in one page */
+#define FS_MAGIC_V3 0xdeadbef1  /**< FATs kept in two pages, with no file CRCs */
+#define FS_MAGIC_V4 0xdeadbef2  /**< FATs holding 16 files in the FAT page itself */
+#define FS_MAGIC_V5 0xdeadbef3  /**< FATs whose files carry no flags */
+#define FS_FLAG_DATA 0x01       /**< A data file, made by FS_Open */
+#define FS_FLAG_IN_PLACE 0x02   /**< An app linked to run where it is stored, made by RCV_APP_AT */
+#define FS_STORE_PAGES (MEM_STORE_SIZE/PAGE_SIZE)
+#define FS_STAGE_PAGES (MEM_START_SIZE/PAGE_SIZE)
+#define FS_WEAR_PER_KEY (KV_MAX_DATA/sizeof(uint16_t))
+#define FS_WEAR_KEYS ((FLASH_NUM_PAGES + FS_WEAR_PER_KEY - 1)/FS_WEAR_PER_KEY)
+#define FS_WEAR_SAVE_ERASES 16  /**< Erases between saves of the erase counts */
+#define FS_PREERASE_PAGES FS_STAGE_PAGES  /**< Free pages FS_PreErase keeps blank */
+#define FS_DATA_SLOTS 8          /**< Sync records at the end of each data file page */
+#define FS_DATA_PAYLOAD (PAGE_SIZE - FS_DATA_SLOTS*sizeof(uint16_t))
+#define FS_DATA_EXTENT 4         /**< Pages a data file is created with and grows by */
+#define FS_DATA_BUF_LEN 64       /**< Bytes FS_Append buffers before programming them */
+#define FS_LZ_MAGIC 0x315A4C42  /**< "BLZ1", never a valid initial stack pointer */
 #define FS_FILE_MAX_NAME_LEN 32
-#define FS_APP_FLAG_LOC 0x20005000
+#define FS_APP_FLAG_LOC MEM_KEEP_START
+#define FS_APP_ADDR_LOC (MEM_KEEP_START+4)  /**< Where the app to run was linked, kept across resets */
 
 /**
  * @brief Defines a file's header. Contains the id of the file
@@ -71,18 +101,81 @@ typedef struct {
 	uint8_t id;                       /**< The unique identifer of the file in the fs */
   char name[FS_FILE_MAX_NAME_LEN];  /**< a string name for the file */
 	uint8_t numPages;                 /**< the number of pages the application takes up */
+  uint8_t flags;                    /**< FS_FLAG_* bits, set when the file is created */
 	uint32_t *data;                   /**< a pointer to the data of the file */
+  uint32_t crc;                     /**< Blox_CRC_Calc of all the file's pages, CRC_NONE until sealed unless given at creation */
+  uint32_t hash;                    /**< FNV-1a of the name, checked before the name is */
 } FS_File;
 
 /**
- * @brief The table of all FS_Files.
+ * @brief A run of pages in the file store.
+ */
+typedef struct {
+  uint16_t page;      /**< the first page, counted from MEM_STORE_START */
+  uint16_t numPages;  /**< the number of pages in the run */
+} FS_Extent;
+
+/**
+ * @brief Header of an app stored compressed by misc/lzss.py. The LZSS
+ *        stream follows it, and is decompressed into staging at launch.
+ */
+typedef struct {
+  uint32_t magic;     /**< FS_LZ_MAGIC */
+  uint32_t size;      /**< the length of the app once decompressed */
+  uint32_t lzSize;    /**< the length of the compressed stream */
+  uint32_t crc;       /**< Blox_CRC_Calc of the decompressed app, padded to whole pages */
+} FS_LZHeader;
+
+/**
+ * @brief What is in the staging area, kept in the KV store under
+ *        KV_KEY_STAGE so relaunching an app only rewrites the pages that
+ *        changed.
+ */
+typedef struct {
+  uint32_t known;                   /**< Bit n is set if hash[n] matches staging page n */
+  uint32_t hash[FS_STAGE_PAGES];    /**< FS_HashPage of each staging page */
+} FS_StageRecord;
+
+/**
+ * @brief An open data file. Data files are ordinary files whose pages each
+ *        hold FS_DATA_PAYLOAD bytes followed by FS_DATA_SLOTS halfwords.
+ *        Appends are programmed into the payload as halfwords, and each
+ *        sync programs the next slot with how far the page is written, so
+ *        only data up to the last sync survives a reset. A page is done
+ *        when its payload is full or its slots run out. The handle finds
+ *        the file by name, so it stays good when the file is moved.
+ */
+typedef struct {
+  char name[FS_FILE_MAX_NAME_LEN];  /**< the name of the file */
+  uint32_t size;                    /**< the bytes in the file, buffered ones included */
+  uint16_t page;                    /**< the page of the file appends go to */
+  uint16_t pos;                     /**< where the buffer is programmed in that page */
+  uint16_t mark;                    /**< where the data since the last sync starts in that page */
+  uint8_t slot;                     /**< the next unused slot of that page */
+  uint8_t numBuf;                   /**< the bytes in buf */
+  uint8_t buf[FS_DATA_BUF_LEN];     /**< appended bytes not yet programmed */
+} FS_DataFile;
+
+/**
+ * @brief The FAT. Two copies are kept, at MEM_FAT_START and
+ *        MEM_FAT_ALT_START. Each change is written to the older copy, so
+ *        the live one is never erased, and the valid copy with the highest
+ *        seq is mounted. The FS_Files themselves are FS_DIR_PER_PAGE to a
+ *        page in directory pages taken from the pool at MEM_DIR_START; a
+ *        changed directory page is written to a spare page of the pool and
+ *        only takes effect with the FAT that points at it.
  */
 typedef struct {
   volatile uint32_t magic;            /**< a constant to validate the FS */
 	volatile uint32_t numFiles;         /**< the number of files in the FS */
-	uint32_t *free_top;                 /**< the top of the free memory area */
-  uint32_t free_numPages;             /**< the number of free pages left */
-	FS_File table[FS_MAX_FILES];	      /**< the table of FS_Files */
+  uint32_t numFree;                   /**< the number of runs in the free list */
+  uint32_t free_numPages;             /**< the number of free pages left, across all runs */
+  FS_Extent free[FS_MAX_FREE];        /**< the free runs, sorted by address, never adjacent */
+  uint32_t dir[FS_DIR_PAGES];         /**< the address of each directory page */
+  uint32_t dirCrc[FS_DIR_PAGES];      /**< Blox_CRC_Calc of the files in use in each directory page */
+  uint8_t index[FS_INDEX_SIZE];       /**< id+1 of the files, each in the first slot free from hash%FS_INDEX_SIZE on */
+  uint32_t seq;                       /**< incremented on every write of the FAT */
+  uint32_t crc;                       /**< CRC-32 of everything above, checked at mount */
 } FS_Table;
 
 
@@ -93,12 +186,23 @@ FS_File * FS_GetFileFromName(char *name);
 uint8_t FS_GetNumFiles(void);
 FS_STATUS FS_DeleteFile(uint8_t id);
 uint8_t FS_CreateFile(char *name, uint8_t numPages);
+uint8_t FS_CreateFileAt(char *name, uint8_t numPages, uint32_t *addr, uint32_t crc);
 FS_STATUS FS_WriteFilePage(uint8_t id, uint32_t *data, uint32_t page_offset);
+FS_STATUS FS_SealFile(uint8_t id);
+FS_STATUS FS_VerifyFile(const FS_File *file);
+FS_STATUS FS_Open(FS_DataFile *df, char *name);
+FS_STATUS FS_Append(FS_DataFile *df, const void *data, uint32_t len);
+uint32_t FS_Read(FS_DataFile *df, uint32_t offset, void *data, uint32_t len);
+FS_STATUS FS_Sync(FS_DataFile *df);
+void FS_SaveWear(void);
+void FS_PreErase(void);
 FS_STATUS FS_CreateFS(void);
+FS_STATUS FS_Compact(void);
 void FS_SwapPage(uint32_t *src, uint32_t *dst);
 uint32_t FS_RoundPageUp(uint32_t size);
+FS_STATUS FS_ChkImage(const uint32_t *page, uint32_t size);
 void FS_RunFile(uint8_t file_id);
-void FS_RunStage(void);
+void FS_RunApp(void);
 uint8_t FS_GetAppFlag(void);
 void FS_SetAppFlag(uint8_t val);
 /** @} */
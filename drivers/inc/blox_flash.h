@@ -0,0 +1,79 @@
+/**
+ * @file    blox_flash.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Contains function prototypes for the low-level flash driver.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BLOX_FLASH_H
+#define __BLOX_FLASH_H
+
+#include "blox_system.h"
+#include "stm32f10x_flash.h"
+#include "string.h"
+
+/**
+ * @ingroup driver_flash
+ * @{
+ */
+#define FLASH_MAX_DEFERRED 4
+#define FLASH_ERASED_HALF 0xFFFF
+#define FLASH_NUM_PAGES ((MEM_KV_START + MEM_KV_SIZE - MEM_MAP_START)/PAGE_SIZE)
+#define FLASH_PAGE(addr) (((uint32_t)(addr) - MEM_MAP_START)/PAGE_SIZE)
+
+/**
+ * @brief Counters kept by the flash driver since boot
+ */
+typedef struct {
+  uint32_t erases;          /**< Pages erased */
+  uint32_t erasesAvoided;   /**< Page writes that programmed over blank halfwords instead of erasing */
+  uint32_t unchanged;       /**< Page writes skipped because the page already held the data */
+  uint32_t halfWords;       /**< Halfwords programmed */
+} FLASH_Stats;
+
+/**
+ * @brief Erase counts over a range of pages
+ */
+typedef struct {
+  uint32_t total;           /**< Erases of all the pages */
+  uint16_t min;             /**< Erases of the least worn page */
+  uint16_t max;             /**< Erases of the most worn page */
+  uint32_t hottest;         /**< Address of the most worn page */
+} FLASH_Wear;
+
+void Blox_Flash_Unlock(void);
+void Blox_Flash_Lock(void);
+FLASH_Status Blox_Flash_ErasePage(uint32_t addr);
+FLASH_Status Blox_Flash_ProgramHalfWord(uint32_t addr, uint16_t data);
+FLASH_Status Blox_Flash_ProgramWord(uint32_t addr, uint32_t data);
+FLASH_Status Blox_Flash_WritePage(uint32_t addr, const uint32_t *data);
+uint8_t Blox_Flash_IsBusy(void);
+uint32_t Blox_Flash_GetEraseCount(void);
+void Blox_Flash_GetStats(FLASH_Stats *stats);
+uint16_t Blox_Flash_GetPageErases(uint32_t addr);
+void Blox_Flash_AddPageErases(uint32_t addr, uint16_t erases);
+void Blox_Flash_GetWear(uint32_t addr, uint32_t numPages, FLASH_Wear *ret);
+void Blox_Flash_Defer(ptrVoidFn fn);
+/** @} */
+#endif
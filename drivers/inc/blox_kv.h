@@ -0,0 +1,100 @@
+/**
+ * @file    blox_kv.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Log-structured key/value store for SysVar and small config
+ *          records, spread over MEM_KV_START so no single page wears out.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BLOX_KV_H
+#define __BLOX_KV_H
+
+#include "blox_system.h"
+#include "blox_flash.h"
+#include "string.h"
+
+/**
+ * @ingroup driver_kv
+ * @{
+ */
+#define KV_NUM_PAGES      (MEM_KV_SIZE/PAGE_SIZE)
+#define KV_MAGIC          0x4B560001
+#define KV_MAX_KEYS       64
+#define KV_MAX_DATA       256
+
+#define KV_KEY_SYSVAR     0     /**< First of the keys holding SysVar, one per field */
+#define KV_KEY_STAGE      16    /**< What the filesystem last staged */
+#define KV_KEY_WEAR       20    /**< First of the keys holding the flash erase counts */
+#define KV_KEY_USER       32    /**< First key free for application config records */
+
+/**
+ * @brief Status to return on KV functions
+ */
+typedef enum {
+  KV_NO_SPACE = -4,
+  KV_BAD_KEY,
+  KV_NOT_FOUND,
+  KV_FLASH_ERROR,
+  KV_OK
+} KV_STATUS;
+
+/**
+ * @brief Header at the start of each KV page. Fields are programmed in order
+ *        and magic last, so a page only counts once it is complete.
+ */
+typedef struct {
+  uint32_t erases;    /**< How many times this page has been erased */
+  uint32_t seq;       /**< Incremented on every garbage collection; highest is active */
+  uint32_t magic;     /**< KV_MAGIC once the page is fully written */
+} KV_PageHeader;
+
+/**
+ * @brief Header in front of each record's data, which is padded to a word.
+ *        The key is programmed last, so a record with key 0xFFFF was torn
+ *        by a reset and is skipped. A length of 0 deletes the key.
+ */
+typedef struct {
+  uint16_t len;       /**< The length of the data, 0xFFFF marks the end of the log */
+  uint16_t key;       /**< The key this record sets */
+} KV_Record;
+
+/**
+ * @brief Usage and wear counters for the KV store
+ */
+typedef struct {
+  uint32_t erases[KV_NUM_PAGES];  /**< Lifetime erase count of each page */
+  uint32_t gcs;                   /**< Garbage collections since boot */
+  uint32_t writes;                /**< Records appended since boot */
+  uint32_t skipped;               /**< Writes skipped since boot because the value was unchanged */
+  uint32_t records;               /**< Live keys */
+  uint32_t free;                  /**< Bytes left in the active page */
+} KV_Stats;
+
+KV_STATUS Blox_KV_Init(void);
+KV_STATUS Blox_KV_Write(uint16_t key, const void *data, uint16_t len);
+KV_STATUS Blox_KV_Read(uint16_t key, void *data, uint16_t *len);
+KV_STATUS Blox_KV_Delete(uint16_t key);
+void Blox_KV_GetStats(KV_Stats *stats);
+/** @} */
+#endif
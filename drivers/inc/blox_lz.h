@@ -0,0 +1,62 @@
+/**
+ * @file    blox_lz.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Streaming LZSS decoder for compressed app images. The matching
+ *          encoder is misc/lzss.py.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BLOX_LZ_H
+#define __BLOX_LZ_H
+
+#include "stm32f10x.h"
+
+/**
+ * @ingroup driver_lz
+ * @{
+ */
+#define LZ_MIN_MATCH  3
+#define LZ_MAX_MATCH  (LZ_MIN_MATCH + 0x1F)
+#define LZ_WINDOW     2048
+
+/**
+ * @brief Decoder state, kept between calls so output can be produced a
+ *        page at a time. The stream is a flag byte, LSB first, before every
+ *        8 items: 1 is a literal byte, 0 a 2 byte match holding an 11-bit
+ *        distance-1 and a 5-bit length-LZ_MIN_MATCH.
+ */
+typedef struct {
+  const uint8_t *in;      /**< the next compressed byte */
+  const uint8_t *end;     /**< just past the last compressed byte */
+  uint32_t pos;           /**< bytes decoded so far */
+  uint16_t flags;         /**< unread flag bits, above a marker bit */
+  uint16_t matchLen;      /**< bytes left to copy from the current match */
+  uint16_t matchDist;     /**< how far back the current match copies from */
+  uint8_t error;          /**< set if the stream referred back past its start */
+} BloxLZ;
+
+void Blox_LZ_Init(BloxLZ *lz, const uint8_t *in, uint32_t len);
+uint32_t Blox_LZ_Decode(BloxLZ *lz, uint8_t *out, uint32_t len, const uint8_t *history);
+/** @} */
+#endif
@@ -0,0 +1,70 @@
+/**
+ * @file    blox_mem.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Contains function prototypes for heap and stack usage reporting.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BLOX_MEM_H
+#define __BLOX_MEM_H
+
+#include "stm32f10x.h"
+
+/**
+ * @ingroup driver_mem
+ * @{
+ */
+#define MEM_STACK_PAINT 0xC5C5C5C5
+#define MEM_STACK_GUARD 64
+
+/**
+ * @brief Heap usage as seen through malloc/free.
+ */
+typedef struct {
+  uint32_t size;          /**< the total size of the heap in bytes */
+  uint32_t current;       /**< the number of bytes currently allocated */
+  uint32_t peak;          /**< the most bytes ever allocated at once */
+  uint32_t largest_free;  /**< the largest block malloc can currently return */
+  uint32_t num_allocs;    /**< the number of blocks currently allocated */
+  uint32_t num_fails;     /**< the number of mallocs that have returned NULL */
+  uint32_t bad_frees;     /**< the number of frees of a pointer malloc did not return */
+} MemHeapStats;
+
+/**
+ * @brief Stack usage measured from the painted stack and from sampling.
+ */
+typedef struct {
+  uint32_t size;          /**< the total size of the stack in bytes */
+  uint32_t peak;          /**< the deepest the stack has been (paint high-water mark) */
+  uint32_t main_peak;     /**< the deepest sampled stack while in thread mode */
+  uint32_t isr_peak;      /**< the stack used on top of main_peak by interrupts */
+} MemStackStats;
+
+void Blox_Mem_Init(void);
+void Blox_Mem_SampleStack(void);
+void Blox_Mem_GetHeapStats(MemHeapStats *stats);
+void Blox_Mem_GetStackStats(MemStackStats *stats);
+void Blox_Mem_Report(void);
+/** @} */
+#endif
@@ -31,6 +31,7 @@
 #include "blox_system.h"
 #include "blox_counter.h"
 #include "blox_vusart.h"
+#include "blox_pt.h"
 
 /**
  * @ingroup driver_oled
@@ -156,6 +157,7 @@
 
 //void OLED_Reset (void);
 void Blox_OLED_Init (void);
+PT_THREAD(Blox_OLED_InitTask(BloxPT *pt));
 uint8_t Blox_OLED_Receive (void);
 void Blox_OLED_Send (uint8_t data);
 
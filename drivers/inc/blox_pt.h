@@ -0,0 +1,157 @@
+/**
+ * @file    blox_pt.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Protothreads: stackless coroutines for long driver sequences.
+ *          A task is a function that returns at every wait and resumes where it
+ *          left off the next time it is called.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BLOX_PT_H
+#define __BLOX_PT_H
+
+#include "blox_system.h"
+#include "blox_counter.h"
+#include "blox_vusart.h"
+
+/**
+ * @ingroup driver_pt
+ * @{
+ */
+
+/**
+ * @brief What a task returns each time it is called.
+ */
+typedef enum {
+  PT_WAITING = 0,   /**< Blocked on a wait; call again */
+  PT_YIELDED,       /**< Gave up the CPU; call again */
+  PT_EXITED,        /**< Stopped early with PT_EXIT */
+  PT_ENDED          /**< Ran to PT_END */
+} PT_STATUS;
+
+/**
+ * @brief The state of one task. Locals are not kept between calls, so
+ *        anything a task needs across a wait must be static or live here.
+ */
+typedef struct {
+  uint16_t lc;        /**< Where to resume (a source line number) */
+  uint32_t timer;     /**< Deadline for the current timed wait */
+  uint32_t count;     /**< Bytes received by the current PT_WAIT_BYTES */
+} BloxPT;
+
+/** Declares a task: PT_THREAD(My_Task(BloxPT *pt)) */
+#define PT_THREAD(name_args) PT_STATUS name_args
+
+#define PT_INIT(pt) ((pt)->lc = 0)
+
+/**
+ * The body of a task goes between PT_BEGIN and PT_END. Resuming is a switch
+ * on the saved line, so a task must not use switch statements of its own
+ * around a wait.
+ */
+#define PT_BEGIN(pt) { uint8_t PT_YIELD_FLAG = 1; (void)PT_YIELD_FLAG; switch((pt)->lc) { case 0:
+
+#define PT_END(pt) } PT_YIELD_FLAG = 0; (pt)->lc = 0; return PT_ENDED; }
+
+/** Returns until cond is true. */
+#define PT_WAIT_UNTIL(pt, cond)           \
+  do {                                    \
+    (pt)->lc = __LINE__; case __LINE__:   \
+    if(!(cond))                           \
+      return PT_WAITING;                  \
+  } while(0)
+
+#define PT_WAIT_WHILE(pt, cond) PT_WAIT_UNTIL((pt), !(cond))
+
+/** Runs a child task to completion, returning while it is still running. */
+#define PT_SPAWN(pt, child, thread)       \
+  do {                                    \
+    PT_INIT((child));                     \
+    PT_WAIT_UNTIL((pt), (thread) >= PT_EXITED); \
+  } while(0)
+
+/** Returns once, letting other tasks run. */
+#define PT_YIELD(pt)                      \
+  do {                                    \
+    PT_YIELD_FLAG = 0;                    \
+    (pt)->lc = __LINE__; case __LINE__:   \
+    if(PT_YIELD_FLAG == 0)                \
+      return PT_YIELDED;                  \
+  } while(0)
+
+#define PT_EXIT(pt)                       \
+  do {                                    \
+    PT_INIT(pt);                          \
+    return PT_EXITED;                     \
+  } while(0)
+
+#define PT_RESTART(pt)                    \
+  do {                                    \
+    PT_INIT(pt);                          \
+    return PT_WAITING;                    \
+  } while(0)
+
+/** TRUE while a task has not finished; drives a task from a loop. */
+#define PT_SCHEDULE(f) ((f) < PT_EXITED)
+
+/** Starts the timeout used by PT_EXPIRED. Needs SysTick_Init. */
+#define PT_TIMER_SET(pt, ms) ((pt)->timer = SysTick_Get_Milliseconds() + (ms))
+#define PT_EXPIRED(pt) ((int32_t)(SysTick_Get_Milliseconds() - (pt)->timer) >= 0)
+
+/** Waits for ms milliseconds without blocking other tasks. */
+#define PT_WAIT_MS(pt, ms)                \
+  do {                                    \
+    PT_TIMER_SET((pt), (ms));             \
+    PT_WAIT_UNTIL((pt), PT_EXPIRED(pt));  \
+  } while(0)
+
+/**
+ * Waits until a flag set by an interrupt or event handler is non-zero, then
+ * clears it. flag must be volatile.
+ */
+#define PT_WAIT_EVENT(pt, flag)           \
+  do {                                    \
+    PT_WAIT_UNTIL((pt), (flag));          \
+    (flag) = 0;                           \
+  } while(0)
+
+/** Waits until cond is true or ms milliseconds pass; check PT_EXPIRED after. */
+#define PT_WAIT_UNTIL_TIMEOUT(pt, cond, ms) \
+  do {                                    \
+    PT_TIMER_SET((pt), (ms));             \
+    PT_WAIT_UNTIL((pt), (cond) || PT_EXPIRED(pt)); \
+  } while(0)
+
+/**
+ * Waits for len bytes from a virtual USART, or ms milliseconds. Afterwards
+ * (pt)->count is the number of bytes received; less than len on a timeout.
+ */
+#define PT_WAIT_BYTES(pt, id, buf, len, ms) \
+  do {                                    \
+    (pt)->count = 0;                      \
+    PT_WAIT_UNTIL_TIMEOUT((pt),           \
+      Blox_VUSART_TryReceiveData((id), (buf), (len), &(pt)->count) == VUSART_SUCCESS, (ms)); \
+  } while(0)
+/** @} */
+#endif
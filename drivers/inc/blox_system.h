@@ -50,12 +50,20 @@
 /* On STM32F103VE Flash : 0x08000000-0x08080000, 2K page size
  * 0x08000000
  *      .	      Base Program
- * 0x08008000
- *      .       System Variables
- * 0x08008800
+ * 0x08010000
+ *      .       System Variables (legacy, only read to migrate into KV)
+ * 0x08010800
+ *      .       Staging area for the running application
+ * 0x08020800
  *      .	      FS FAT   
- * 0x08009000
+ * 0x08021000
  *      .	      FS File Store
+ * 0x0807B800
+ *      .       FS directory pages
+ * 0x0807E800
+ *      .       FS FAT, alternate copy
+ * 0x0807F000
+ *      .       KV store (System Variables and config records)
  * 0x08080000
  */
 #define MEM_MAP_START 0x08000000
@@ -69,11 +77,56 @@
 #define MEM_FAT_START		0x08020800
 #define MEM_FAT_SIZE		PAGE_SIZE
 #define MEM_STORE_START		0x08021000
-#define MEM_STORE_SIZE		PAGE_SIZE*190
+#define MEM_STORE_SIZE		PAGE_SIZE*181
+#define MEM_DIR_START		0x0807B800
+#define MEM_DIR_SIZE		PAGE_SIZE*6
+#define MEM_FAT_ALT_START	0x0807E800
+#define MEM_KV_START		0x0807F000
+#define MEM_KV_SIZE		PAGE_SIZE*2
 
 #define MAX_DEINIT_FN 128
 typedef void (*ptrVoidFn)(void);
 
+/**
+ * Places a function in SRAM. Functions marked with this are copied out of
+ * flash at startup by the scatter-loading in misc/standard/scatter, so they
+ * keep running while the flash is being erased or programmed. Everything a
+ * marked function calls must be marked too (or be listed in the scatter file).
+ */
+#define BLOX_RAMFUNC __attribute__((section("blox_ramfunc")))
+
+/** The number of entries in the vector table (16 system + 60 HD IRQs). */
+#define VECTOR_TABLE_SIZE 76
+
+/**
+ * Cells handed across NVIC_SystemReset, such as which app to run. They sit
+ * in the unused end of the SRAM vector table's UNINIT region in
+ * misc/standard/scatter, past VECTOR_TABLE_SIZE words, so neither the C
+ * library's startup nor the heap touches them. Fixed, as the base program
+ * and the apps are linked separately.
+ */
+#define MEM_KEEP_START 0x200001E0
+#define MEM_KEEP_SIZE  0x20
+
+/** Interrupt Priorities **/
+/* All 4 priority bits are preemption bits (NVIC_PriorityGroup_4), set once
+ * in Blox_System_Init. 0 is the most urgent. Soft-UART bit timing must never
+ * wait, so it sits above everything; bulk work sits at the bottom.
+ */
+#define NVIC_PRIO_VUSART_BIT    0   /**< VUSART bit timer, never masked */
+#define NVIC_PRIO_VUSART_START  1   /**< VUSART start-bit edges (EXTI1, EXTI15_10) */
+#define NVIC_PRIO_SYSTICK       2   /**< Timekeeping */
+#define NVIC_PRIO_USART         3   /**< Hardware USART bytes (USB, IR) */
+#define NVIC_PRIO_SOFTIRQ       6   /**< Software-triggered EXTI lines, e.g. the XBee parser */
+#define NVIC_PRIO_TIMER         8   /**< General purpose timers, e.g. touch sampling */
+#define NVIC_PRIO_EXTI          8   /**< Hardware EXTI lines not used by a VUSART */
+#define NVIC_PRIO_BULK          12  /**< Work that may wait on everything else */
+
+/**
+ * @brief The state saved by Blox_System_EnterCritical.
+ */
+typedef uint32_t BloxCritical;
+
 #define SYS_MAGIC 0xCAFEBABE
 #define SYS_INV_ID 0xFFFFFFFF
 /**
@@ -96,6 +149,10 @@ typedef struct {
 } SysVar;
 
 void Blox_System_Init(void);
+void Blox_System_RelocateVectors(void);
+void Blox_System_EnableIRQ(IRQn_Type irq, uint8_t prio);
+BloxCritical Blox_System_EnterCritical(uint8_t prio);
+void Blox_System_ExitCritical(BloxCritical state);
 void Blox_System_Create(void);
 void Blox_System_DeInit(void);
 void Blox_System_Register_DeInit(ptrVoidFn fn);
@@ -40,6 +40,8 @@
  * @{
  */
 #define USB_USART_ID 1
+#define USB_RX_DMA DMA1_Channel5  /**< The channel USART1 requests on receive */
+#define USB_RX_DMA_CLK RCC_AHBPeriph_DMA1
 
 void USB_Init(void);
 uint8_t USB_Receive(void);
@@ -47,5 +49,8 @@ int16_t USB_TryReceive(void);
 void USB_Send(uint8_t data);
 void USB_SendData(uint8_t *data, uint32_t len);
 void USB_SendPat(char *format, ...);
+void USB_StartRxDMA(uint8_t *ring, uint16_t len);
+void USB_StopRxDMA(void);
+uint8_t USB_ReceiveDMA(void);
 /** @} */
 #endif
@@ -82,6 +82,7 @@ typedef enum {
 void Blox_VUSART_Init(uint8_t id);
 void Blox_VUSART_SetBaudrate(uint8_t id, uint16_t baudrate);
 VUSART_STATUS Blox_VUSART_TryReceive(uint8_t id, uint8_t *data);
+VUSART_STATUS Blox_VUSART_TryReceiveData(uint8_t id, uint8_t *data, uint32_t len, uint32_t *count);
 VUSART_STATUS Blox_VUSART_TrySend(uint8_t id, uint8_t data);
 VUSART_STATUS Blox_VUSART_Receive(uint8_t id, uint8_t *data);
 VUSART_STATUS Blox_VUSART_Send(uint8_t id, uint8_t data);
@@ -89,5 +90,6 @@ VUSART_STATUS Blox_VUSART_SendData(uint8_t id, uint8_t *data, uint32_t len);
 VUSART_STATUS Blox_VUSART_Register_RXNE_IRQ(uint8_t id, void (*RXNE_Handler)(void));
 VUSART_STATUS Blox_VUSART_Enable_RXNE_IRQ(uint8_t id);
 VUSART_STATUS Blox_VUSART_Disable_RXNE_IRQ(uint8_t id);
+VUSART_STATUS Blox_VUSART_Trigger_RXNE_IRQ(uint8_t id);
 /** @} */
 #endif
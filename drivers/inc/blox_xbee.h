@@ -32,6 +32,8 @@
 #include "blox_system.h"
 #include "blox_vusart.h"
 #include "blox_counter.h"
+#include "blox_flash.h"
+#include "blox_pt.h"
 
 #include "stdio.h"
 #include "string.h"
@@ -97,7 +99,16 @@ typedef enum {
 
 #define BLOX_FRAME_DATA_LEN 75
 #define XBEE_BLOX_BROADCAST_ID 0xFFFFFFFF
+#define XBEE_WIRE_HEADER_LEN 6    /**< Bytes a BloxFrame's header takes over the air */
+#define XBEE_WIRE_BROADCAST 0xFFFF  /**< XBEE_BLOX_BROADCAST_ID as sent over the air */
+#define XBEE_TX_HEADER_LEN 5      /**< API id, frame id, dest address and options of a TX frame */
+#define XBEE_RX_HEADER_LEN 5      /**< API id, source address, RSSI and options of an RX frame */
 #define XBEE_HOLD_PERIOD 1000
+#define XBEE_RESPONSE_TIMEOUT 3000   /**< ms to wait for OK<CR> in command mode */
+#define XBEE_TX_QUEUE_LEN 4         /**< Frames queued or in flight at once, a power of 2 */
+#define XBEE_TX_STATUS_TIMEOUT 500  /**< ms to wait for a frame's TX status before failing it */
+/** The longest API frame Blox_XBee_Send builds, delimiter to checksum */
+#define XBEE_TX_FRAME_MAX (3 + XBEE_TX_HEADER_LEN + XBEE_WIRE_HEADER_LEN + BLOX_FRAME_DATA_LEN + 1)
 
 /**
  * @brief App-level frame that is parsed from a XBeeFrame
@@ -111,7 +122,10 @@ typedef struct {
 } BloxFrame;
 
 /**
- * @brief the XBee Transmission Frame struct
+ * @brief the XBee Transmission Frame struct. The BloxFrame goes over the
+ *        air as a packed header, the source and destination ids as 16
+ *        bits MSB first, then the type and length as a byte each, followed
+ *        by only len bytes of data. The checksum is worked out as it is packed.
  */
 typedef struct {
   uint8_t start;          /**< the start delimiter */
@@ -120,10 +134,33 @@ typedef struct {
   uint8_t id;             /**< the id of the packet */
   uint16_t dest_addr;     /**< the xbee dest_addr to send to */
   uint8_t options;        /**< byte to set ACK/etc */
-  BloxFrame blox_frame;   /**< the blox_frame to send inside the xbee frame */
-  uint8_t checksum;       /**< the checksum to verify the sent data */
+  uint16_t src_id;        /**< the id of the sending Blox, as sent */
+  uint16_t dst_id;        /**< the id of the receiving Blox, as sent */
+  uint8_t type;           /**< the BloxFrameType */
+  uint8_t len;            /**< the number of bytes of data */
+  const uint8_t *data;    /**< the data, sent straight from the caller's buffer */
 } XBeeTxFrame;
 
+/**
+ * @brief Called once the XBee reports on a queued frame.
+ * @param frame_id the API frame id Blox_XBee_SendAsync gave the frame
+ * @param status XBEE_OK if the module sent it, XBEE_TX_STATUS_FAIL if it
+ *        reported a failure or no status came within XBEE_TX_STATUS_TIMEOUT.
+ */
+typedef void (*XBeeTxCallback)(uint8_t frame_id, XBEE_STATUS status);
+
+/**
+ * @brief A frame in the transmit queue, packed and ready to send.
+ */
+typedef struct {
+  uint8_t frame_id;                 /**< the API frame id, matched to TX statuses */
+  volatile uint8_t status;          /**< XBEE_TXSTATUS_NORMAL until the XBee reports */
+  uint8_t length;                   /**< the number of bytes in wire */
+  uint32_t sent;                    /**< SysTick_Get_Milliseconds() when the last byte went out */
+  XBeeTxCallback callback;          /**< called when done, or NULL */
+  uint8_t wire[XBEE_TX_FRAME_MAX];  /**< the API frame as it goes to the XBee */
+} XBeeTxSlot;
+
 /**
  * @brief A general xbee frame to parse in any command
  */
@@ -151,14 +188,19 @@ typedef struct {
   uint16_t source;        /**< the source xbee id of the sender */
   uint8_t rssi;           /**< the signal strength in dB */
   uint8_t options;        /**< Bytes the sender can set to block ACKs */
-  BloxFrame blox_frame;   /**< the frame the sender originally sent */
+  BloxFrame blox_frame;   /**< the frame the sender originally sent, unpacked */
   uint8_t checksum;       /**< checksum a checksum to detect errors */
 } XBeeRxFrame;
 
 XBEE_STATUS Blox_XBee_Config(void);
+PT_THREAD(Blox_XBee_ConfigTask(BloxPT *pt, XBEE_STATUS *status));
 XBEE_STATUS Blox_XBee_Print(void);
 XBEE_STATUS Blox_XBee_Init (void);
 XBEE_STATUS Blox_XBee_Send (uint8_t *data, uint32_t len, BloxFrameType type, uint32_t dst_id);
+XBEE_STATUS Blox_XBee_SendAsync(uint8_t *data, uint32_t len, BloxFrameType type, uint32_t dst_id,
+                                XBeeTxCallback callback, uint8_t *frame_id);
+uint8_t Blox_XBee_Poll(void);
+void Blox_XBee_Idle(void);
 void Blox_XBee_Send_Period(uint8_t *data, uint32_t len, BloxFrameType type, uint32_t dst_id, uint32_t millis);
 void Blox_XBee_Register_Read(void (*Read_Handler)(void));
 BloxFrame *Blox_XBee_Receive(void);
@@ -27,6 +27,8 @@
  */
 
 #include "blox_counter.h"
+#include "blox_system.h"
+#include "blox_mem.h"
 
 /**
  * @ingroup driver_counter
@@ -48,11 +50,20 @@ static uint32_t seconds;
  */
 static uint32_t minutes;
 
+/**
+ * @brief Guard to prevent double init. Drivers call SysTick_Init from their
+ *        own init, and restarting the count would break waits in progress.
+ */
+static uint8_t systick_init = 0;
+
 /**
  * @brief Initializes the SysTick driver
  * @retval None.
  */
 void SysTick_Init(void) {
+  if (systick_init)
+    return;
+  systick_init = 1;
   milliseconds = 0;
   seconds = 0;
   minutes = 0;
@@ -61,7 +72,7 @@ void SysTick_Init(void) {
     /* Capture error */ 
     while (1);
   }
-  NVIC_SetPriority(SysTick_IRQn, 0);
+  NVIC_SetPriority(SysTick_IRQn, NVIC_PRIO_SYSTICK);
 }
 
 /**
@@ -102,8 +113,9 @@ void SysTick_Wait(uint32_t ms) {
  * @brief The interrupt handler that updates the global time values.
  * @retval None.
  */
-void SysTick_Handler(void) {
+BLOX_RAMFUNC void SysTick_Handler(void) {
   milliseconds++;
+  Blox_Mem_SampleStack();
   if((milliseconds % 1000) == 0) {
     seconds++;
 	  if((seconds % 60) == 0) {
@@ -0,0 +1,152 @@
+/**
+ * @file    blox_crc.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   CRC-32 on the CRC peripheral, fed by DMA for long blocks, with a
+ *          software fallback that gives the same result.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "blox_crc.h"
+
+/**
+ * @ingroup driver_crc
+ * @{
+ */
+
+/* Private function prototypes */
+uint32_t CRC_Hardware(const uint32_t *data, uint32_t words);
+
+/**
+ * @brief Set while the peripheral is computing, so a CRC asked for from an
+ *        interrupt meanwhile is done in software instead.
+ */
+static volatile uint8_t crc_busy = FALSE;
+static uint8_t crc_init = FALSE;
+
+/**
+ * @brief CRC of each nibble for the software CRC (poly 0x04C11DB7).
+ */
+static const uint32_t crc_table[16] = {
+  0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9,
+  0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
+  0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61,
+  0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD
+};
+
+/**
+ * @brief Turns on the clocks for the CRC peripheral and its DMA channel.
+ *        Only runs once.
+ * @retval None
+ */
+void Blox_CRC_Init(void) {
+  if (crc_init)
+    return;
+  RCC_AHBPeriphClockCmd(RCC_AHBPeriph_CRC | CRC_DMA_CLK, ENABLE);
+  crc_init = TRUE;
+}
+
+/**
+ * @brief Computes the CRC-32 of a block of words the way the CRC peripheral
+ *        does: poly 0x04C11DB7, starting from 0xFFFFFFFF, each word MSB
+ *        first, no final XOR. Falls back to software if the peripheral is
+ *        already in use.
+ * @param data the words, in flash or SRAM
+ * @param words the number of words
+ * @retval the CRC.
+ */
+uint32_t Blox_CRC_Calc(const uint32_t *data, uint32_t words) {
+  uint32_t crc;
+  BloxCritical crit = Blox_System_EnterCritical(NVIC_PRIO_VUSART_START);
+  if (crc_busy) {
+    Blox_System_ExitCritical(crit);
+    return Blox_CRC_Software(data, words);
+  }
+  crc_busy = TRUE;
+  Blox_System_ExitCritical(crit);
+
+  Blox_CRC_Init();
+  crc = CRC_Hardware(data, words);
+  crc_busy = FALSE;
+  return crc;
+}
+
+/**
+ * @brief Runs a block through the CRC peripheral. Long blocks are moved
+ *        into it by memory-to-memory DMA; the CPU waits, but the transfer
+ *        runs at bus speed with no load/store loop.
+ * @param data the words
+ * @param words the number of words
+ * @retval the CRC.
+ */
+uint32_t CRC_Hardware(const uint32_t *data, uint32_t words) {
+  DMA_InitTypeDef DMA_InitStructure;
+  uint32_t n;
+
+  CRC_ResetDR();
+  if (words < CRC_DMA_MIN_WORDS)
+    return CRC_CalcBlockCRC((uint32_t *)data, words);
+
+  DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)data;
+  DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&CRC->DR;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Enable;
+  DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Word;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Word;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_Low;
+  DMA_InitStructure.DMA_M2M = DMA_M2M_Enable;
+  while (words) {
+    n = words > 0xFFFF ? 0xFFFF : words;
+    DMA_InitStructure.DMA_BufferSize = n;
+    DMA_DeInit(CRC_DMA_CHANNEL);
+    DMA_Init(CRC_DMA_CHANNEL, &DMA_InitStructure);
+    DMA_Cmd(CRC_DMA_CHANNEL, ENABLE);
+    while (DMA_GetFlagStatus(CRC_DMA_FLAG_TC) == RESET) ;
+    DMA_ClearFlag(CRC_DMA_FLAG_TC);
+    DMA_Cmd(CRC_DMA_CHANNEL, DISABLE);
+    DMA_InitStructure.DMA_PeripheralBaseAddr += n * WORD_SIZE;
+    words -= n;
+  }
+  return CRC_GetCRC();
+}
+
+/**
+ * @brief Computes the same CRC as Blox_CRC_Calc on the CPU, a nibble at a
+ *        time. Safe to call from anywhere.
+ * @param data the words
+ * @param words the number of words
+ * @retval the CRC.
+ */
+uint32_t Blox_CRC_Software(const uint32_t *data, uint32_t words) {
+  uint32_t crc = 0xFFFFFFFF;
+  uint32_t i, j;
+  for (i = 0; i < words; i++) {
+    crc ^= data[i];
+    for (j = 0; j < 8; j++)
+      crc = (crc << 4) ^ crc_table[crc >> 28];
+  }
+  return crc;
+}
+/** @} */
@@ -126,7 +126,7 @@ void Blox_EXTI_Release_IRQ(EXTI_ID id) {
  * @param id the ID of the EXTI IRQ that is to be triggered
  * @retval None
  */
-void Blox_EXTI_Trigger_SW_IRQ(EXTI_ID id) {
+BLOX_RAMFUNC void Blox_EXTI_Trigger_SW_IRQ(EXTI_ID id) {
   if(isHardwareLine(id) == FALSE) {
     EXTI_GenerateSWInterrupt(1<<id);
   }
@@ -137,7 +137,7 @@ void Blox_EXTI_Trigger_SW_IRQ(EXTI_ID id) {
  * @param line specifies the EXTI line
  * @retval 1 if the line is a designated hardware line and 0 otherwise
  */
-uint8_t isHardwareLine(uint8_t line) {
+BLOX_RAMFUNC uint8_t isHardwareLine(uint8_t line) {
   return (line == XBEE_EXTI_LINE || line == OLED_EXTI_LINE || 
       line == TOUCH1_EXTI_LINE || line == TOUCH2_EXTI_LINE || 
       line == TOUCH3_EXTI_LINE || line == TOUCH4_EXTI_LINE);
@@ -158,34 +158,36 @@ void Blox_EXTI_RCC_Configuration(void) {
  * @retval None
  */
 void Blox_EXTI_NVIC_Configuration (uint8_t line) {
-  NVIC_InitTypeDef NVIC_InitStructure;
-  NVIC_PriorityGroupConfig(NVIC_PriorityGroup_4);
-  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 3;
-  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
-  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  IRQn_Type irq;
+  uint8_t prio;
   switch(line) {
     case 0:
-      NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 13;
-      NVIC_InitStructure.NVIC_IRQChannel = EXTI0_IRQn;
+      irq = EXTI0_IRQn;
+      prio = NVIC_PRIO_SOFTIRQ;
       break;
     case 1:
-      NVIC_InitStructure.NVIC_IRQChannel = EXTI1_IRQn;
+      irq = EXTI1_IRQn;
+      prio = NVIC_PRIO_VUSART_START;
       break;
     case 2:
-      NVIC_InitStructure.NVIC_IRQChannel = EXTI2_IRQn;
+      irq = EXTI2_IRQn;
+      prio = NVIC_PRIO_SOFTIRQ;
       break;
     case 3:
-      NVIC_InitStructure.NVIC_IRQChannel = EXTI3_IRQn;
+      irq = EXTI3_IRQn;
+      prio = NVIC_PRIO_SOFTIRQ;
       break;
     case 4:
-      NVIC_InitStructure.NVIC_IRQChannel = EXTI4_IRQn;
+      irq = EXTI4_IRQn;
+      prio = NVIC_PRIO_SOFTIRQ;
       break;
     case 5:
     case 6:
     case 7:
     case 8:
     case 9:
-      NVIC_InitStructure.NVIC_IRQChannel = EXTI9_5_IRQn;
+      irq = EXTI9_5_IRQn;
+      prio = NVIC_PRIO_EXTI;
       break;
     case 10:
     case 11:
@@ -193,10 +195,14 @@ void Blox_EXTI_NVIC_Configuration (uint8_t line) {
     case 12:
     case 14:
     case 15:
-      NVIC_InitStructure.NVIC_IRQChannel = EXTI15_10_IRQn;
+      /* Shared with the touch panels, but carries the XBee start bit */
+      irq = EXTI15_10_IRQn;
+      prio = NVIC_PRIO_VUSART_START;
       break;
+    default:
+      return;
   }
-  NVIC_Init(&NVIC_InitStructure);
+  Blox_System_EnableIRQ(irq, prio);
 }
 
 /**
@@ -204,7 +210,7 @@ void Blox_EXTI_NVIC_Configuration (uint8_t line) {
  * @param 	id the EXTI_ID for the given EXTI IRQ
  * @retval 	None
  */
-void Blox_EXTI_Enable_IRQ(EXTI_ID id) {
+BLOX_RAMFUNC void Blox_EXTI_Enable_IRQ(EXTI_ID id) {
   EXTI_ClearITPendingBit(1<<id); 
   EXTI->IMR |= (1<<id);
 }
@@ -214,7 +220,7 @@ void Blox_EXTI_Enable_IRQ(EXTI_ID id) {
  * @param 	id the EXTI_ID for the given EXTI IRQ
  * @retval 	None
  */
-void Blox_EXTI_Disable_IRQ(EXTI_ID id) {
+BLOX_RAMFUNC void Blox_EXTI_Disable_IRQ(EXTI_ID id) {
   EXTI->IMR &= ~(1<<id);
 }
 
@@ -222,7 +228,7 @@ void Blox_EXTI_Disable_IRQ(EXTI_ID id) {
   * @brief  This function handles External line 0 interrupt request.
   * @retval None
   */
-void EXTI0_IRQHandler(void) {
+BLOX_RAMFUNC void EXTI0_IRQHandler(void) {
   if(EXTI_GetITStatus(EXTI_Line0) != RESET) {
     if(EXTIn_Handler[0] != NULL) {
       (*EXTIn_Handler[0])();
@@ -235,7 +241,7 @@ void EXTI0_IRQHandler(void) {
   * @brief  This function handles External line 1 interrupt request.
   * @retval None
   */
-void EXTI1_IRQHandler(void) {
+BLOX_RAMFUNC void EXTI1_IRQHandler(void) {
   if(EXTI_GetITStatus(EXTI_Line1) != RESET) {
     if(EXTIn_Handler[1] != NULL) {
       (*EXTIn_Handler[1])();
@@ -248,7 +254,7 @@ void EXTI1_IRQHandler(void) {
   * @brief  This function handles External line 2 interrupt request.
   * @retval None
   */
-void EXTI2_IRQHandler(void) {
+BLOX_RAMFUNC void EXTI2_IRQHandler(void) {
   if(EXTI_GetITStatus(EXTI_Line2) != RESET) {
     if(EXTIn_Handler[2] != NULL) {
       (*EXTIn_Handler[2])();
@@ -261,7 +267,7 @@ void EXTI2_IRQHandler(void) {
   * @brief  This function handles External line 3 interrupt request.
   * @retval None
   */
-void EXTI3_IRQHandler(void) {
+BLOX_RAMFUNC void EXTI3_IRQHandler(void) {
   if(EXTI_GetITStatus(EXTI_Line3) != RESET) {
     if(EXTIn_Handler[3] != NULL) {
       (*EXTIn_Handler[3])();
@@ -274,7 +280,7 @@ void EXTI3_IRQHandler(void) {
   * @brief  This function handles External line 4 interrupt request.
   * @retval None
   */
-void EXTI4_IRQHandler(void) {
+BLOX_RAMFUNC void EXTI4_IRQHandler(void) {
   if(EXTI_GetITStatus(EXTI_Line4) != RESET) {
     if(EXTIn_Handler[4] != NULL) {
       (*EXTIn_Handler[4])();
@@ -287,7 +293,7 @@ void EXTI4_IRQHandler(void) {
   * @brief  This function handles External lines 9 to 5 interrupt request.
   * @retval None
   */
-void EXTI9_5_IRQHandler(void) {
+BLOX_RAMFUNC void EXTI9_5_IRQHandler(void) {
   if(EXTI_GetITStatus(EXTI_Line5) != RESET) {
     if(EXTIn_Handler[5] != NULL) {
       (*EXTIn_Handler[5])();
@@ -324,7 +330,7 @@ void EXTI9_5_IRQHandler(void) {
   * @brief  This function handles External lines 15 to 10 interrupt request.
   * @retval None
   */
-void EXTI15_10_IRQHandler(void) {
+BLOX_RAMFUNC void EXTI15_10_IRQHandler(void) {
   if(EXTI_GetITStatus(EXTI_Line10) != RESET) {
     if(EXTIn_Handler[10] != NULL) {
       (*EXTIn_Handler[10])();
@@ -32,26 +32,579 @@
  * @{
  */
 
+/* Private function prototypes */
+void FS_SortFiles(const FS_Table *t, uint8_t *order);
+uint32_t FS_BuildFreeList(const FS_Table *t, FS_Extent *free, uint32_t *numPages);
+void FS_AddFree(FS_Table *t, uint16_t page, uint16_t numPages);
+int32_t FS_BestFit(const FS_Table *t, uint16_t numPages);
+uint32_t FS_PageWear(uint32_t page, uint16_t numPages);
+int32_t FS_ColdFit(const FS_Table *t, uint16_t numPages, uint16_t *page);
+void FS_LoadWear(void);
+uint8_t FS_IsBlank(const uint32_t *page);
+int32_t FS_FindRun(const FS_Table *t, uint32_t page, uint16_t numPages);
+void FS_TakeRun(FS_Table *t, uint32_t run, uint16_t page, uint16_t numPages);
+uint8_t FS_IsInPlace(const FS_File *file);
+uint8_t FS_LinkedHere(const FS_File *file);
+uint32_t FS_HashPage(const uint32_t *page);
+FS_STATUS FS_Stage(const FS_File *file);
+uint32_t FS_StagedPages(const FS_File *file);
+const uint32_t * FS_Legacy(void);
+FS_STATUS FS_Upgrade(const uint32_t *old);
+FS_STATUS FS_AddFlags(void);
+uint8_t FS_NewFile(char *name, uint8_t numPages, uint32_t *addr, uint32_t crc, uint8_t flags);
+uint32_t FS_FatCrc(const FS_Table *t);
+uint32_t FS_DirCrc(const FS_Table *t, uint32_t page);
+uint8_t FS_FatValid(const FS_Table *t);
+FS_STATUS FS_WriteFat(FS_Table *fat_new);
+uint32_t FS_NextSeq(void);
+FS_Table * FS_Begin(void);
+FS_File * FS_Edit(FS_Table *t, uint8_t id);
+void FS_Abort(FS_Table *t);
+FS_STATUS FS_Commit(FS_Table *t);
+uint32_t * FS_SpareDirPage(const FS_Table *t);
+uint32_t FS_NameHash(const char *name);
+void FS_BuildIndex(FS_Table *t);
+void FS_ErasePages(uint32_t page, uint16_t numPages);
+uint8_t FS_DataSlots(const uint8_t *page, uint16_t *bytes, uint16_t *end);
+FS_STATUS FS_DataGrow(FS_DataFile *df);
+FS_STATUS FS_DataMark(FS_DataFile *df, uint8_t *page, uint16_t end);
+FS_STATUS FS_DataFlush(FS_DataFile *df, uint8_t sync);
+void FS_CopySpan(const uint8_t *src, uint32_t n, uint32_t *at, uint32_t offset,
+                 uint8_t *out, uint32_t len);
+
+/**
+ * @brief An FS_File as FATs before FS_MAGIC_V4 laid it out. Their table
+ *        always started after 4 words of header, and held 16 files.
+ */
+typedef struct {
+	uint8_t id;
+  char name[FS_FILE_MAX_NAME_LEN];
+	uint8_t numPages;
+	uint32_t *data;
+} FS_FileV1;
+
+/**
+ * @brief An FS_File as FS_MAGIC_V4 FATs laid it out.
+ */
+typedef struct {
+	uint8_t id;
+  char name[FS_FILE_MAX_NAME_LEN];
+	uint8_t numPages;
+	uint32_t *data;
+  uint32_t crc;
+} FS_FileV4;
+
+#define FS_V1_TABLE_WORD 4
+#define FS_V1_MAX_FILES 16
+#define FS_V1_FREE_BYTES ((FS_V1_MAX_FILES+1)*sizeof(FS_Extent))
+#define FS_V3_SEQ_WORD ((FS_V1_TABLE_WORD*WORD_SIZE + FS_V1_MAX_FILES*sizeof(FS_FileV1) \
+                         + FS_V1_FREE_BYTES)/WORD_SIZE)
+#define FS_V3_CRC_WORD (FS_V3_SEQ_WORD + 1)
+#define FS_V4_SEQ_WORD ((FS_V1_TABLE_WORD*WORD_SIZE + FS_V1_MAX_FILES*sizeof(FS_FileV4) \
+                         + FS_V1_FREE_BYTES)/WORD_SIZE)
+#define FS_V4_CRC_WORD (FS_V4_SEQ_WORD + 1)
+
+#define FS_PAGE(addr) (((uint32_t)(addr) - MEM_STORE_START)/PAGE_SIZE)
+#define FS_ADDR(page) ((uint32_t *)(MEM_STORE_START + (page)*PAGE_SIZE))
+#define FS_IN_DIR(addr) ((uint32_t)(addr) >= MEM_DIR_START \
+                         && (uint32_t)(addr) < MEM_DIR_START + MEM_DIR_SIZE)
+#define FS_DIR_ADDR(page) ((uint32_t *)(MEM_DIR_START + (page)*PAGE_SIZE))
+/** The FS_File with a given id, in its directory page */
+#define FS_ENTRY(t, id) ((FS_File *)((t)->dir[(id)/FS_DIR_PER_PAGE]) + (id)%FS_DIR_PER_PAGE)
+#define FS_HALF_UP(n) (((n) + 1) & ~1)
+/** Whether a data file page with k slots used, the last saying end, takes no more data */
+#define FS_DATA_DONE(k, end) ((k) == FS_DATA_SLOTS || FS_HALF_UP(end) >= FS_DATA_PAYLOAD)
+
 /**
  * @brief The internal pointer to the FAT
  */
 volatile FS_Table *fat = 0;
 
 /**
- * @brief Initializes the filesystem.
+ * @brief Blox_Flash_GetEraseCount when the erase counts were last saved
+ */
+static uint32_t wearSaved = 0;
+
+/**
+ * @brief Set once FS_PreErase has nothing left to do, until the FAT changes
+ */
+static uint8_t preErased = FALSE;
+
+/**
+ * @brief Initializes the filesystem. Mounts whichever FAT copy is valid and
+ *        newest; the CRC stands in for walking the table at boot. A FAT in
+ *        an older layout is upgraded, and if that fails the error is
+ *        returned rather than creating a new filesystem over its files.
  * @retval FS_OK if successful, another FS_STATUS if not.
  */
-FS_STATUS FS_Init(bool create) {  
+FS_STATUS FS_Init(uint8_t create) {  
+  FS_Table *fat0 = (FS_Table *)MEM_FAT_START;
+  FS_Table *fat1 = (FS_Table *)MEM_FAT_ALT_START;
+  FS_STATUS status;
   if(fat != 0)
     return FS_OK;  
-  fat = (FS_Table *)MEM_FAT_START;
+  FS_LoadWear();
+  if(FS_FatValid(fat0) && (!FS_FatValid(fat1) || fat0->seq > fat1->seq))
+    fat = fat0;
+  else if(FS_FatValid(fat1))
+    fat = fat1;
+  else if(FS_Legacy() != NULL) {
+    status = FS_Upgrade(FS_Legacy());
+    if(status != FS_OK)
+      return status;
+  }
+  if(fat != 0 && fat->magic == FS_MAGIC_V5) {
+    status = FS_AddFlags();
+    if(status != FS_OK) {
+      fat = 0;
+      return status;
+    }
+  }
   //Create the file system if desired
-  if(fat->magic != FS_MAGIC && create)
+  if(fat == 0 || fat->magic != FS_MAGIC) {
+    if(!create)
+      return FS_BAD_FAT;
     FS_CreateFS();
-  else
-    return FS_BAD_FAT;
+  }
     
-  return FS_ChkValid();
+  return FS_OK;
+}
+
+/**
+ * @brief Computes the CRC of a FAT with the CRC peripheral.
+ * @param t the FAT
+ * @retval the CRC of every field before crc.
+ */
+uint32_t FS_FatCrc(const FS_Table *t) {
+  return Blox_CRC_Calc((const uint32_t *)t, (sizeof(FS_Table) - sizeof(uint32_t))/WORD_SIZE);
+}
+
+/**
+ * @brief Computes the CRC of the files in use in a directory page.
+ * @param t the FAT
+ * @param page which of the FAT's directory pages
+ * @retval the CRC.
+ */
+uint32_t FS_DirCrc(const FS_Table *t, uint32_t page) {
+  uint32_t used = 0;
+  if (t->numFiles > page*FS_DIR_PER_PAGE)
+    used = t->numFiles - page*FS_DIR_PER_PAGE;
+  if (used > FS_DIR_PER_PAGE)
+    used = FS_DIR_PER_PAGE;
+  return Blox_CRC_Calc((const uint32_t *)t->dir[page], used*sizeof(FS_File)/WORD_SIZE);
+}
+
+/**
+ * @brief Checks one copy of the FAT, and the directory pages it points at,
+ *        were written completely. FS_MAGIC_V5 copies share the layout and
+ *        are checked the same way.
+ * @param t the FAT
+ * @retval TRUE if its magic and CRCs are good, FALSE otherwise.
+ */
+uint8_t FS_FatValid(const FS_Table *t) {
+  uint32_t i;
+  if ((t->magic != FS_MAGIC && t->magic != FS_MAGIC_V5) || t->crc != FS_FatCrc(t) || t->numFiles > FS_MAX_FILES)
+    return FALSE;
+  for (i = 0; i < FS_DIR_PAGES; i++) {
+    if (!FS_IN_DIR(t->dir[i]) || t->dirCrc[i] != FS_DirCrc(t, i))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief Writes a new FAT over the copy that isn't live and mounts it once
+ *        it reads back valid. A reset part way through leaves the old copy.
+ *        It is stamped FS_MAGIC, unless it is a step of FS_AddFlags still
+ *        marked FS_MAGIC_V5.
+ * @param fat_new the new FAT, in RAM
+ * @retval FS_OK if successful, FS_BAD_WRITE if the copy didn't verify.
+ */
+FS_STATUS FS_WriteFat(FS_Table *fat_new) {
+  FS_Table *dst = (FS_Table *)MEM_FAT_START;
+  if((uint32_t)fat == MEM_FAT_START)
+    dst = (FS_Table *)MEM_FAT_ALT_START;
+  
+  if(fat_new->magic != FS_MAGIC_V5 || fat == 0 || fat->magic != FS_MAGIC_V5)
+    fat_new->magic = FS_MAGIC;
+  fat_new->seq = (fat != 0 && fat->magic == FS_MAGIC) ? fat->seq + 1 : FS_NextSeq();
+  fat_new->crc = FS_FatCrc(fat_new);
+  FS_SwapPage((uint32_t *)fat_new, (uint32_t *)dst);
+  if(!FS_FatValid(dst)) {
+    Blox_DebugStr("FS_WriteFat failed! Copy didn't verify.\r\n");
+    return FS_BAD_WRITE;
+  }
+  fat = dst;
+  preErased = FALSE;
+  if(Blox_Flash_GetEraseCount() - wearSaved >= FS_WEAR_SAVE_ERASES)
+    FS_SaveWear();
+  return FS_OK;
+}
+
+/**
+ * @brief Works out the seq for a FAT written with none mounted, such as by
+ *        FS_CreateFS before FS_Init. It has to beat any valid copy already
+ *        in flash, or FS_Init would mount that copy instead.
+ * @retval one more than the highest seq of the valid copies, 1 if neither is.
+ */
+uint32_t FS_NextSeq(void) {
+  FS_Table *fat0 = (FS_Table *)MEM_FAT_START;
+  FS_Table *fat1 = (FS_Table *)MEM_FAT_ALT_START;
+  uint32_t seq = 0;
+  if (FS_FatValid(fat0))
+    seq = fat0->seq;
+  if (FS_FatValid(fat1) && fat1->seq > seq)
+    seq = fat1->seq;
+  return seq + 1;
+}
+
+/**
+ * @brief Starts a change to the FAT by copying the live one into RAM.
+ * @retval the copy, NULL if out of heap.
+ */
+FS_Table * FS_Begin(void) {
+  FS_Table *t = (FS_Table *)malloc(PAGE_SIZE);
+  if (t == NULL) {
+    Blox_DebugStr("FS_Begin out of heap!\r\n");
+    return NULL;
+  }
+  memmove(t, (const void *)fat, PAGE_SIZE);
+  return t;
+}
+
+/**
+ * @brief Gets a file in a FAT being changed, copying its directory page
+ *        into RAM the first time one of its files is asked for. FS_Commit
+ *        can only write FS_DIR_SPARES changed pages, so a change must not
+ *        touch files in more pages than that.
+ * @param t the FAT from FS_Begin
+ * @param id the file, up to t->numFiles for a new one
+ * @retval the file, NULL if out of heap.
+ */
+FS_File * FS_Edit(FS_Table *t, uint8_t id) {
+  uint32_t *buf, page = id/FS_DIR_PER_PAGE;
+  if (FS_IN_DIR(t->dir[page])) {
+    buf = (uint32_t *)malloc(PAGE_SIZE);
+    if (buf == NULL) {
+      Blox_DebugStr("FS_Edit out of heap!\r\n");
+      return NULL;
+    }
+    memmove(buf, (const void *)t->dir[page], PAGE_SIZE);
+    t->dir[page] = (uint32_t)buf;
+  }
+  return FS_ENTRY(t, id);
+}
+
+/**
+ * @brief Drops a change to the FAT.
+ * @param t the FAT from FS_Begin
+ * @retval None
+ */
+void FS_Abort(FS_Table *t) {
+  uint32_t i;
+  for (i = 0; i < FS_DIR_PAGES; i++) {
+    if (!FS_IN_DIR(t->dir[i]))
+      free((void *)t->dir[i]);
+  }
+  free(t);
+}
+
+/**
+ * @brief Finds a page of the directory pool that neither the live FAT nor a
+ *        FAT being changed points at.
+ * @param t the FAT from FS_Begin
+ * @retval the page, NULL if there are none.
+ */
+uint32_t * FS_SpareDirPage(const FS_Table *t) {
+  uint32_t i, j;
+  uint32_t *page;
+  for (i = 0; i < FS_DIR_POOL; i++) {
+    page = FS_DIR_ADDR(i);
+    for (j = 0; j < FS_DIR_PAGES; j++) {
+      if (t->dir[j] == (uint32_t)page 
+            || (fat != 0 && (fat->magic == FS_MAGIC || fat->magic == FS_MAGIC_V5)
+                  && fat->dir[j] == (uint32_t)page))
+        break;
+    }
+    if (j == FS_DIR_PAGES)
+      return page;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Finishes a change to the FAT. Each directory page that was changed
+ *        is written to a spare page of the pool, then the FAT pointing at
+ *        them is written. Until that FAT verifies, the old one and the pages
+ *        it points at are still there, which leaves FS_DIR_SPARES pages for
+ *        the changed ones. Frees t either way.
+ * @param t the FAT from FS_Begin
+ * @retval FS_OK if successful, FS_BAD_WRITE if not, or if more than
+ *         FS_DIR_SPARES pages were changed.
+ */
+FS_STATUS FS_Commit(FS_Table *t) {
+  uint32_t i;
+  uint32_t *spare;
+  FS_STATUS status;
+  for (i = 0; i < FS_DIR_PAGES; i++) {
+    if (FS_IN_DIR(t->dir[i]))
+      continue;
+    spare = FS_SpareDirPage(t);
+    if (spare == NULL) {
+      FS_Abort(t);
+      return FS_BAD_WRITE;
+    }
+    FS_SwapPage((uint32_t *)t->dir[i], spare);
+    if (memcmp(spare, (const void *)t->dir[i], PAGE_SIZE) != 0) {
+      Blox_DebugStr("FS_Commit failed! Directory page didn't verify.\r\n");
+      FS_Abort(t);
+      return FS_BAD_WRITE;
+    }
+    free((void *)t->dir[i]);
+    t->dir[i] = (uint32_t)spare;
+  }
+  for (i = 0; i < FS_DIR_PAGES; i++)
+    t->dirCrc[i] = FS_DirCrc(t, i);
+  FS_BuildIndex(t);
+  
+  status = FS_WriteFat(t);
+  free(t);
+  return status;
+}
+
+/**
+ * @brief Hashes a file name (32-bit FNV-1a over its characters).
+ * @param name the name, ended by a 0 or FS_FILE_MAX_NAME_LEN long
+ * @retval the hash.
+ */
+uint32_t FS_NameHash(const char *name) {
+  uint32_t i, hash = 2166136261u;
+  for (i = 0; i < FS_FILE_MAX_NAME_LEN && name[i] != '\0'; i++) {
+    hash ^= (uint8_t)name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Rebuilds a FAT's name index from its files' hashes. Each file goes
+ *        in the first empty slot from its hash on, so a lookup reads the
+ *        slots from there to the next empty one.
+ * @param t the FAT
+ * @retval None
+ */
+void FS_BuildIndex(FS_Table *t) {
+  uint32_t id, slot;
+  memset(t->index, 0, FS_INDEX_SIZE);
+  for (id = 0; id < t->numFiles; id++) {
+    slot = FS_ENTRY(t, id)->hash % FS_INDEX_SIZE;
+    while (t->index[slot] != 0)
+      slot = (slot + 1) % FS_INDEX_SIZE;
+    t->index[slot] = id + 1;
+  }
+}
+
+/**
+ * @brief Adds the erase counts saved in the KV store to the flash driver's.
+ * @retval None
+ */
+void FS_LoadWear(void) {
+  uint16_t counts[FS_WEAR_PER_KEY];
+  uint16_t len;
+  uint32_t i, j;
+  for(i = 0; i < FS_WEAR_KEYS; i++) {
+    len = sizeof(counts);
+    if(Blox_KV_Read(KV_KEY_WEAR + i, counts, &len) != KV_OK)
+      continue;
+    for(j = 0; j < len/sizeof(uint16_t); j++)
+      Blox_Flash_AddPageErases(MEM_MAP_START + (i*FS_WEAR_PER_KEY + j)*PAGE_SIZE, counts[j]);
+  }
+}
+
+/**
+ * @brief Saves every page's erase count in the KV store, so they survive a
+ *        reset. Done every FS_WEAR_SAVE_ERASES erases and before an app is
+ *        run; erases since the last save are lost on a power cut.
+ * @retval None
+ */
+void FS_SaveWear(void) {
+  uint16_t counts[FS_WEAR_PER_KEY];
+  uint32_t i, j;
+  wearSaved = Blox_Flash_GetEraseCount();
+  for(i = 0; i < FS_WEAR_KEYS; i++) {
+    for(j = 0; j < FS_WEAR_PER_KEY; j++)
+      counts[j] = Blox_Flash_GetPageErases(MEM_MAP_START + (i*FS_WEAR_PER_KEY + j)*PAGE_SIZE);
+    Blox_KV_Write(KV_KEY_WEAR + i, counts, sizeof(counts));
+  }
+}
+
+/**
+ * @brief Finds a FAT written in an older layout. FS_MAGIC_V4 and
+ *        FS_MAGIC_V3 copies are only taken if their CRC is good, and the
+ *        newer of two of a kind is taken.
+ * @retval the FAT, or NULL if neither copy holds one.
+ */
+const uint32_t * FS_Legacy(void) {
+  const uint32_t *fat0 = (const uint32_t *)MEM_FAT_START;
+  const uint32_t *fat1 = (const uint32_t *)MEM_FAT_ALT_START;
+  uint8_t ok0 = fat0[0] == FS_MAGIC_V4 
+    && fat0[FS_V4_CRC_WORD] == Blox_CRC_Calc(fat0, FS_V4_CRC_WORD);
+  uint8_t ok1 = fat1[0] == FS_MAGIC_V4 
+    && fat1[FS_V4_CRC_WORD] == Blox_CRC_Calc(fat1, FS_V4_CRC_WORD);
+  
+  if(ok1 && (!ok0 || fat1[FS_V4_SEQ_WORD] > fat0[FS_V4_SEQ_WORD]))
+    return fat1;
+  if(ok0)
+    return fat0;
+  
+  ok0 = fat0[0] == FS_MAGIC_V3 
+    && fat0[FS_V3_CRC_WORD] == Blox_CRC_Calc(fat0, FS_V3_CRC_WORD);
+  ok1 = fat1[0] == FS_MAGIC_V3 
+    && fat1[FS_V3_CRC_WORD] == Blox_CRC_Calc(fat1, FS_V3_CRC_WORD);
+  if(ok1 && (!ok0 || fat1[FS_V3_SEQ_WORD] > fat0[FS_V3_SEQ_WORD]))
+    return fat1;
+  if(ok0 || fat0[0] == FS_MAGIC_V1 || fat0[0] == FS_MAGIC_V2)
+    return fat0;
+  return NULL;
+}
+
+/**
+ * @brief Rewrites a FAT from an older layout in the current one, keeping its
+ *        files and sealing each with its CRC if it had none. Files in the
+ *        pages the directory pool took from the end of the store are moved
+ *        into free space first, except apps linked to run there, which are
+ *        dropped. Files in the pages the KV store took are dropped too, as
+ *        Blox_KV_Init has formatted them by the time this runs. The new FAT
+ *        goes in the other copy, so the old one is left in place until the
+ *        new one verifies.
+ * @param old the FAT FS_Legacy found
+ * @retval FS_OK if successful, another FS_STATUS if not.
+ */
+FS_STATUS FS_Upgrade(const uint32_t *old) {
+  uint32_t i, j, numPages, numOld = old[1];
+  const FS_FileV1 *v1 = (const FS_FileV1 *)(old + FS_V1_TABLE_WORD);
+  const FS_FileV4 *v4 = (const FS_FileV4 *)(old + FS_V1_TABLE_WORD);
+  FS_File *file, moved[FS_V1_MAX_FILES];
+  uint8_t numMoved = 0;
+  int32_t run;
+  uint16_t page;
+  FS_Table *fat_new = (FS_Table *)malloc(PAGE_SIZE);
+  
+  if(fat_new == NULL)
+    return FS_NO_MEM;
+  if(numOld > FS_V1_MAX_FILES)
+    numOld = FS_V1_MAX_FILES;
+  for(i = 0; i < FS_DIR_PAGES; i++)
+    fat_new->dir[i] = (uint32_t)FS_DIR_ADDR(i);
+  fat_new->numFiles = 0;
+  for(i = 0; i < numOld; i++) {
+    file = FS_Edit(fat_new, fat_new->numFiles);
+    if(file == NULL) {
+      FS_Abort(fat_new);
+      return FS_NO_MEM;
+    }
+    memmove(file->name, v1[i].name, FS_FILE_MAX_NAME_LEN);
+    file->name[FS_FILE_MAX_NAME_LEN-1] = '\0';
+    file->numPages = v1[i].numPages;
+    file->flags = 0;
+    file->data = v1[i].data;
+    file->crc = CRC_NONE;
+    if(old[0] == FS_MAGIC_V4) {
+      file->numPages = v4[i].numPages;
+      file->data = v4[i].data;
+      file->crc = v4[i].crc;
+    }
+    if((uint32_t)file->data < MEM_KV_START + MEM_KV_SIZE
+         && (uint32_t)(file->data + file->numPages*PAGE_SIZE/WORD_SIZE) > MEM_KV_START) {
+      Blox_DebugPat("FS_Upgrade dropping %s, the KV store took its pages\r\n", file->name);
+      continue;
+    }
+    if(file->crc == CRC_NONE)
+      file->crc = Blox_CRC_Calc(file->data, file->numPages*PAGE_SIZE/WORD_SIZE);
+    file->hash = FS_NameHash(file->name);
+    if(FS_LinkedHere(file))
+      file->flags = FS_FLAG_IN_PLACE;
+    if(FS_PAGE(file->data) + file->numPages > FS_STORE_PAGES) {
+      if(FS_IsInPlace(file))
+        Blox_DebugPat("FS_Upgrade dropping %s, it runs where the directory now is\r\n", file->name);
+      else
+        moved[numMoved++] = *file;
+      continue;
+    }
+    file->id = fat_new->numFiles++;
+  }
+  
+  fat_new->numFree = FS_BuildFreeList(fat_new, fat_new->free, &numPages);
+  if(fat_new->numFree > FS_MAX_FREE) {
+    Blox_DebugStr("FS_Upgrade failed! Files don't fit the store.\r\n");
+    FS_Abort(fat_new);
+    return FS_BAD_FAT;
+  }
+  fat_new->free_numPages = numPages;
+  for(i = 0; i < numMoved; i++) {
+    run = FS_ColdFit(fat_new, moved[i].numPages, &page);
+    if(run < 0) {
+      Blox_DebugPat("FS_Upgrade dropping %s, no room to move it\r\n", moved[i].name);
+      continue;
+    }
+    for(j = 0; j < moved[i].numPages; j++)
+      FS_SwapPage(moved[i].data + j*PAGE_SIZE/WORD_SIZE, FS_ADDR(page + j));
+    FS_TakeRun(fat_new, run, page, moved[i].numPages);
+    file = FS_Edit(fat_new, fat_new->numFiles);
+    if(file == NULL) {
+      FS_Abort(fat_new);
+      return FS_NO_MEM;
+    }
+    *file = moved[i];
+    file->data = FS_ADDR(page);
+    file->id = fat_new->numFiles++;
+  }
+  
+  fat = (FS_Table *)old;
+  if(FS_Commit(fat_new) != FS_OK) {
+    fat = 0;
+    return FS_BAD_FAT;
+  }
+  return FS_OK;
+}
+
+/**
+ * @brief Rewrites the mounted FS_MAGIC_V5 FAT with flags for each file.
+ *        Unsealed files are taken to be data files, as FS_Open took them
+ *        before files were marked, and the rest run in place if their
+ *        reset vector points into them. Goes FS_DIR_SPARES directory pages
+ *        per commit, and only the last is stamped FS_MAGIC, so a reset part
+ *        way through flags the files again from the start.
+ * @retval FS_OK if successful, another FS_STATUS if not.
+ */
+FS_STATUS FS_AddFlags(void) {
+  uint32_t i, page = 0, edited;
+  FS_File *file;
+  FS_Table *fat_new;
+  FS_STATUS status;
+  do {
+    fat_new = FS_Begin();
+    if(fat_new == NULL)
+      return FS_NO_MEM;
+    for(edited = 0; edited < FS_DIR_SPARES && page*FS_DIR_PER_PAGE < fat_new->numFiles; edited++, page++) {
+      for(i = page*FS_DIR_PER_PAGE; i < (page+1)*FS_DIR_PER_PAGE && i < fat_new->numFiles; i++) {
+        file = FS_Edit(fat_new, i);
+        if(file == NULL) {
+          FS_Abort(fat_new);
+          return FS_NO_MEM;
+        }
+        file->flags = (file->crc == CRC_NONE) ? FS_FLAG_DATA : 0;
+        if(file->flags == 0 && FS_LinkedHere(file))
+          file->flags = FS_FLAG_IN_PLACE;
+      }
+    }
+    if(page*FS_DIR_PER_PAGE >= fat_new->numFiles)
+      fat_new->magic = FS_MAGIC;
+    status = FS_Commit(fat_new);
+    if(status != FS_OK)
+      return status;
+  } while(fat->magic == FS_MAGIC_V5);
+  return FS_OK;
 }
 
 /**
@@ -66,20 +619,16 @@ FS_STATUS FS_CreateFS(void) {
   if(fat_new == NULL)
     return FS_CREATE_FAIL;
 
-  fat_new->magic = FS_MAGIC;
   fat_new->numFiles = 0;
-  fat_new->free_top = (uint32_t *)(MEM_STORE_START);
-  fat_new->free_numPages = (MEM_STORE_SIZE/PAGE_SIZE);
-  for(i = 0; i < FS_MAX_FILES; i++) {
-    fat_new->table[i].id = FS_MAX_FILES;
-    fat_new->table[i].numPages = 0;
-    fat_new->table[i].data = 0;
-  }
-  
-  fat = (FS_Table *)MEM_FAT_START;
+  fat_new->numFree = 1;
+  fat_new->free[0].page = 0;
+  fat_new->free[0].numPages = FS_STORE_PAGES;
+  fat_new->free_numPages = FS_STORE_PAGES;
+  for(i = 0; i < FS_DIR_PAGES; i++)
+    fat_new->dir[i] = (uint32_t)FS_DIR_ADDR(i);
   
-  FS_SwapPage((uint32_t *)fat_new, (uint32_t *)fat);
-  free(fat_new);  
+  if(FS_Commit(fat_new) != FS_OK)
+    return FS_CREATE_FAIL;
   return FS_OK;
 }
 
@@ -88,36 +637,264 @@ FS_STATUS FS_CreateFS(void) {
  * @retval FS_OK if valid, FS_BAD_FAT on failure
  */
 FS_STATUS FS_ChkValid(void) {	
-  uint32_t i, real_free_top, real_free_numPages;
+  uint32_t i, real_numFree, real_free_numPages;
+  FS_Extent real_free[FS_MAX_FREE];
   if (fat->magic != FS_MAGIC) {
     Blox_DebugStr("FS_ChkValid failed! Bad magic.\r\n");  
 	  return FS_BAD_FAT;
   }
 
   for(i = 0; i < fat->numFiles; i++) {
-	  if(fat->table[i].id == FS_MAX_FILES) {
-      Blox_DebugPat("FS_ChkValid failed! Bad uninitialized id: %u\r\n", fat->table[i].id);
+	  if(FS_ENTRY(fat, i)->id != i) {
+      Blox_DebugPat("FS_ChkValid failed! Bad id: %u\r\n", FS_ENTRY(fat, i)->id);
+      return FS_BAD_FAT;    
+    }
+    if(FS_GetFileFromName(FS_ENTRY(fat, i)->name) == NULL) {
+      Blox_DebugPat("FS_ChkValid failed! %s missing from the index\r\n", FS_ENTRY(fat, i)->name);
       return FS_BAD_FAT;    
     }
   }
 
-  if(fat->numFiles == 0) {
-    if ((uint32_t)fat->free_top != MEM_STORE_START
-          || fat->free_numPages != MEM_STORE_SIZE/PAGE_SIZE) {
-      Blox_DebugStr("FS_ChkValid failed! Bad empty free_top or free_size.\r\n");
-      return FS_BAD_FAT;
+  real_numFree = FS_BuildFreeList((const FS_Table *)fat, real_free, &real_free_numPages);
+  if (real_numFree > FS_MAX_FREE) {
+    Blox_DebugStr("FS_ChkValid failed! Files overlap or leave the store.\r\n");
+    return FS_BAD_FAT;
+  }
+  if (fat->numFree != real_numFree
+        || fat->free_numPages != real_free_numPages
+        || memcmp((const void *)fat->free, real_free, real_numFree * sizeof(FS_Extent)) != 0) {
+    Blox_DebugStr("FS_ChkValid failed! Bad free list or free_numPages.\r\n");
+    return FS_BAD_FAT;    
+  }
+  return FS_OK;
+}
+
+/**
+ * @brief Orders a FAT's files by address.
+ * @param t the FAT
+ * @param order filled with numFiles file ids, lowest address first
+ * @retval None
+ */
+void FS_SortFiles(const FS_Table *t, uint8_t *order) {
+  uint32_t i, j;
+  uint8_t id;
+  for (i = 0; i < t->numFiles; i++) {
+    id = i;
+    for (j = i; j > 0 && FS_ENTRY(t, order[j-1])->data > FS_ENTRY(t, id)->data; j--)
+      order[j] = order[j-1];
+    order[j] = id;
+  }
+}
+
+/**
+ * @brief Works out the free runs between a FAT's files.
+ * @param t the FAT
+ * @param free filled with the free runs, sorted by address
+ * @param numPages set to the total number of free pages
+ * @retval the number of free runs, more than FS_MAX_FREE if files overlap
+ *         or run past the store.
+ */
+uint32_t FS_BuildFreeList(const FS_Table *t, FS_Extent *free, uint32_t *numPages) {
+  uint8_t order[FS_MAX_FILES];
+  uint32_t i, page, cursor = 0, numFree = 0;
+  
+  *numPages = 0;
+  FS_SortFiles(t, order);
+  for (i = 0; i < t->numFiles; i++) {
+    page = FS_PAGE(FS_ENTRY(t, order[i])->data);
+    if ((uint32_t)FS_ENTRY(t, order[i])->data < MEM_STORE_START || page < cursor)
+      return FS_MAX_FREE+1;
+    if (page > cursor) {
+      free[numFree].page = cursor;
+      free[numFree++].numPages = page - cursor;
+      *numPages += page - cursor;
+    }
+    cursor = page + FS_ENTRY(t, order[i])->numPages;
+  }
+  if (cursor > FS_STORE_PAGES)
+    return FS_MAX_FREE+1;
+  if (cursor < FS_STORE_PAGES) {
+    free[numFree].page = cursor;
+    free[numFree++].numPages = FS_STORE_PAGES - cursor;
+    *numPages += FS_STORE_PAGES - cursor;
+  }
+  return numFree;
+}
+
+/**
+ * @brief Returns a run of pages to a FAT's free list, merging it with the
+ *        runs on either side.
+ * @param t the FAT
+ * @param page the first page of the run
+ * @param numPages the number of pages in the run
+ * @retval None
+ */
+void FS_AddFree(FS_Table *t, uint16_t page, uint16_t numPages) {
+  uint32_t i, j;
+  for (i = 0; i < t->numFree && t->free[i].page < page; i++) ;
+  
+  if (i > 0 && t->free[i-1].page + t->free[i-1].numPages == page) {
+    t->free[i-1].numPages += numPages;
+    if (i < t->numFree && page + numPages == t->free[i].page) {
+      t->free[i-1].numPages += t->free[i].numPages;
+      for (j = i; j < t->numFree-1; j++)
+        t->free[j] = t->free[j+1];
+      t->numFree--;
     }
+  } else if (i < t->numFree && page + numPages == t->free[i].page) {
+    t->free[i].page = page;
+    t->free[i].numPages += numPages;
   } else {
-    real_free_top = (uint32_t)fat->table[fat->numFiles-1].data
-                  + fat->table[fat->numFiles-1].numPages * PAGE_SIZE;
-    real_free_numPages = (MEM_STORE_START + MEM_STORE_SIZE - real_free_top)/PAGE_SIZE;
-    if ((uint32_t)fat->free_top != real_free_top
-             || fat->free_numPages != real_free_numPages) {
-      Blox_DebugStr("FS_ChkValid failed! Bad real free_top or free_numPages.\r\n");
-      return FS_BAD_FAT;    
+    for (j = t->numFree; j > i; j--)
+      t->free[j] = t->free[j-1];
+    t->free[i].page = page;
+    t->free[i].numPages = numPages;
+    t->numFree++;
+  }
+  t->free_numPages += numPages;
+}
+
+/**
+ * @brief Finds the smallest free run a file fits in.
+ * @param t the FAT
+ * @param numPages the number of pages needed
+ * @retval the index of the run in the free list, -1 if none is big enough.
+ */
+int32_t FS_BestFit(const FS_Table *t, uint16_t numPages) {
+  int32_t best = -1;
+  uint32_t i;
+  for (i = 0; i < t->numFree; i++) {
+    if (t->free[i].numPages >= numPages
+          && (best < 0 || t->free[i].numPages < t->free[best].numPages))
+      best = i;
+  }
+  return best;
+}
+
+/**
+ * @brief Sums the erase counts of a range of pages in the file store. The
+ *        erase FS_PreErase already spent on a blank page isn't counted,
+ *        so new files go to the pages it prepared.
+ * @param page the first page, counted from MEM_STORE_START
+ * @param numPages the number of pages
+ * @retval the erases.
+ */
+uint32_t FS_PageWear(uint32_t page, uint16_t numPages) {
+  FLASH_Wear wear;
+  uint32_t i;
+  Blox_Flash_GetWear((uint32_t)FS_ADDR(page), numPages, &wear);
+  for (i = page; i < page + numPages; i++) {
+    if (FS_IsBlank(FS_ADDR(i)) && Blox_Flash_GetPageErases((uint32_t)FS_ADDR(i)) > 0)
+      wear.total--;
+  }
+  return wear.total;
+}
+
+/**
+ * @brief Finds where a new file wears the flash least. Either end of each
+ *        free run it fits in is tried, so no run is split, and the pages
+ *        with the fewest erases win. Ties go to the smallest run.
+ * @param t the FAT
+ * @param numPages the number of pages needed
+ * @param page set to the first page to use
+ * @retval the index of the run in the free list, -1 if none is big enough.
+ */
+int32_t FS_ColdFit(const FS_Table *t, uint16_t numPages, uint16_t *page) {
+  int32_t best = -1;
+  uint32_t i, end, wear, best_wear = 0;
+  uint16_t start;
+  for (i = 0; i < t->numFree; i++) {
+    if (t->free[i].numPages < numPages)
+      continue;
+    for (end = 0; end < 2; end++) {
+      start = t->free[i].page + (end ? t->free[i].numPages - numPages : 0);
+      wear = FS_PageWear(start, numPages);
+      if (best < 0 || wear < best_wear
+            || (wear == best_wear && t->free[i].numPages < t->free[best].numPages)) {
+        best = i;
+        best_wear = wear;
+        *page = start;
+      }
     }
   }
-  return FS_OK;
+  return best;
+}
+
+/**
+ * @brief Finds the free run holding a given range of pages.
+ * @param t the FAT
+ * @param page the first page wanted
+ * @param numPages the number of pages wanted
+ * @retval the index of the run in the free list, -1 if the pages aren't free.
+ */
+int32_t FS_FindRun(const FS_Table *t, uint32_t page, uint16_t numPages) {
+  uint32_t i;
+  for (i = 0; i < t->numFree; i++) {
+    if (t->free[i].page <= page
+          && page + numPages <= t->free[i].page + t->free[i].numPages)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Takes a range of pages out of a free run, splitting the run if the
+ *        range is in its middle.
+ * @param t the FAT
+ * @param run the index of the run in the free list
+ * @param page the first page to take
+ * @param numPages the number of pages to take
+ * @retval None
+ */
+void FS_TakeRun(FS_Table *t, uint32_t run, uint16_t page, uint16_t numPages) {
+  FS_Extent *ext = &t->free[run];
+  uint16_t end = ext->page + ext->numPages;
+  uint32_t i;
+  
+  if (page == ext->page) {
+    ext->page += numPages;
+    ext->numPages -= numPages;
+    if (ext->numPages == 0) {
+      for (i = run; i < t->numFree-1; i++)
+        t->free[i] = t->free[i+1];
+      t->numFree--;
+    }
+  } else {
+    ext->numPages = page - ext->page;
+    if (page + numPages < end) {
+      for (i = t->numFree; i > run+1; i--)
+        t->free[i] = t->free[i-1];
+      t->free[run+1].page = page + numPages;
+      t->free[run+1].numPages = end - (page + numPages);
+      t->numFree++;
+    }
+  }
+  t->free_numPages -= numPages;
+}
+
+/**
+ * @brief Returns whether a file holds an app linked to run where it is
+ *        stored, which RCV_APP_AT records when it creates the file.
+ * @param file the file
+ * @retval TRUE if the app runs in place, FALSE if it runs from staging.
+ */
+uint8_t FS_IsInPlace(const FS_File *file) {
+  return (file->flags & FS_FLAG_IN_PLACE) != 0;
+}
+
+/**
+ * @brief Guesses whether a file from an older FAT, which has no flags, is
+ *        an app linked to run where it is stored, by checking its reset
+ *        vector points inside the file. Compressed images are never.
+ * @param file the file
+ * @retval TRUE if it looks linked to run in place, FALSE otherwise.
+ */
+uint8_t FS_LinkedHere(const FS_File *file) {
+  uint32_t reset = file->data[1];
+  if (file->data[0] == FS_LZ_MAGIC)
+    return FALSE;
+  return reset >= (uint32_t)file->data
+      && reset < (uint32_t)file->data + file->numPages * PAGE_SIZE;
 }
 
 /**
@@ -128,23 +905,27 @@ FS_STATUS FS_ChkValid(void) {
 FS_File * FS_GetFile(uint8_t id) {
   if (fat == 0)
 	  return 0;
-  if (id > (fat->numFiles-1))
+  if (id >= fat->numFiles)
 	  return 0;
-  return (FS_File *)(fat->table+id);
+  return FS_ENTRY(fat, id);
 }
 
 /**
- * @brief  Gets a file in the filesystem by looking for the filename.
+ * @brief  Gets a file in the filesystem by looking for the filename. Looks
+ *         the name's hash up in the FAT's index, so only files whose hash
+ *         matches have their names compared.
  * @param  name the name of the application.
  * @retval NULL if the file can't be found, a pointer otherwise.
  */
 FS_File * FS_GetFileFromName(char *name) {
-  uint8_t num_files = FS_GetNumFiles();
-  uint8_t i;
-  for (i = 0; i < num_files; i++) {
-    FS_File *file;
-    file = FS_GetFile(i);
-    if (memcmp(name, file->name, FS_FILE_MAX_NAME_LEN) == 0)
+  uint32_t slot, hash;
+  FS_File *file;
+  if (fat == 0)
+    return NULL;
+  hash = FS_NameHash(name);
+  for (slot = hash % FS_INDEX_SIZE; fat->index[slot] != 0; slot = (slot + 1) % FS_INDEX_SIZE) {
+    file = FS_ENTRY(fat, fat->index[slot] - 1);
+    if (file->hash == hash && strncmp(file->name, name, FS_FILE_MAX_NAME_LEN) == 0)
       return file;
   }
   return NULL;
@@ -157,56 +938,137 @@ FS_File * FS_GetFileFromName(char *name) {
 uint8_t FS_GetNumFiles(void) { return fat->numFiles; } 
 
 /**
- * @brief Deletes a file from the filesystem. Shifts data up so
- * 				fragmentation does not occur.
+ * @brief Deletes a file from the filesystem. Only the FAT is rewritten: the
+ *        file's pages go back on the free list and the last file takes its
+ *        id, so at most two directory pages change. Other files keep their
+ *        data where it is.
  * @param id the unique id of the file within the filesystem.
  * @retval An FS_STATUS indicating whether the delete was successful.
  */
 FS_STATUS FS_DeleteFile(uint8_t id) {
-  uint32_t i, j;
+  uint8_t last;
   FS_Table *fat_new;
+  FS_File *file, *moved;
   if (fat == 0)
 	  return FS_FAT_NOT_INIT;
-  if (id > (fat->numFiles-1))
+  if (id >= fat->numFiles)
 	  return FS_FILE_NOT_INIT;
-  fat_new = (FS_Table *)malloc(PAGE_SIZE);
-  memmove(fat_new, (const void *)fat, PAGE_SIZE);
+  fat_new = FS_Begin();
+  if (fat_new == NULL)
+    return FS_NO_MEM;
+  last = fat_new->numFiles - 1;
+  file = FS_Edit(fat_new, id);
+  moved = FS_Edit(fat_new, last);
+  if (file == NULL || moved == NULL) {
+    FS_Abort(fat_new);
+    return FS_NO_MEM;
+  }
   
-  if (fat_new->numFiles-1 == id) {
-    fat_new->free_top = (uint32_t *)((uint32_t)(fat_new->free_top) - fat_new->table[id].numPages * PAGE_SIZE);
-  } else {
-    fat_new->free_top = fat_new->table[id].data;
-    for (i = id; i < fat->numFiles-1; i++) {
-      fat_new->table[i].numPages = fat_new->table[i+1].numPages;
-      strcpy(fat_new->table[i].name, fat_new->table[i+1].name);      
-      fat_new->table[i].data = fat_new->free_top;
-      for (j = 0; j < fat_new->table[i].numPages; j++) {
-        FS_SwapPage((uint32_t *)((uint32_t)(fat_new->table[i+1].data)+ j*PAGE_SIZE),
-                    (uint32_t *)((uint32_t)(fat_new->table[i].data)  + j*PAGE_SIZE));
-      }
-      fat_new->free_top = (uint32_t *)((uint32_t)(fat_new->table[i].data) + fat_new->table[i].numPages * PAGE_SIZE);
-    }
+  FS_AddFree(fat_new, FS_PAGE(file->data), file->numPages);
+  if (file != moved) {
+    *file = *moved;
+    file->id = id;
   }
-
-  fat_new->free_numPages = (MEM_STORE_START+MEM_STORE_SIZE-(uint32_t)(fat_new->free_top))/PAGE_SIZE;
+  moved->id = FS_MAX_FILES;
   fat_new->numFiles--;
-  fat_new->table[fat_new->numFiles].id = FS_MAX_FILES;
   
-  FS_SwapPage((uint32_t *)fat_new, (uint32_t *)fat);
-  free(fat_new);
+  if (FS_Commit(fat_new) != FS_OK)
+    return FS_BAD_WRITE;
 
   return FS_ChkValid();
 }
 
 /**
- * @brief  Creates a new file of a given size in the filesystem.
+ * @brief Moves every file down to the start of the store so the free space
+ *        is one run. Only called on demand, since it costs an erase per
+ *        moved page. The FAT is rewritten after each file moves. Apps that
+ *        run in place stay where they are linked, so free space can be left
+ *        below them.
+ * @retval FS_OK if successful, another FS_STATUS if not.
+ */
+FS_STATUS FS_Compact(void) {
+  uint8_t order[FS_MAX_FILES];
+  uint32_t i, j, numPages, cursor = 0;
+  FS_Table *fat_new;
+  FS_File *file;
+  if (fat == 0)
+    return FS_FAT_NOT_INIT;
+  if (fat->numFree == 0 
+        || (fat->numFree == 1 && fat->free[0].page + fat->free[0].numPages == FS_STORE_PAGES))
+    return FS_OK;
+  
+  FS_SortFiles((const FS_Table *)fat, order);
+  for (i = 0; i < fat->numFiles; i++) {
+    file = FS_GetFile(order[i]);
+    if (FS_IsInPlace(file))
+      cursor = FS_PAGE(file->data);
+    else if (FS_PAGE(file->data) != cursor) {
+      for (j = 0; j < file->numPages; j++)
+        FS_SwapPage(FS_ADDR(FS_PAGE(file->data) + j), FS_ADDR(cursor + j));
+      fat_new = FS_Begin();
+      if (fat_new == NULL)
+        return FS_NO_MEM;
+      if (FS_Edit(fat_new, order[i]) == NULL) {
+        FS_Abort(fat_new);
+        return FS_NO_MEM;
+      }
+      FS_ENTRY(fat_new, order[i])->data = FS_ADDR(cursor);
+      fat_new->numFree = FS_BuildFreeList(fat_new, fat_new->free, &numPages);
+      fat_new->free_numPages = numPages;
+      if (FS_Commit(fat_new) != FS_OK)
+        return FS_BAD_WRITE;
+      file = FS_GetFile(order[i]);
+    }
+    cursor += file->numPages;
+  }
+  
+  return FS_ChkValid();
+}
+
+/**
+ * @brief  Creates a new file of a given size in the filesystem. Takes the
+ *         least worn end of the free runs it fits in, compacting first if
+ *         the free space is only there in pieces.
  * @param  name the name of the new file
  * @param  numPages the number of pages the new file needs
  * @retval The unique id of the file within the filesystem. FS_MAX_FILES on error.
  */
 uint8_t FS_CreateFile(char *name, uint8_t numPages) {
+  return FS_CreateFileAt(name, numPages, NULL, CRC_NONE);
+}
+
+/**
+ * @brief  Creates a new file at a given address, for apps linked to run in
+ *         place, and marks it FS_FLAG_IN_PLACE so it is run and left there.
+ *         The CRC its pages will have can be given up front, so a
+ *         partly written file fails FS_VerifyFile and sealing it costs no
+ *         FAT write.
+ * @param  name the name of the new file
+ * @param  numPages the number of pages the new file needs
+ * @param  addr the page-aligned address in the file store, NULL for anywhere
+ * @param  crc the Blox_CRC_Calc of the pages once written, CRC_NONE if unknown
+ * @retval The unique id of the file within the filesystem. FS_MAX_FILES on
+ *         error, including when those pages are taken.
+ */
+uint8_t FS_CreateFileAt(char *name, uint8_t numPages, uint32_t *addr, uint32_t crc) {
+  return FS_NewFile(name, numPages, addr, crc, (addr != NULL) ? FS_FLAG_IN_PLACE : 0);
+}
+
+/**
+ * @brief  Creates a new file, see FS_CreateFileAt.
+ * @param  name the name of the new file
+ * @param  numPages the number of pages the new file needs
+ * @param  addr the page-aligned address in the file store, NULL for anywhere
+ * @param  crc the Blox_CRC_Calc of the pages once written, CRC_NONE if unknown
+ * @param  flags the FS_FLAG_* bits of the new file
+ * @retval The unique id of the file within the filesystem. FS_MAX_FILES on error.
+ */
+uint8_t FS_NewFile(char *name, uint8_t numPages, uint32_t *addr, uint32_t crc, uint8_t flags) {
 uint8_t new_id;
+int32_t run;
+uint16_t page;
 FS_Table *new_fat;
+FS_File *file;
   Blox_DebugStr("Creating a file!\r\n");
   if (fat == 0)
     return FS_MAX_FILES;
@@ -214,18 +1076,46 @@ FS_Table *new_fat;
     return FS_MAX_FILES;
   if (fat->free_numPages < numPages || numPages == 0)
     return FS_MAX_FILES;
-  new_fat = (FS_Table *)malloc(PAGE_SIZE);
-  memmove(new_fat, (const void *)fat, PAGE_SIZE);
-  new_id = new_fat->numFiles++;
-  new_fat->table[new_id].id = new_id;
-  strcpy(new_fat->table[new_id].name, name);
-  new_fat->table[new_id].numPages = numPages;
-  new_fat->table[new_id].data = new_fat->free_top;
-  new_fat->free_top = (uint32_t *)((uint32_t)new_fat->free_top + new_fat->table[new_id].numPages * PAGE_SIZE);
-  new_fat->free_numPages -= new_fat->table[new_id].numPages; 
+  if (addr != NULL) {
+    if ((uint32_t)addr < MEM_STORE_START || ((uint32_t)addr - MEM_STORE_START) % PAGE_SIZE
+          || FS_FindRun((const FS_Table *)fat, FS_PAGE(addr), numPages) < 0)
+      return FS_MAX_FILES;
+  } else if (FS_BestFit((const FS_Table *)fat, numPages) < 0) {
+    //In-place apps stay put, so compacting may still leave no run big enough
+    if (FS_Compact() != FS_OK || FS_BestFit((const FS_Table *)fat, numPages) < 0)
+      return FS_MAX_FILES;
+  }
+  new_fat = FS_Begin();
+  if (new_fat == NULL)
+    return FS_MAX_FILES;
+  new_id = new_fat->numFiles;
+  file = FS_Edit(new_fat, new_id);
+  if (file == NULL) {
+    FS_Abort(new_fat);
+    return FS_MAX_FILES;
+  }
+  new_fat->numFiles++;
+  file->id = new_id;
+  memset(file->name, 0, FS_FILE_MAX_NAME_LEN);
+  strcpy(file->name, name);
+  file->hash = FS_NameHash(name);
+  file->numPages = numPages;
+  file->flags = flags;
+  if (addr == NULL) {
+    run = FS_ColdFit(new_fat, numPages, &page);
+    addr = FS_ADDR(page);
+  } else
+    run = FS_FindRun(new_fat, FS_PAGE(addr), numPages);
+  if (run < 0) {
+    FS_Abort(new_fat);
+    return FS_MAX_FILES;
+  }
+  file->data = addr;
+  file->crc = crc;
+  FS_TakeRun(new_fat, run, FS_PAGE(addr), numPages);
   
-  FS_SwapPage((uint32_t *)new_fat, (uint32_t *)fat);
-  free(new_fat);
+  if (FS_Commit(new_fat) != FS_OK)
+    return FS_MAX_FILES;
   
   Blox_DebugStr("Created a new file!\r\n");
 
@@ -245,24 +1135,447 @@ FS_Table *new_fat;
  * @retval An FS_STATUS denoting whether the write was successful.
  */
 FS_STATUS FS_WriteFilePage(uint8_t id, uint32_t *data, uint32_t page_offset) {
-  if(page_offset > fat->table[id].numPages-1)
+  FS_File *file = FS_GetFile(id);
+  if(file == NULL || page_offset > file->numPages-1)
     return FS_BAD_WRITE;
-  FS_SwapPage(data, (uint32_t *)((uint32_t)(fat->table[id].data) + page_offset*PAGE_SIZE));
+  FS_SwapPage(data, (uint32_t *)((uint32_t)(file->data) + page_offset*PAGE_SIZE));
+  return FS_OK;
+}
+
+/**
+ * @brief  Records the CRC of a file once all its pages are written, so it
+ *         can be checked before it is run. A file created with its CRC is
+ *         only checked against it.
+ * @param  id the unique id of the file within the filesystem
+ * @retval FS_OK if the CRC is recorded or matches, FS_BAD_IMAGE if it
+ *         doesn't match, another FS_STATUS if the FAT couldn't be rewritten.
+ */
+FS_STATUS FS_SealFile(uint8_t id) {
+  FS_Table *fat_new;
+  FS_File *file;
+  if (fat == 0)
+	  return FS_FAT_NOT_INIT;
+  if (id >= fat->numFiles)
+	  return FS_FILE_NOT_INIT;
+  if (FS_GetFile(id)->crc != CRC_NONE)
+    return FS_VerifyFile(FS_GetFile(id));
+  fat_new = FS_Begin();
+  if (fat_new == NULL)
+    return FS_NO_MEM;
+  file = FS_Edit(fat_new, id);
+  if (file == NULL) {
+    FS_Abort(fat_new);
+    return FS_NO_MEM;
+  }
+  file->crc = Blox_CRC_Calc(file->data, file->numPages*PAGE_SIZE/WORD_SIZE);
+  
+  if (FS_Commit(fat_new) != FS_OK)
+    return FS_BAD_WRITE;
+  return FS_OK;
+}
+
+/**
+ * @brief  Checks a file's pages against the CRC FS_SealFile recorded.
+ * @param  file the file
+ * @retval FS_OK if they match or the file was never sealed, FS_BAD_IMAGE if not.
+ */
+FS_STATUS FS_VerifyFile(const FS_File *file) {
+  if (file->crc == CRC_NONE
+        || file->crc == Blox_CRC_Calc(file->data, file->numPages*PAGE_SIZE/WORD_SIZE))
+    return FS_OK;
+  return FS_BAD_IMAGE;
+}
+
+/**
+ * @brief  Opens a data file for appending and reading, creating it with
+ *         FS_DATA_EXTENT pages if there isn't one. Works out the size from
+ *         the sync slots. A page holding data programmed after its last
+ *         sync is closed off, since that data can't be programmed over.
+ * @param  df the handle to fill in
+ * @param  name the name of the file
+ * @retval FS_OK if successful, FS_BAD_IMAGE if the file isn't a data file,
+ *         another FS_STATUS if not.
+ */
+FS_STATUS FS_Open(FS_DataFile *df, char *name) {
+  FS_File *file;
+  const uint8_t *page;
+  uint16_t bytes, end, i;
+  uint8_t k;
+  if (fat == 0)
+    return FS_FAT_NOT_INIT;
+  file = FS_GetFileFromName(name);
+  if (file == NULL) {
+    if (FS_NewFile(name, FS_DATA_EXTENT, NULL, CRC_NONE, FS_FLAG_DATA) == FS_MAX_FILES)
+      return FS_FULL;
+    file = FS_GetFileFromName(name);
+    FS_ErasePages(FS_PAGE(file->data), file->numPages);
+  }
+  if (!(file->flags & FS_FLAG_DATA))
+    return FS_BAD_IMAGE;
+  
+  memset(df, 0, sizeof(FS_DataFile));
+  strncpy(df->name, name, FS_FILE_MAX_NAME_LEN-1);
+  for (df->page = 0; df->page < file->numPages; df->page++) {
+    page = (const uint8_t *)file->data + df->page*PAGE_SIZE;
+    k = FS_DataSlots(page, &bytes, &end);
+    df->size += bytes;
+    if (FS_DATA_DONE(k, end))
+      continue;
+    df->slot = k;
+    df->pos = df->mark = FS_HALF_UP(end);
+    for (i = df->pos; i < FS_DATA_PAYLOAD && *(const uint16_t *)(page + i) == FLASH_ERASED_HALF; i += 2) ;
+    if (i == FS_DATA_PAYLOAD)
+      break;
+    Blox_Flash_Unlock();
+    for ( ; k < FS_DATA_SLOTS; k++)
+      Blox_Flash_ProgramHalfWord((uint32_t)page + FS_DATA_PAYLOAD + k*sizeof(uint16_t), end);
+    Blox_Flash_Lock();
+  }
+  if (df->page >= file->numPages) {
+    df->slot = 0;
+    df->pos = df->mark = 0;
+  } else
+    FS_ErasePages(FS_PAGE(file->data) + df->page + 1, file->numPages - df->page - 1);
   return FS_OK;
 }
 
 /**
- * @brief  Swaps a page in RAM with a page in Flash.
+ * @brief  Appends data to a data file. Only every FS_DATA_BUF_LEN bytes are
+ *         programmed, and nothing is erased unless the file has to grow
+ *         onto pages FS_PreErase hasn't blanked.
+ * @param  df the handle from FS_Open
+ * @param  data the bytes to append
+ * @param  len the number of bytes
+ * @retval FS_OK if successful, FS_FULL if the file can't grow, another
+ *         FS_STATUS if not.
+ */
+FS_STATUS FS_Append(FS_DataFile *df, const void *data, uint32_t len) {
+  const uint8_t *src = (const uint8_t *)data;
+  uint32_t n;
+  FS_STATUS status;
+  while (len > 0) {
+    n = FS_DATA_BUF_LEN - df->numBuf;
+    if (n > len)
+      n = len;
+    memmove(df->buf + df->numBuf, src, n);
+    df->numBuf += n;
+    df->size += n;
+    src += n;
+    len -= n;
+    if (df->numBuf == FS_DATA_BUF_LEN) {
+      status = FS_DataFlush(df, FALSE);
+      if (status != FS_OK)
+        return status;
+    }
+  }
+  return FS_OK;
+}
+
+/**
+ * @brief  Reads from a data file, including what is still buffered.
+ * @param  df the handle from FS_Open
+ * @param  offset the byte in the file to start at
+ * @param  data where to copy the bytes
+ * @param  len the most bytes to copy
+ * @retval the number of bytes copied, 0 past the end of the file.
+ */
+uint32_t FS_Read(FS_DataFile *df, uint32_t offset, void *data, uint32_t len) {
+  FS_File *file = FS_GetFileFromName(df->name);
+  const uint8_t *page;
+  const uint16_t *slots;
+  uint32_t p, at = 0;
+  uint16_t start;
+  uint8_t k;
+  if (file == NULL || offset >= df->size)
+    return 0;
+  if (len > df->size - offset)
+    len = df->size - offset;
+  
+  for (p = 0; p < file->numPages && p <= df->page && at < offset + len; p++) {
+    page = (const uint8_t *)file->data + p*PAGE_SIZE;
+    slots = (const uint16_t *)(page + FS_DATA_PAYLOAD);
+    start = 0;
+    for (k = 0; k < FS_DATA_SLOTS && slots[k] != FLASH_ERASED_HALF; k++) {
+      if (slots[k] > start)
+        FS_CopySpan(page + start, slots[k] - start, &at, offset, data, len);
+      start = FS_HALF_UP(slots[k]);
+    }
+    if (p == df->page)
+      FS_CopySpan(page + df->mark, df->pos - df->mark, &at, offset, data, len);
+  }
+  FS_CopySpan(df->buf, df->numBuf, &at, offset, data, len);
+  return len;
+}
+
+/**
+ * @brief  Programs whatever a data file has buffered and records it in the
+ *         page's next sync slot, so it survives a reset. Costs one slot of
+ *         FS_DATA_SLOTS in the page, so syncing less often fits more data.
+ * @param  df the handle from FS_Open
+ * @retval FS_OK if successful, another FS_STATUS if not.
+ */
+FS_STATUS FS_Sync(FS_DataFile *df) {
+  return FS_DataFlush(df, TRUE);
+}
+
+/**
+ * @brief  Copies the part of a span of file data that a read wants.
+ * @param  src the span
+ * @param  n the bytes in the span
+ * @param  at the offset in the file the span starts at, moved past it
+ * @param  offset the offset in the file the read starts at
+ * @param  out where the read copies to
+ * @param  len the bytes the read wants
+ * @retval None
+ */
+void FS_CopySpan(const uint8_t *src, uint32_t n, uint32_t *at, uint32_t offset,
+                 uint8_t *out, uint32_t len) {
+  uint32_t lo = *at > offset ? *at : offset;
+  uint32_t hi = *at + n < offset + len ? *at + n : offset + len;
+  if (lo < hi)
+    memmove(out + (lo - offset), src + (lo - *at), hi - lo);
+  *at += n;
+}
+
+/**
+ * @brief  Reads the sync slots of a data file page. The data synced in a
+ *         page runs from the start of the payload to the first slot, then
+ *         from the halfword after that to the next slot, and so on.
+ * @param  page the page
+ * @param  bytes set to the bytes of data the slots cover
+ * @param  end set to the last slot, 0 if none are used
+ * @retval the number of slots used.
+ */
+uint8_t FS_DataSlots(const uint8_t *page, uint16_t *bytes, uint16_t *end) {
+  const uint16_t *slots = (const uint16_t *)(page + FS_DATA_PAYLOAD);
+  uint16_t start = 0;
+  uint8_t k;
+  *bytes = 0;
+  *end = 0;
+  for (k = 0; k < FS_DATA_SLOTS && slots[k] != FLASH_ERASED_HALF; k++) {
+    *end = slots[k];
+    if (*end > start)
+      *bytes += *end - start;
+    start = FS_HALF_UP(*end);
+  }
+  return k;
+}
+
+/**
+ * @brief  Gives a data file FS_DATA_EXTENT more pages. Takes the free pages
+ *         right after it if there are any, otherwise moves it to the least
+ *         worn run it fits in with the new pages.
+ * @param  df the handle from FS_Open
+ * @retval FS_OK if successful, FS_FULL if there's no room, another
+ *         FS_STATUS if not.
+ */
+FS_STATUS FS_DataGrow(FS_DataFile *df) {
+  FS_File *file = FS_GetFileFromName(df->name);
+  FS_Table *fat_new;
+  FS_File *entry;
+  int32_t run;
+  uint16_t page, old, numPages;
+  uint32_t i;
+  if (file == NULL)
+    return FS_FILE_NOT_INIT;
+  old = FS_PAGE(file->data);
+  numPages = file->numPages;
+  if (numPages + FS_DATA_EXTENT > 0xFF)
+    return FS_FULL;
+  run = FS_FindRun((const FS_Table *)fat, old + numPages, FS_DATA_EXTENT);
+  page = old;
+  if (run < 0) {
+    run = FS_ColdFit((const FS_Table *)fat, numPages + FS_DATA_EXTENT, &page);
+    if (run < 0)
+      return FS_FULL;
+    for (i = 0; i < numPages; i++)
+      FS_SwapPage(FS_ADDR(old + i), FS_ADDR(page + i));
+  }
+  
+  fat_new = FS_Begin();
+  if (fat_new == NULL)
+    return FS_NO_MEM;
+  entry = FS_Edit(fat_new, file->id);
+  if (entry == NULL) {
+    FS_Abort(fat_new);
+    return FS_NO_MEM;
+  }
+  if (page == old)
+    FS_TakeRun(fat_new, run, old + numPages, FS_DATA_EXTENT);
+  else {
+    FS_TakeRun(fat_new, run, page, numPages + FS_DATA_EXTENT);
+    FS_AddFree(fat_new, old, numPages);
+  }
+  entry->data = FS_ADDR(page);
+  entry->numPages = numPages + FS_DATA_EXTENT;
+  if (FS_Commit(fat_new) != FS_OK)
+    return FS_BAD_WRITE;
+  FS_ErasePages(page + numPages, FS_DATA_EXTENT);
+  return FS_OK;
+}
+
+/**
+ * @brief  Records in a data file page's next slot that it is written up to
+ *         a point, moving on to the next page if that is the page's last.
+ *         The flash must be unlocked.
+ * @param  df the handle from FS_Open
+ * @param  page the page appends are going to
+ * @param  end the byte offset in the payload the data runs to
+ * @retval FS_OK if successful, FS_BAD_WRITE if not.
+ */
+FS_STATUS FS_DataMark(FS_DataFile *df, uint8_t *page, uint16_t end) {
+  if (Blox_Flash_ProgramHalfWord((uint32_t)page + FS_DATA_PAYLOAD + df->slot*sizeof(uint16_t), end)
+        != FLASH_COMPLETE)
+    return FS_BAD_WRITE;
+  df->mark = df->pos;
+  if (FS_DATA_DONE(++df->slot, end)) {
+    df->page++;
+    df->pos = df->mark = 0;
+    df->slot = 0;
+  }
+  return FS_OK;
+}
+
+/**
+ * @brief  Programs a data file's buffer as halfwords. An odd byte is kept
+ *         for next time unless syncing, when it is padded out.
+ * @param  df the handle from FS_Open
+ * @param  sync TRUE to program everything and record it in a sync slot
+ * @retval FS_OK if successful, another FS_STATUS if not.
+ */
+FS_STATUS FS_DataFlush(FS_DataFile *df, uint8_t sync) {
+  FS_File *file = FS_GetFileFromName(df->name);
+  uint8_t *page;
+  uint16_t i, n, end = df->pos, done = 0;
+  uint16_t num = sync ? df->numBuf : df->numBuf & ~1;
+  FS_STATUS status = FS_OK;
+  if (file == NULL)
+    return FS_FILE_NOT_INIT;
+  
+  Blox_Flash_Unlock();
+  while (status == FS_OK && done < num) {
+    if (df->page == file->numPages) {
+      status = FS_DataGrow(df);
+      file = FS_GetFileFromName(df->name);
+      Blox_Flash_Unlock();
+      continue;
+    }
+    page = (uint8_t *)file->data + df->page*PAGE_SIZE;
+    n = num - done;
+    if (n > FS_DATA_PAYLOAD - df->pos)
+      n = FS_DATA_PAYLOAD - df->pos;
+    for (i = 0; i < n && status == FS_OK; i += 2) {
+      if (Blox_Flash_ProgramHalfWord((uint32_t)page + df->pos + i, df->buf[done + i]
+            | (i + 1 < n ? df->buf[done + i + 1] : 0xFF) << 8) != FLASH_COMPLETE)
+        status = FS_BAD_WRITE;
+    }
+    end = df->pos + n;
+    df->pos = FS_HALF_UP(end);
+    done += n;
+    if (status == FS_OK && df->pos == FS_DATA_PAYLOAD)
+      status = FS_DataMark(df, page, end);
+  }
+  if (status == FS_OK && sync && df->pos > df->mark)
+    status = FS_DataMark(df, (uint8_t *)file->data + df->page*PAGE_SIZE, end);
+  Blox_Flash_Lock();
+  
+  memmove(df->buf, df->buf + done, df->numBuf - done);
+  df->numBuf -= done;
+  return status;
+}
+
+/**
+ * @brief  Erases whichever of a range of store pages aren't blank.
+ * @param  page the first page, counted from MEM_STORE_START
+ * @param  numPages the number of pages
+ * @retval None.
+ */
+void FS_ErasePages(uint32_t page, uint16_t numPages) {
+  uint32_t i;
+  for (i = page; i < page + numPages; i++) {
+    if (FS_IsBlank(FS_ADDR(i)))
+      continue;
+    Blox_Flash_Unlock();
+    Blox_Flash_ErasePage((uint32_t)FS_ADDR(i));
+    Blox_Flash_Lock();
+  }
+}
+
+/**
+ * @brief  Checks whether a page of flash is erased.
+ * @param  page the address of the start of the page
+ * @retval TRUE if every word is blank, FALSE otherwise.
+ */
+uint8_t FS_IsBlank(const uint32_t *page) {
+  uint32_t i;
+  for (i = 0; i < PAGE_SIZE/WORD_SIZE; i++) {
+    if (page[i] != 0xFFFFFFFF)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief  Erases one page ahead of time, so that later writes only have to
+ *         program. The FAT copy that isn't live comes first, then the spare
+ *         directory pages, then free store pages in address order until
+ *         FS_PREERASE_PAGES of them are blank.
+ *         Meant to be the event loop's idle hook: each call erases at most
+ *         one page, and calls do nothing once the pool is full until the
+ *         FAT next changes.
+ * @retval None.
+ */
+void FS_PreErase(void) {
+  uint32_t i, j, page, blank = 0;
+  uint32_t *spare = (uint32_t *)MEM_FAT_START;
+  if (fat == 0 || preErased)
+    return;
+  if ((uint32_t)fat == MEM_FAT_START)
+    spare = (uint32_t *)MEM_FAT_ALT_START;
+  if (!FS_IsBlank(spare)) {
+    Blox_Flash_Unlock();
+    Blox_Flash_ErasePage((uint32_t)spare);
+    Blox_Flash_Lock();
+    return;
+  }
+  for (i = 0; i < FS_DIR_POOL; i++) {
+    for (j = 0; j < FS_DIR_PAGES && fat->dir[j] != (uint32_t)FS_DIR_ADDR(i); j++) ;
+    if (j == FS_DIR_PAGES && !FS_IsBlank(FS_DIR_ADDR(i))) {
+      Blox_Flash_Unlock();
+      Blox_Flash_ErasePage((uint32_t)FS_DIR_ADDR(i));
+      Blox_Flash_Lock();
+      return;
+    }
+  }
+  
+  for (i = 0; i < fat->numFree; i++) {
+    for (page = fat->free[i].page; page < fat->free[i].page + fat->free[i].numPages; page++) {
+      if (FS_IsBlank(FS_ADDR(page))) {
+        if (++blank >= FS_PREERASE_PAGES) {
+          preErased = TRUE;
+          return;
+        }
+        continue;
+      }
+      Blox_Flash_Unlock();
+      Blox_Flash_ErasePage((uint32_t)FS_ADDR(page));
+      Blox_Flash_Lock();
+      return;
+    }
+  }
+  preErased = TRUE;
+}
+
+/**
+ * @brief  Swaps a page in RAM with a page in Flash. Skips the erase and
+ *         the programming that Blox_Flash_WritePage finds it doesn't need.
  * @param  src the address of the start of the page in RAM
  * @param  dst the address of the start of the page in Flash
  * @retval None.
  */
 void FS_SwapPage(uint32_t *src, uint32_t *dst) {
-int i;
-  FLASH_Unlock();
-  FLASH_ErasePage((uint32_t)dst);
-  for(i = 0; i < PAGE_SIZE/WORD_SIZE; i++)
-    FLASH_ProgramWord((uint32_t)(dst++), src[i]);
+  Blox_Flash_Unlock();
+  Blox_Flash_WritePage((uint32_t)dst, src);
 }
 
 /**
@@ -278,33 +1591,162 @@ uint32_t FS_RoundPageUp(uint32_t size) {
 }
 
 /**
- * @brief  De-initializes the system and runs the application stored at the file id.
+ * @brief  De-initializes the system and runs the application stored at the
+ *         file id. Apps linked to where they are stored run in place; the
+ *         rest are copied to the staging area first. Either way the code
+ *         that would run is checked against its CRC, and not run if it
+ *         doesn't match.
  * @param  file_id the id of the file to be run.
  * @retval None.
  */
 void FS_RunFile(uint8_t file_id) {
-  uint32_t i;
   FS_File *file = FS_GetFile(file_id);
-  //Swap to staging area
-  for (i = 0; i < file->numPages; i++) {
-    FS_SwapPage((uint32_t *)((char *)(file->data)+i*PAGE_SIZE),
-                (uint32_t *)((char *)MEM_STAGE_START+i*PAGE_SIZE));
+  const FS_LZHeader *hdr = (const FS_LZHeader *)file->data;
+  uint32_t crc = file->crc;
+  if (hdr->magic == FS_LZ_MAGIC)
+    crc = hdr->crc;
+  if (FS_IsInPlace(file)) {
+    if (FS_VerifyFile(file) != FS_OK) {
+      Blox_DebugStr("FS_RunFile app fails its CRC\r\n");
+      return;
+    }
+    *(uint32_t *)FS_APP_ADDR_LOC = (uint32_t)file->data;
+  } else {
+    if (FS_StagedPages(file) > FS_STAGE_PAGES) {
+      Blox_DebugPat("FS_RunFile app too big to stage: %d pages\r\n", FS_StagedPages(file));
+      return;
+    }
+    if (FS_Stage(file) != FS_OK) {
+      Blox_DebugStr("FS_RunFile staging failed\r\n");
+      return;
+    }
+    if (crc != CRC_NONE && crc != Blox_CRC_Calc((const uint32_t *)MEM_STAGE_START, 
+                                  FS_StagedPages(file)*PAGE_SIZE/WORD_SIZE)) {
+      Blox_DebugStr("FS_RunFile staged app fails its CRC\r\n");
+      Blox_KV_Delete(KV_KEY_STAGE);
+      return;
+    }
+    *(uint32_t *)FS_APP_ADDR_LOC = MEM_STAGE_START;
   }
 
+  if (Blox_Flash_GetEraseCount() != wearSaved)
+    FS_SaveWear();
   FS_SetAppFlag(1);
   NVIC_SystemReset();
 }
 
 /**
- * @brief  Runs the application stored in the staging area. Assumes from a system reset.
+ * @brief  Hashes a page of flash with the CRC peripheral.
+ * @param  page the address of the start of the page
+ * @retval the hash.
+ */
+uint32_t FS_HashPage(const uint32_t *page) {
+  return Blox_CRC_Calc(page, PAGE_SIZE/WORD_SIZE);
+}
+
+/**
+ * @brief  Checks the start of an uploaded app. Compressed images must
+ *         decompress to something that fits in staging.
+ * @param  page the app's first page
+ * @param  size the length of the upload
+ * @retval FS_OK if the image looks valid, FS_BAD_IMAGE if not.
+ */
+FS_STATUS FS_ChkImage(const uint32_t *page, uint32_t size) {
+  const FS_LZHeader *hdr = (const FS_LZHeader *)page;
+  if (hdr->magic != FS_LZ_MAGIC)
+    return FS_OK;
+  if (size < sizeof(FS_LZHeader) || hdr->size > MEM_START_SIZE
+        || hdr->lzSize > size - sizeof(FS_LZHeader))
+    return FS_BAD_IMAGE;
+  return FS_OK;
+}
+
+/**
+ * @brief  Returns how many staging pages a file takes once decompressed.
+ * @param  file the file
+ * @retval the number of pages.
+ */
+uint32_t FS_StagedPages(const FS_File *file) {
+  const FS_LZHeader *hdr = (const FS_LZHeader *)file->data;
+  if (hdr->magic == FS_LZ_MAGIC)
+    return FS_RoundPageUp(hdr->size);
+  return file->numPages;
+}
+
+/**
+ * @brief  Copies a file into the staging area, rewriting only the pages
+ *         whose hash differs from what the KV store says was staged. Does
+ *         nothing if the same image is already staged. The record is
+ *         deleted while pages are being rewritten, so an interrupted copy
+ *         is redone in full next time. Compressed files are decompressed a
+ *         page at a time through a single page of heap, with matches read
+ *         back out of the pages already staged.
+ * @param  file the file to stage, at most FS_STAGE_PAGES long
+ * @retval FS_OK if successful, another FS_STATUS if not.
+ */
+FS_STATUS FS_Stage(const FS_File *file) {
+  const FS_LZHeader *hdr = (const FS_LZHeader *)file->data;
+  FS_StageRecord staged;
+  uint16_t len = sizeof(FS_StageRecord);
+  uint32_t i, n, hash, numPages = FS_StagedPages(file);
+  uint8_t recorded = TRUE;
+  uint32_t *src, *buf = NULL;
+  BloxLZ lz;
+
+  if (hdr->magic == FS_LZ_MAGIC) {
+    buf = (uint32_t *)malloc(PAGE_SIZE);
+    if (buf == NULL)
+      return FS_NO_MEM;
+    Blox_LZ_Init(&lz, (const uint8_t *)(hdr + 1), hdr->lzSize);
+  }
+  if (Blox_KV_Read(KV_KEY_STAGE, &staged, &len) != KV_OK || len != sizeof(FS_StageRecord))
+    staged.known = 0;
+
+  for (i = 0; i < numPages; i++) {
+    if (buf != NULL) {
+      n = Blox_LZ_Decode(&lz, (uint8_t *)buf, PAGE_SIZE, (const uint8_t *)MEM_STAGE_START);
+      if (lz.error || (n < PAGE_SIZE && lz.pos != hdr->size)) {
+        Blox_DebugPat("FS_Stage bad compressed image at %d\r\n", lz.pos);
+        free(buf);
+        return FS_BAD_IMAGE;
+      }
+      memset((uint8_t *)buf + n, 0, PAGE_SIZE - n);
+      src = buf;
+    } else
+      src = (uint32_t *)((char *)(file->data)+i*PAGE_SIZE);
+
+    hash = FS_HashPage(src);
+    if (!(staged.known & (1u << i)) || staged.hash[i] != hash) {
+      if (recorded) {
+        Blox_KV_Delete(KV_KEY_STAGE);
+        recorded = FALSE;
+      }
+      FS_SwapPage(src, (uint32_t *)((char *)MEM_STAGE_START+i*PAGE_SIZE));
+    }
+    staged.hash[i] = hash;
+    staged.known |= 1u << i;
+  }
+
+  if (!recorded)
+    Blox_KV_Write(KV_KEY_STAGE, &staged, sizeof(FS_StageRecord));
+  if (buf != NULL)
+    free(buf);
+  return FS_OK;
+}
+
+/**
+ * @brief  Runs the application FS_RunFile set up, from the staging area or
+ *         from the file store. Assumes from a system reset.
  * @retval None.
  */
-void FS_RunStage(void) {
+void FS_RunApp(void) {
   uint32_t app_addr;
   volatile uint32_t jump_addr;
   void (*app_fn)(void);
   //Deinit everything, set up vector/stack, and jump  
-  app_addr = MEM_STAGE_START;  
+  app_addr = *(uint32_t *)FS_APP_ADDR_LOC;
+  if (app_addr < MEM_STORE_START || app_addr >= MEM_STORE_START + MEM_STORE_SIZE)
+    app_addr = MEM_STAGE_START;
   jump_addr = *(__IO uint32_t *) (app_addr+4);
   app_fn = (void (*)(void))jump_addr;  
 
@@ -0,0 +1,318 @@
+/**
+ * @file    blox_flash.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Erases and programs the internal flash. The routines that wait on
+ *          the flash controller run from SRAM so that RAM-resident interrupts keep
+ *          running while an erase or program is in progress.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "blox_flash.h"
+
+/**
+ * @ingroup driver_flash
+ * @{
+ */
+
+/* Private function prototypes */
+FLASH_Status Flash_Wait(void);
+void Flash_RunDeferred(void);
+
+/**
+ * @brief Set while the flash controller is erasing or programming.
+ */
+static volatile uint8_t flash_busy = FALSE;
+
+/**
+ * @brief Work interrupts asked to have done once flash is readable again.
+ */
+static ptrVoidFn deferred[FLASH_MAX_DEFERRED];
+static volatile uint8_t numDeferred = 0;
+
+/**
+ * @brief Counters since boot.
+ */
+static FLASH_Stats stats;
+
+/**
+ * @brief Erases of each page. Starts at zero each boot; the filesystem
+ *        adds in the counts it saved last time.
+ */
+static uint16_t wear[FLASH_NUM_PAGES];
+
+/**
+ * @brief Unlocks the flash controller for erasing and programming.
+ * @retval None
+ */
+void Blox_Flash_Unlock(void) {
+  FLASH_Unlock();
+}
+
+/**
+ * @brief Locks the flash controller.
+ * @retval None
+ */
+void Blox_Flash_Lock(void) {
+  FLASH_Lock();
+}
+
+/**
+ * @brief Waits for the flash controller to finish the current operation.
+ *        Runs from SRAM, since any fetch from flash stalls until then.
+ * @retval FLASH_COMPLETE, or the error the controller reported.
+ */
+BLOX_RAMFUNC FLASH_Status Flash_Wait(void) {
+  uint32_t sr;
+  while ((sr = FLASH->SR) & FLASH_SR_BSY) ;
+  FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+  if (sr & FLASH_SR_PGERR)
+    return FLASH_ERROR_PG;
+  if (sr & FLASH_SR_WRPRTERR)
+    return FLASH_ERROR_WRP;
+  return FLASH_COMPLETE;
+}
+
+/**
+ * @brief Erases a page of flash. The flash must be unlocked.
+ * @param addr the address of the start of the page
+ * @retval FLASH_COMPLETE if successful, another FLASH_Status if not.
+ */
+BLOX_RAMFUNC FLASH_Status Blox_Flash_ErasePage(uint32_t addr) {
+  FLASH_Status status;
+  flash_busy = TRUE;
+  Flash_Wait();
+  FLASH->CR |= FLASH_CR_PER;
+  FLASH->AR = addr;
+  FLASH->CR |= FLASH_CR_STRT;
+  status = Flash_Wait();
+  FLASH->CR &= ~FLASH_CR_PER;
+  flash_busy = FALSE;
+  stats.erases++;
+  if (FLASH_PAGE(addr) < FLASH_NUM_PAGES && wear[FLASH_PAGE(addr)] != 0xFFFF)
+    wear[FLASH_PAGE(addr)]++;
+
+  if (numDeferred)
+    Flash_RunDeferred();
+  return status;
+}
+
+/**
+ * @brief Programs a halfword of flash. The flash must be unlocked and the
+ *        halfword erased.
+ * @param addr the halfword-aligned address to program
+ * @param data the value to program
+ * @retval FLASH_COMPLETE if successful, another FLASH_Status if not.
+ */
+BLOX_RAMFUNC FLASH_Status Blox_Flash_ProgramHalfWord(uint32_t addr, uint16_t data) {
+  FLASH_Status status;
+  flash_busy = TRUE;
+  Flash_Wait();
+  FLASH->CR |= FLASH_CR_PG;
+  *(__IO uint16_t *)addr = data;
+  status = Flash_Wait();
+  FLASH->CR &= ~FLASH_CR_PG;
+  flash_busy = FALSE;
+  stats.halfWords++;
+
+  if (numDeferred)
+    Flash_RunDeferred();
+  return status;
+}
+
+/**
+ * @brief Programs a word of flash as two halfwords.
+ * @param addr the word-aligned address to program
+ * @param data the value to program
+ * @retval FLASH_COMPLETE if successful, another FLASH_Status if not.
+ */
+FLASH_Status Blox_Flash_ProgramWord(uint32_t addr, uint32_t data) {
+  FLASH_Status status = Blox_Flash_ProgramHalfWord(addr, data & 0xFFFF);
+  if (status != FLASH_COMPLETE)
+    return status;
+  return Blox_Flash_ProgramHalfWord(addr + 2, data >> 16);
+}
+
+/**
+ * @brief Writes a page of data over a page of flash, doing as little as
+ *        it can. Nothing is done if the page already holds the data. The
+ *        erase is skipped if every halfword that changes is still blank,
+ *        and only halfwords that differ are programmed. The flash must be
+ *        unlocked.
+ * @param addr the address of the start of the page
+ * @param data PAGE_SIZE bytes to store there
+ * @retval FLASH_COMPLETE if successful, another FLASH_Status if not.
+ */
+FLASH_Status Blox_Flash_WritePage(uint32_t addr, const uint32_t *data) {
+  const uint16_t *src = (const uint16_t *)data;
+  const uint16_t *dst = (const uint16_t *)addr;
+  FLASH_Status status;
+  uint8_t changed = FALSE, erase = FALSE;
+  uint32_t i;
+
+  for (i = 0; i < PAGE_SIZE/2; i++) {
+    if (dst[i] == src[i])
+      continue;
+    changed = TRUE;
+    if (dst[i] != FLASH_ERASED_HALF) {
+      erase = TRUE;
+      break;
+    }
+  }
+  if (!changed) {
+    stats.unchanged++;
+    return FLASH_COMPLETE;
+  }
+
+  if (erase) {
+    status = Blox_Flash_ErasePage(addr);
+    if (status != FLASH_COMPLETE)
+      return status;
+  } else {
+    stats.erasesAvoided++;
+  }
+  for (i = 0; i < PAGE_SIZE/2; i++) {
+    if (dst[i] == src[i])
+      continue;
+    status = Blox_Flash_ProgramHalfWord((uint32_t)&dst[i], src[i]);
+    if (status != FLASH_COMPLETE)
+      return status;
+  }
+  return FLASH_COMPLETE;
+}
+
+/**
+ * @brief Returns whether an erase or program is in progress. Interrupts use
+ *        this to avoid calling into flash-resident code.
+ * @retval TRUE if the flash is busy, FALSE otherwise.
+ */
+BLOX_RAMFUNC uint8_t Blox_Flash_IsBusy(void) {
+  return flash_busy;
+}
+
+/**
+ * @brief Returns how many pages have been erased since boot.
+ * @retval the erase count
+ */
+uint32_t Blox_Flash_GetEraseCount(void) {
+  return stats.erases;
+}
+
+/**
+ * @brief Copies out the flash driver's counters.
+ * @param ret the struct to fill in
+ * @retval None
+ */
+void Blox_Flash_GetStats(FLASH_Stats *ret) {
+  memcpy(ret, &stats, sizeof(FLASH_Stats));
+}
+
+/**
+ * @brief Returns how many times a page has been erased.
+ * @param addr an address in the page
+ * @retval the erase count
+ */
+uint16_t Blox_Flash_GetPageErases(uint32_t addr) {
+  if (FLASH_PAGE(addr) >= FLASH_NUM_PAGES)
+    return 0;
+  return wear[FLASH_PAGE(addr)];
+}
+
+/**
+ * @brief Adds erases the driver didn't see, such as those from before boot,
+ *        to a page's count.
+ * @param addr an address in the page
+ * @param erases the erases to add
+ * @retval None
+ */
+void Blox_Flash_AddPageErases(uint32_t addr, uint16_t erases) {
+  uint32_t count;
+  if (FLASH_PAGE(addr) >= FLASH_NUM_PAGES)
+    return;
+  count = wear[FLASH_PAGE(addr)] + erases;
+  wear[FLASH_PAGE(addr)] = count > 0xFFFF ? 0xFFFF : count;
+}
+
+/**
+ * @brief Sums up the erase counts of a range of pages.
+ * @param addr the address of the first page
+ * @param numPages the number of pages
+ * @param ret the struct to fill in
+ * @retval None
+ */
+void Blox_Flash_GetWear(uint32_t addr, uint32_t numPages, FLASH_Wear *ret) {
+  uint32_t i;
+  uint16_t erases;
+  ret->total = 0;
+  ret->min = 0xFFFF;
+  ret->max = 0;
+  ret->hottest = addr;
+  for (i = 0; i < numPages; i++) {
+    erases = Blox_Flash_GetPageErases(addr + i*PAGE_SIZE);
+    ret->total += erases;
+    if (erases < ret->min)
+      ret->min = erases;
+    if (erases > ret->max) {
+      ret->max = erases;
+      ret->hottest = addr + i*PAGE_SIZE;
+    }
+  }
+}
+
+/**
+ * @brief Asks for a function to be called once the current flash operation
+ *        is over. Meant for RAM-resident interrupts that would otherwise
+ *        have to call flash-resident code while the flash is busy.
+ *        Only adds the function if it isn't already waiting.
+ * @param fn the function to call
+ * @retval None
+ */
+BLOX_RAMFUNC void Blox_Flash_Defer(ptrVoidFn fn) {
+  uint8_t i;
+  for (i = 0; i < numDeferred; i++) {
+    if (deferred[i] == fn)
+      return;
+  }
+  if (numDeferred < FLASH_MAX_DEFERRED)
+    deferred[numDeferred++] = fn;
+}
+
+/**
+ * @brief Calls the functions deferred while the flash was busy.
+ * @retval None
+ */
+void Flash_RunDeferred(void) {
+  ptrVoidFn fn;
+  BloxCritical crit;
+  while (1) {
+    crit = Blox_System_EnterCritical(NVIC_PRIO_SOFTIRQ);
+    if (numDeferred == 0) {
+      Blox_System_ExitCritical(crit);
+      return;
+    }
+    fn = deferred[--numDeferred];
+    Blox_System_ExitCritical(crit);
+    fn();
+  }
+}
+/** @} */
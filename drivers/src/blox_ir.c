@@ -151,7 +151,10 @@ void Blox_IR1_USART_RXNE_IRQ(void) {
       num = 0;
     } else {
       frame.data = (uint8_t *)malloc(frame.len*sizeof(uint8_t));
-      num++;
+      if (frame.data == NULL)
+        num = 0; //Out of heap, drop the frame
+      else
+        num++;
     }
   } else if (num > 4) {
     if (num == frame.len+5) {
@@ -159,8 +162,12 @@ void Blox_IR1_USART_RXNE_IRQ(void) {
         if (IR1_RX_Handler != NULL && IR1_RX_Enable == TRUE) {
           IRFrame *retFrame;
           retFrame = (IRFrame *)malloc(sizeof(IRFrame));
-          memcpy(retFrame, &(frame), sizeof(IRFrame));
-          (*IR1_RX_Handler)(retFrame);
+          if (retFrame == NULL) {
+            free(frame.data);
+          } else {
+            memcpy(retFrame, &(frame), sizeof(IRFrame));
+            (*IR1_RX_Handler)(retFrame);
+          }
         } else {
           free(frame.data);
         }
@@ -212,7 +219,10 @@ void Blox_IR2_USART_RXNE_IRQ(void) {
       num = 0;
     } else {
       frame.data = (uint8_t *)malloc(frame.len*sizeof(uint8_t));
-      num++;
+      if (frame.data == NULL)
+        num = 0; //Out of heap, drop the frame
+      else
+        num++;
     }
   } else if (num > 4) {
     if (num == frame.len+5) {
@@ -220,8 +230,12 @@ void Blox_IR2_USART_RXNE_IRQ(void) {
         if (IR2_RX_Handler != NULL && IR2_RX_Enable == TRUE) {
           IRFrame *retFrame;
           retFrame = (IRFrame *)malloc(sizeof(IRFrame));
-          memcpy(retFrame, &(frame), sizeof(IRFrame));
-          (*IR2_RX_Handler)(retFrame);
+          if (retFrame == NULL) {
+            free(frame.data);
+          } else {
+            memcpy(retFrame, &(frame), sizeof(IRFrame));
+            (*IR2_RX_Handler)(retFrame);
+          }
         } else {
           free(frame.data);
         }
@@ -273,7 +287,10 @@ void Blox_IR3_USART_RXNE_IRQ(void) {
       num = 0;
     } else {
       frame.data = (uint8_t *)malloc(frame.len*sizeof(uint8_t));
-      num++;
+      if (frame.data == NULL)
+        num = 0; //Out of heap, drop the frame
+      else
+        num++;
     }
   } else if (num > 4) {
     if (num == frame.len+5) {
@@ -281,8 +298,12 @@ void Blox_IR3_USART_RXNE_IRQ(void) {
         if (IR3_RX_Handler != NULL && IR3_RX_Enable == TRUE) {
           IRFrame *retFrame;
           retFrame = (IRFrame *)malloc(sizeof(IRFrame));
-          memcpy(retFrame, &(frame), sizeof(IRFrame));
-          (*IR3_RX_Handler)(retFrame);
+          if (retFrame == NULL) {
+            free(frame.data);
+          } else {
+            memcpy(retFrame, &(frame), sizeof(IRFrame));
+            (*IR3_RX_Handler)(retFrame);
+          }
         } else {
           free(frame.data);
         }
@@ -334,7 +355,10 @@ void Blox_IR4_USART_RXNE_IRQ(void) {
       num = 0;
     } else {
       frame.data = (uint8_t *)malloc(frame.len*sizeof(uint8_t));
-      num++;
+      if (frame.data == NULL)
+        num = 0; //Out of heap, drop the frame
+      else
+        num++;
     }
   } else if (num > 4) {
     if (num == frame.len+5) {
@@ -342,8 +366,12 @@ void Blox_IR4_USART_RXNE_IRQ(void) {
         if (IR4_RX_Handler != NULL && IR4_RX_Enable == TRUE) {
           IRFrame *retFrame;
           retFrame = (IRFrame *)malloc(sizeof(IRFrame));
-          memcpy(retFrame, &(frame), sizeof(IRFrame));
-          (*IR4_RX_Handler)(retFrame);
+          if (retFrame == NULL) {
+            free(frame.data);
+          } else {
+            memcpy(retFrame, &(frame), sizeof(IRFrame));
+            (*IR4_RX_Handler)(retFrame);
+          }
         } else {
           free(frame.data);
         }
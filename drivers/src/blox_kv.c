@@ -0,0 +1,365 @@
+/**
+ * @file    blox_kv.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Log-structured key/value store for SysVar and small config
+ *          records, spread over MEM_KV_START so no single page wears out.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "blox_kv.h"
+
+/**
+ * @ingroup driver_kv
+ * @{
+ */
+
+/* Private function prototypes */
+KV_PageHeader * KV_Page(uint32_t page);
+uint32_t KV_Erases(KV_PageHeader *hdr);
+uint32_t KV_Scan(uint32_t page);
+KV_STATUS KV_Format(uint32_t page, uint32_t seq);
+KV_STATUS KV_Append(uint16_t key, const uint8_t *data, uint16_t len);
+KV_STATUS KV_Collect(void);
+uint32_t KV_Live(void);
+
+#define KV_PAD(len) (((len) + 3) & ~3)
+#define KV_ERASED_HALF 0xFFFF
+#define KV_PAGE_ROOM (PAGE_SIZE - sizeof(KV_PageHeader))
+
+/**
+ * @brief Address of each key's newest record, 0 if it has none.
+ */
+static uint32_t kv_index[KV_MAX_KEYS];
+static uint32_t active = KV_NUM_PAGES;
+static uint32_t top;
+static uint32_t gcs, writes, skipped;
+
+/**
+ * @brief Returns the header of a KV page.
+ * @param page the page number within MEM_KV_START
+ * @retval the page's header
+ */
+KV_PageHeader * KV_Page(uint32_t page) {
+  return (KV_PageHeader *)(MEM_KV_START + page * PAGE_SIZE);
+}
+
+/**
+ * @brief Returns a page's erase count, treating an erased header as new.
+ * @param hdr the page's header
+ * @retval the erase count
+ */
+uint32_t KV_Erases(KV_PageHeader *hdr) {
+  if (hdr->erases == 0xFFFFFFFF)
+    return 0;
+  return hdr->erases;
+}
+
+/**
+ * @brief Builds the RAM index from a page's log.
+ * @param page the page number within MEM_KV_START
+ * @retval the address just past the last record
+ */
+uint32_t KV_Scan(uint32_t page) {
+  uint32_t addr = (uint32_t)KV_Page(page) + sizeof(KV_PageHeader);
+  uint32_t end = (uint32_t)KV_Page(page) + PAGE_SIZE;
+  KV_Record *rec;
+  uint32_t i;
+
+  for (i = 0; i < KV_MAX_KEYS; i++)
+    kv_index[i] = 0;
+
+  while (addr + sizeof(KV_Record) <= end) {
+    rec = (KV_Record *)addr;
+    if (rec->len == KV_ERASED_HALF
+          || addr + sizeof(KV_Record) + KV_PAD(rec->len) > end)
+      break;
+    if (rec->key < KV_MAX_KEYS)
+      kv_index[rec->key] = rec->len ? addr : 0;
+    addr += sizeof(KV_Record) + KV_PAD(rec->len);
+  }
+  return addr;
+}
+
+/**
+ * @brief Erases a page and writes its header, all but the magic. The flash
+ *        must be unlocked.
+ * @param page the page number within MEM_KV_START
+ * @param seq the sequence number to give the page
+ * @retval KV_OK if successful, KV_FLASH_ERROR if not.
+ */
+KV_STATUS KV_Format(uint32_t page, uint32_t seq) {
+  KV_PageHeader *hdr = KV_Page(page);
+  uint32_t erases = KV_Erases(hdr) + 1;
+
+  if (Blox_Flash_ErasePage((uint32_t)hdr) != FLASH_COMPLETE
+        || Blox_Flash_ProgramWord((uint32_t)&hdr->erases, erases) != FLASH_COMPLETE
+        || Blox_Flash_ProgramWord((uint32_t)&hdr->seq, seq) != FLASH_COMPLETE)
+    return KV_FLASH_ERROR;
+  return KV_OK;
+}
+
+/**
+ * @brief Appends a record at the top of the active page and indexes it. The
+ *        flash must be unlocked and the record must fit.
+ * @param key the key to set
+ * @param data the record's data
+ * @param len the length of data, 0 to delete the key
+ * @retval KV_OK if successful, KV_FLASH_ERROR if not.
+ */
+KV_STATUS KV_Append(uint16_t key, const uint8_t *data, uint16_t len) {
+  KV_Record *rec = (KV_Record *)top;
+  uint32_t addr = top + sizeof(KV_Record);
+  uint16_t half;
+  uint32_t i;
+
+  top += sizeof(KV_Record) + KV_PAD(len);
+  if (Blox_Flash_ProgramHalfWord((uint32_t)&rec->len, len) != FLASH_COMPLETE)
+    return KV_FLASH_ERROR;
+  for (i = 0; i < len; i += 2) {
+    half = data[i];
+    half |= (i + 1 < len ? data[i+1] : 0xFF) << 8;
+    if (Blox_Flash_ProgramHalfWord(addr + i, half) != FLASH_COMPLETE)
+      return KV_FLASH_ERROR;
+  }
+  if (Blox_Flash_ProgramHalfWord((uint32_t)&rec->key, key) != FLASH_COMPLETE)
+    return KV_FLASH_ERROR;
+
+  kv_index[key] = len ? (uint32_t)rec : 0;
+  return KV_OK;
+}
+
+/**
+ * @brief Returns the space the live records take in a page.
+ * @retval the size in bytes, headers and padding included
+ */
+uint32_t KV_Live(void) {
+  uint32_t size = 0;
+  uint32_t i;
+
+  for (i = 0; i < KV_MAX_KEYS; i++) {
+    if (kv_index[i] != 0)
+      size += sizeof(KV_Record) + KV_PAD(((KV_Record *)kv_index[i])->len);
+  }
+  return size;
+}
+
+/**
+ * @brief Copies the live records into the next page in the ring, which then
+ *        becomes active. The flash must be unlocked. Nothing is erased if
+ *        the live records would not fit a page. If the copy fails, the
+ *        index and top are rebuilt from the page that is still active.
+ * @retval KV_OK if successful, another KV_STATUS if not.
+ */
+KV_STATUS KV_Collect(void) {
+  uint32_t next = (active + 1) % KV_NUM_PAGES;
+  KV_PageHeader *hdr = KV_Page(next);
+  uint32_t end = (uint32_t)hdr + PAGE_SIZE;
+  KV_Record *rec;
+  KV_STATUS status;
+  uint32_t i;
+
+  if (KV_Live() > KV_PAGE_ROOM)
+    return KV_NO_SPACE;
+  status = KV_Format(next, KV_Page(active)->seq + 1);
+  if (status != KV_OK)
+    return status;
+
+  top = (uint32_t)hdr + sizeof(KV_PageHeader);
+  for (i = 0; i < KV_MAX_KEYS; i++) {
+    if (kv_index[i] == 0)
+      continue;
+    rec = (KV_Record *)kv_index[i];
+    if (top + sizeof(KV_Record) + KV_PAD(rec->len) > end)
+      status = KV_NO_SPACE;
+    else
+      status = KV_Append(rec->key, (uint8_t *)(rec + 1), rec->len);
+    if (status != KV_OK)
+      break;
+  }
+  if (status == KV_OK
+        && Blox_Flash_ProgramWord((uint32_t)&hdr->magic, KV_MAGIC) != FLASH_COMPLETE)
+    status = KV_FLASH_ERROR;
+  if (status != KV_OK) {
+    top = KV_Scan(active);
+    return status;
+  }
+
+  active = next;
+  gcs++;
+  return KV_OK;
+}
+
+/**
+ * @brief Finds the active KV page and builds the index. Formats the store
+ *        if no page is valid. Only scans once.
+ * @retval KV_OK if successful, KV_FLASH_ERROR if not.
+ */
+KV_STATUS Blox_KV_Init(void) {
+  KV_PageHeader *hdr;
+  KV_STATUS status;
+  uint32_t i;
+
+  if (active != KV_NUM_PAGES)
+    return KV_OK;
+
+  for (i = 0; i < KV_NUM_PAGES; i++) {
+    hdr = KV_Page(i);
+    if (hdr->magic != KV_MAGIC)
+      continue;
+    if (active == KV_NUM_PAGES || hdr->seq > KV_Page(active)->seq)
+      active = i;
+  }
+
+  if (active == KV_NUM_PAGES) {
+    Blox_DebugStr("Blox_KV_Init no valid page, formatting\r\n");
+    Blox_Flash_Unlock();
+    status = KV_Format(0, 1);
+    if (status == KV_OK
+          && Blox_Flash_ProgramWord((uint32_t)&KV_Page(0)->magic, KV_MAGIC) != FLASH_COMPLETE)
+      status = KV_FLASH_ERROR;
+    Blox_Flash_Lock();
+    if (status != KV_OK)
+      return status;
+    active = 0;
+  }
+
+  top = KV_Scan(active);
+  return KV_OK;
+}
+
+/**
+ * @brief Sets a key. Costs a few halfword programs, plus a garbage
+ *        collection when the active page is full. Writing the value the key
+ *        already holds does nothing.
+ * @param key the key to set, below KV_MAX_KEYS
+ * @param data the data to store
+ * @param len the length of data, at most KV_MAX_DATA
+ * @retval KV_OK if successful, KV_NO_SPACE if the live records and the new
+ *         one would not fit one page, another KV_STATUS if not. The old
+ *         value is still live while the new one is written, so it counts.
+ */
+KV_STATUS Blox_KV_Write(uint16_t key, const void *data, uint16_t len) {
+  KV_Record *rec;
+  KV_STATUS status = KV_OK;
+  uint32_t end;
+
+  if (key >= KV_MAX_KEYS || len == 0 || len > KV_MAX_DATA)
+    return KV_BAD_KEY;
+  status = Blox_KV_Init();
+  if (status != KV_OK)
+    return status;
+
+  rec = (KV_Record *)kv_index[key];
+  if (rec != 0 && rec->len == len && memcmp(rec + 1, data, len) == 0) {
+    skipped++;
+    return KV_OK;
+  }
+  if (KV_Live() + sizeof(KV_Record) + KV_PAD(len) > KV_PAGE_ROOM)
+    return KV_NO_SPACE;
+
+  Blox_Flash_Unlock();
+  end = (uint32_t)KV_Page(active) + PAGE_SIZE;
+  if (top + sizeof(KV_Record) + KV_PAD(len) > end) {
+    status = KV_Collect();
+    end = (uint32_t)KV_Page(active) + PAGE_SIZE;
+    if (status == KV_OK && top + sizeof(KV_Record) + KV_PAD(len) > end)
+      status = KV_NO_SPACE;
+  }
+  if (status == KV_OK)
+    status = KV_Append(key, (const uint8_t *)data, len);
+  Blox_Flash_Lock();
+  if (status == KV_OK)
+    writes++;
+  return status;
+}
+
+/**
+ * @brief Reads a key.
+ * @param key the key to read
+ * @param data the buffer to copy into
+ * @param len in: the size of data, out: the length of the stored record.
+ *        Only the first size bytes are copied if the record is longer.
+ * @retval KV_OK if successful, KV_NOT_FOUND if the key isn't set.
+ */
+KV_STATUS Blox_KV_Read(uint16_t key, void *data, uint16_t *len) {
+  KV_Record *rec;
+
+  if (key >= KV_MAX_KEYS)
+    return KV_BAD_KEY;
+  if (Blox_KV_Init() != KV_OK || kv_index[key] == 0)
+    return KV_NOT_FOUND;
+
+  rec = (KV_Record *)kv_index[key];
+  memcpy(data, rec + 1, rec->len < *len ? rec->len : *len);
+  *len = rec->len;
+  return KV_OK;
+}
+
+/**
+ * @brief Deletes a key by appending an empty record.
+ * @param key the key to delete
+ * @retval KV_OK if successful, another KV_STATUS if not.
+ */
+KV_STATUS Blox_KV_Delete(uint16_t key) {
+  KV_STATUS status = KV_OK;
+
+  if (key >= KV_MAX_KEYS)
+    return KV_BAD_KEY;
+  if (Blox_KV_Init() != KV_OK || kv_index[key] == 0)
+    return KV_OK;
+
+  Blox_Flash_Unlock();
+  if (top + sizeof(KV_Record) > (uint32_t)KV_Page(active) + PAGE_SIZE)
+    status = KV_Collect();
+  if (status == KV_OK && kv_index[key] != 0)
+    status = KV_Append(key, 0, 0);
+  Blox_Flash_Lock();
+  if (status == KV_OK)
+    writes++;
+  return status;
+}
+
+/**
+ * @brief Reports the KV store's wear and usage.
+ * @param stats the struct to fill in
+ * @retval None
+ */
+void Blox_KV_GetStats(KV_Stats *stats) {
+  uint32_t i;
+
+  for (i = 0; i < KV_NUM_PAGES; i++)
+    stats->erases[i] = KV_Erases(KV_Page(i));
+  stats->gcs = gcs;
+  stats->writes = writes;
+  stats->skipped = skipped;
+  stats->records = 0;
+  for (i = 0; i < KV_MAX_KEYS; i++) {
+    if (kv_index[i] != 0)
+      stats->records++;
+  }
+  stats->free = 0;
+  if (active != KV_NUM_PAGES)
+    stats->free = (uint32_t)KV_Page(active) + PAGE_SIZE - top;
+}
+/** @} */
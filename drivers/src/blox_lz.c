@@ -0,0 +1,105 @@
+/**
+ * @file    blox_lz.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Streaming LZSS decoder for compressed app images. The matching
+ *          encoder is misc/lzss.py.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "blox_lz.h"
+
+/**
+ * @ingroup driver_lz
+ * @{
+ */
+
+/**
+ * @brief Starts decoding a compressed stream.
+ * @param lz the decoder state
+ * @param in the compressed stream
+ * @param len the length of the compressed stream
+ * @retval None
+ */
+void Blox_LZ_Init(BloxLZ *lz, const uint8_t *in, uint32_t len) {
+  lz->in = in;
+  lz->end = in + len;
+  lz->pos = 0;
+  lz->flags = 0;
+  lz->matchLen = 0;
+  lz->matchDist = 0;
+  lz->error = 0;
+}
+
+/**
+ * @brief Decodes the next len bytes of output. Matches reaching back before
+ *        this call's output are read from history, so only the current
+ *        chunk needs to be in RAM.
+ * @param lz the decoder state
+ * @param out where to put the output
+ * @param len how many bytes to decode
+ * @param history where all earlier output can be read back, indexed from
+ *        the start of the stream. Unused on the first call.
+ * @retval the number of bytes decoded, less than len at the end of the
+ *         stream or on an error.
+ */
+uint32_t Blox_LZ_Decode(BloxLZ *lz, uint8_t *out, uint32_t len, const uint8_t *history) {
+  uint32_t start = lz->pos, n = 0, q;
+  
+  while (n < len) {
+    if (lz->matchLen) {
+      q = lz->pos - lz->matchDist;
+      out[n++] = q >= start ? out[q - start] : history[q];
+      lz->pos++;
+      lz->matchLen--;
+      continue;
+    }
+    if (lz->flags <= 1) {
+      if (lz->in >= lz->end)
+        break;
+      lz->flags = *lz->in++ | 0x100;
+    }
+    if (lz->in >= lz->end)
+      break;
+    if (lz->flags & 1) {
+      out[n++] = *lz->in++;
+      lz->pos++;
+    } else {
+      if (lz->in + 2 > lz->end) {
+        lz->error = 1;
+        break;
+      }
+      lz->matchDist = (lz->in[0] | ((lz->in[1] & 0xE0) << 3)) + 1;
+      lz->matchLen = (lz->in[1] & 0x1F) + LZ_MIN_MATCH;
+      lz->in += 2;
+      if (lz->matchDist > lz->pos) {
+        lz->matchLen = 0;
+        lz->error = 1;
+        break;
+      }
+    }
+    lz->flags >>= 1;
+  }
+  return n;
+}
+/** @} */
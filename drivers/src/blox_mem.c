@@ -0,0 +1,250 @@
+/**
+ * @file    blox_mem.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Measures heap and stack usage. The stack is painted at startup
+ *          and scanned for its high-water mark, and every malloc/free in the
+ *          image is routed through counters using the linker's $Sub$$ patching.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "blox_mem.h"
+#include "blox_system.h"
+#include "blox_usb.h"
+
+/**
+ * @ingroup driver_mem
+ * @{
+ */
+
+/**
+ * Section symbols the linker defines for the STACK and HEAP areas declared
+ * in the startup file.
+ */
+extern uint32_t STACK$$Base;
+extern uint32_t STACK$$Limit;
+extern uint32_t HEAP$$Base;
+extern uint32_t HEAP$$Limit;
+
+#define MEM_STACK_BASE  ((uint32_t)&STACK$$Base)
+#define MEM_STACK_LIMIT ((uint32_t)&STACK$$Limit)
+#define MEM_HEAP_SIZE   ((uint32_t)&HEAP$$Limit - (uint32_t)&HEAP$$Base)
+
+#define MEM_BLOCK_MAGIC 0xB10CB10C
+/** The IR parsers allocate from USART interrupts */
+#define MEM_CRITICAL_PRIO NVIC_PRIO_USART
+#define MEM_EXC_FRAME   32
+
+/**
+ * @brief Bookkeeping placed in front of every block handed out by malloc.
+ *        Kept at 8 bytes so the returned pointer stays 8-byte aligned.
+ */
+typedef struct {
+  uint32_t size;    /**< the size the caller asked for */
+  uint32_t magic;   /**< MEM_BLOCK_MAGIC while the block is allocated */
+} MemBlock;
+
+extern void *$Super$$malloc(size_t size);
+extern void $Super$$free(void *ptr);
+
+/* Private function prototypes */
+uint32_t Mem_LargestFree(void);
+
+static uint8_t mem_init = FALSE;
+static volatile uint32_t heap_current, heap_peak, heap_allocs, heap_fails, heap_bad_frees;
+/**
+ * @brief The lowest stack pointer sampled while main (thread mode) was running.
+ */
+static volatile uint32_t main_sp_min = 0xFFFFFFFF;
+
+/**
+ * @brief Paints the unused part of the stack so its high-water mark can be
+ *        measured later. Only paints once, the first time it is called.
+ * @retval None
+ */
+void Blox_Mem_Init(void) {
+  uint32_t *p;
+  uint32_t top;
+  if (mem_init)
+    return;
+  mem_init = TRUE;
+
+  top = __get_MSP() - MEM_STACK_GUARD;
+  for (p = (uint32_t *)MEM_STACK_BASE; (uint32_t)p < top; p++)
+    *p = MEM_STACK_PAINT;
+}
+
+/**
+ * @brief Samples how deep main's stack is. From thread mode this is the
+ *        current stack pointer. From an interrupt that preempted thread mode
+ *        directly it is the stack pointer just above the exception frame.
+ *        Nested interrupts are ignored so their usage isn't counted as main's.
+ *        Cheap enough to be called from SysTick and from idle loops.
+ * @retval None
+ */
+BLOX_RAMFUNC void Blox_Mem_SampleStack(void) {
+  uint32_t sp = __get_MSP();
+  if (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) {
+    if (!(SCB->ICSR & SCB_ICSR_RETTOBASE_Msk))
+      return;
+    sp += MEM_EXC_FRAME;
+  }
+  if (sp < main_sp_min)
+    main_sp_min = sp;
+}
+
+/**
+ * @brief Wraps the C library malloc to count allocations and failures.
+ *        Failures are only counted, as malloc is called from interrupts
+ *        where printing would stall them.
+ * @param size the number of bytes requested
+ * @retval A pointer to the new block, NULL if the heap is exhausted.
+ */
+void *$Sub$$malloc(size_t size) {
+  MemBlock *block;
+  BloxCritical crit = Blox_System_EnterCritical(MEM_CRITICAL_PRIO);
+  block = (MemBlock *)$Super$$malloc(size + sizeof(MemBlock));
+  if (block == NULL) {
+    heap_fails++;
+    Blox_System_ExitCritical(crit);
+    return NULL;
+  }
+  block->size = size;
+  block->magic = MEM_BLOCK_MAGIC;
+  heap_current += size;
+  heap_allocs++;
+  if (heap_current > heap_peak)
+    heap_peak = heap_current;
+  Blox_System_ExitCritical(crit);
+  return (void *)(block + 1);
+}
+
+/**
+ * @brief Wraps the C library free to keep the allocation counters current.
+ *        Pointers malloc did not return are counted and ignored.
+ * @param ptr a pointer previously returned by malloc, or NULL
+ * @retval None
+ */
+void $Sub$$free(void *ptr) {
+  MemBlock *block;
+  BloxCritical crit;
+  if (ptr == NULL)
+    return;
+  block = ((MemBlock *)ptr) - 1;
+  if (block->magic != MEM_BLOCK_MAGIC) {
+    heap_bad_frees++;
+    return;
+  }
+  crit = Blox_System_EnterCritical(MEM_CRITICAL_PRIO);
+  block->magic = 0;
+  heap_current -= block->size;
+  heap_allocs--;
+  $Super$$free(block);
+  Blox_System_ExitCritical(crit);
+}
+
+/**
+ * @brief Finds the largest block malloc could currently return by
+ *        bisecting on trial allocations. Interrupts are only masked for
+ *        each trial, no longer than a malloc and free of their own, so
+ *        the result is approximate if they allocate meanwhile.
+ * @retval The size in bytes of the largest free block.
+ */
+uint32_t Mem_LargestFree(void) {
+  uint32_t lo = 0, hi = MEM_HEAP_SIZE;
+  uint32_t mid;
+  BloxCritical crit;
+  void *p;
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    crit = Blox_System_EnterCritical(MEM_CRITICAL_PRIO);
+    p = $Super$$malloc(mid);
+    if (p != NULL)
+      $Super$$free(p);
+    Blox_System_ExitCritical(crit);
+    if (p != NULL)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return (lo > sizeof(MemBlock)) ? lo - sizeof(MemBlock) : 0;
+}
+
+/**
+ * @brief Returns the current heap statistics.
+ * @param stats the struct to fill in
+ * @retval None
+ */
+void Blox_Mem_GetHeapStats(MemHeapStats *stats) {
+  stats->size = MEM_HEAP_SIZE;
+  stats->current = heap_current;
+  stats->peak = heap_peak;
+  stats->largest_free = Mem_LargestFree();
+  stats->num_allocs = heap_allocs;
+  stats->num_fails = heap_fails;
+  stats->bad_frees = heap_bad_frees;
+}
+
+/**
+ * @brief Returns the current stack statistics. The peak comes from the
+ *        painted stack and covers both thread and interrupt use, since
+ *        everything runs on the main stack. main_peak comes from the samples
+ *        taken by Blox_Mem_SampleStack(), and whatever the peak adds on top
+ *        of it is charged to interrupts.
+ * @param stats the struct to fill in
+ * @retval None
+ */
+void Blox_Mem_GetStackStats(MemStackStats *stats) {
+  uint32_t *p = (uint32_t *)MEM_STACK_BASE;
+
+  Blox_Mem_SampleStack();
+  while ((uint32_t)p < MEM_STACK_LIMIT && *p == MEM_STACK_PAINT)
+    p++;
+
+  stats->size = MEM_STACK_LIMIT - MEM_STACK_BASE;
+  stats->peak = MEM_STACK_LIMIT - (uint32_t)p;
+  stats->main_peak = MEM_STACK_LIMIT - main_sp_min;
+  if (stats->peak > stats->main_peak)
+    stats->isr_peak = stats->peak - stats->main_peak;
+  else
+    stats->isr_peak = 0;
+}
+
+/**
+ * @brief Prints the heap and stack statistics over USB.
+ * @retval None
+ */
+void Blox_Mem_Report(void) {
+  MemHeapStats heap;
+  MemStackStats stack;
+  Blox_Mem_GetHeapStats(&heap);
+  Blox_Mem_GetStackStats(&stack);
+  USB_Init();
+  USB_SendPat("heap: size %u cur %u peak %u free %u\r\n",
+              heap.size, heap.current, heap.peak, heap.largest_free);
+  USB_SendPat("heap: blocks %u fails %u bad frees %u\r\n",
+              heap.num_allocs, heap.num_fails, heap.bad_frees);
+  USB_SendPat("stack: size %u peak %u main %u isr %u\r\n",
+              stack.size, stack.peak, stack.main_peak, stack.isr_peak);
+}
+/** @} */
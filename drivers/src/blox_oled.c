@@ -51,21 +51,41 @@ void OLED_Reset(void) {
 }
 
 /**
- * @brief Initializes the OLED display.
+ * @brief Initializes the OLED display. Blocks for over 2 seconds; see
+ *        Blox_OLED_InitTask.
  * @retval None
  */
 void Blox_OLED_Init(void) {
+  BloxPT pt;
+  PT_INIT(&pt);
+  while (PT_SCHEDULE(Blox_OLED_InitTask(&pt))) ;
+}
+
+/**
+ * @brief Initializes the OLED display as a task, returning at each wait so
+ *        other tasks can run. Call until it returns PT_ENDED.
+ * @param pt the task's state, PT_INIT before the first call
+ * @retval the PT_STATUS of the task.
+ */
+PT_THREAD(Blox_OLED_InitTask(BloxPT *pt)) {
+  static uint8_t ack;
   uint8_t garbage;
+
+  PT_BEGIN(pt);
   OLED_RCC_Configuration();
   OLED_GPIO_Configuration();
   SysTick_Init();
   Blox_VUSART_Init(OLED_USART_ID);
 
-  OLED_Reset();
-  SysTick_Wait(2000);
-  Blox_VUSART_TryReceive(2, &garbage);  //receive any garbage data
+  GPIOC->ODR &= ~(1<<3);
+  PT_WAIT_MS(pt, 20);
+  GPIOC->ODR |= (1<<3);
+  PT_WAIT_MS(pt, 20);
+  PT_WAIT_MS(pt, 2000);
+  Blox_VUSART_TryReceive(OLED_USART_ID, &garbage);  //receive any garbage data
   Blox_OLED_Send(OLED_AUTOBAUD); 
-  Blox_OLED_Receive();
+  PT_WAIT_UNTIL(pt, Blox_VUSART_TryReceive(OLED_USART_ID, &ack) == VUSART_SUCCESS);
+  PT_END(pt);
 }
 
 /**
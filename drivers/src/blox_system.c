@@ -28,31 +28,121 @@
  */
 
 #include "blox_system.h"
-#include "blox_filesystem.h"
+#include "blox_mem.h"
+#include "blox_kv.h"
 /**
  * @ingroup driver_system
  * @{
  */
-SysVar *sys = (SysVar *)MEM_SYS_VAR_START;;
+
+/* Private function prototypes */
+void System_Migrate(void);
+
+#define SYS_NUM_VARS (sizeof(SysVar)/sizeof(uint32_t))
+
 static ptrVoidFn deInit[MAX_DEINIT_FN];
 static uint32_t numDeInit;
 
+/**
+ * @brief The vector table used once relocated into SRAM. VTOR requires the
+ *        table to be aligned to its size rounded up to a power of two.
+ */
+static ptrVoidFn ramVectors[VECTOR_TABLE_SIZE]
+  __attribute__((section("blox_ramvect"), aligned(512)));
+
 
 /**
  * @brief Initializes the pointer to the system variables array
  * @retval None
  */
 void Blox_System_Init(void) {
+  SysVar vars;
+  Blox_Mem_Init();
+  NVIC_PriorityGroupConfig(NVIC_PriorityGroup_4);
+  Blox_System_RelocateVectors();
   Blox_Debug_Init();
-  //sys = (SysVar *)MEM_SYS_VAR_START;  
-  if(sys->magic != SYS_MAGIC) {
-    Blox_DebugPat("Blox_System_Init sys magic fails, got:%x\r\n", sys->magic);
+  Blox_KV_Init();
+  System_Migrate();
+  Blox_System_GetVars(&vars);
+  if(vars.magic != SYS_MAGIC) {
+    Blox_DebugPat("Blox_System_Init sys magic fails, got:%x\r\n", vars.magic);
     while(1) ;
   }   
     
   numDeInit = 0;
 }
 
+/**
+ * @brief Copies the SysVar page older Blox were set up with into the KV
+ *        store, if the store doesn't have one yet.
+ * @retval None
+ */
+void System_Migrate(void) {
+  SysVar *legacy = (SysVar *)MEM_SYS_VAR_START;
+  uint32_t magic;
+  uint16_t len = sizeof(magic);
+
+  if (Blox_KV_Read(KV_KEY_SYSVAR, &magic, &len) == KV_OK
+        || legacy->magic != SYS_MAGIC)
+    return;
+  Blox_DebugStr("Blox_System_Init migrating SysVar into KV\r\n");
+  Blox_System_WriteVars(legacy);
+}
+
+/**
+ * @brief Copies the active vector table into SRAM and points VTOR at the
+ *        copy, so taking an interrupt never reads flash. Only copies once.
+ * @retval None
+ */
+void Blox_System_RelocateVectors(void) {
+  uint32_t i;
+  ptrVoidFn *vectors = (ptrVoidFn *)SCB->VTOR;
+  if (vectors == ramVectors)
+    return;
+  __disable_irq();
+  for (i = 0; i < VECTOR_TABLE_SIZE; i++)
+    ramVectors[i] = vectors[i];
+  NVIC_SetVectorTable(NVIC_VectTab_RAM, (uint32_t)ramVectors - NVIC_VectTab_RAM);
+  __enable_irq();
+}
+
+/**
+ * @brief Sets an interrupt's priority from the priority map and enables it.
+ *        Works the same before Blox_System_Init, since the reset grouping
+ *        also makes all 4 bits preemption bits.
+ * @param irq the interrupt
+ * @param prio one of the NVIC_PRIO_* levels
+ * @retval None
+ */
+void Blox_System_EnableIRQ(IRQn_Type irq, uint8_t prio) {
+  NVIC_SetPriority(irq, prio);
+  NVIC_EnableIRQ(irq);
+}
+
+/**
+ * @brief Masks interrupts at priority prio and below using BASEPRI, so
+ *        more urgent interrupts keep running. prio should be the most urgent
+ *        level that touches the shared state. Never lowers the current mask.
+ * @param prio one of the NVIC_PRIO_* levels, above NVIC_PRIO_VUSART_BIT
+ * @retval the state to hand to Blox_System_ExitCritical.
+ */
+BloxCritical Blox_System_EnterCritical(uint8_t prio) {
+  BloxCritical state = __get_BASEPRI();
+  uint32_t basepri = prio << (8 - __NVIC_PRIO_BITS);
+  if (state == 0 || basepri < state)
+    __set_BASEPRI(basepri);
+  return state;
+}
+
+/**
+ * @brief Restores the mask saved by Blox_System_EnterCritical.
+ * @param state the value Blox_System_EnterCritical returned
+ * @retval None
+ */
+void Blox_System_ExitCritical(BloxCritical state) {
+  __set_BASEPRI(state);
+}
+
 /**
  * @brief De-initializes all the peripherals in the system.
  * @retval None
@@ -90,24 +180,23 @@ void Blox_System_Register_DeInit(ptrVoidFn fn) {
  * @retval None.
  */
 void Blox_System_Create(void) {
-  SysVar *sys_new = (SysVar *)malloc(PAGE_SIZE);
-  sys_new->magic = SYS_MAGIC;
-  sys_new->id = SYS_INV_ID;
-  sys_new->ACCEL_X = 0;
-  sys_new->ACCEL_Y = 0;
-  sys_new->ACCEL_Z = 0;
-  sys_new->TOUCH_1_X = 0;
-  sys_new->TOUCH_1_Y = 0;
-  sys_new->TOUCH_2_X = 0;
-  sys_new->TOUCH_2_Y = 0;
-  sys_new->TOUCH_3_X = 0;
-  sys_new->TOUCH_3_Y = 0;
-  sys_new->TOUCH_4_X = 0;
-  sys_new->TOUCH_4_Y = 0; 
+  SysVar sys_new;
+  sys_new.magic = SYS_MAGIC;
+  sys_new.id = SYS_INV_ID;
+  sys_new.ACCEL_X = 0;
+  sys_new.ACCEL_Y = 0;
+  sys_new.ACCEL_Z = 0;
+  sys_new.TOUCH_1_X = 0;
+  sys_new.TOUCH_1_Y = 0;
+  sys_new.TOUCH_2_X = 0;
+  sys_new.TOUCH_2_Y = 0;
+  sys_new.TOUCH_3_X = 0;
+  sys_new.TOUCH_3_Y = 0;
+  sys_new.TOUCH_4_X = 0;
+  sys_new.TOUCH_4_Y = 0; 
    
-  sys = (SysVar *)MEM_SYS_VAR_START;
-  FS_SwapPage((uint32_t *)sys_new, (uint32_t *)sys);
-  free(sys_new);
+  Blox_KV_Init();
+  Blox_System_WriteVars(&sys_new);
 }
 
 /**
@@ -115,23 +204,40 @@ void Blox_System_Create(void) {
  * @retval the blox's id
  */
 uint32_t Blox_System_GetId(void) {
-  return sys->id;
+  uint32_t id = SYS_INV_ID;
+  uint16_t len = sizeof(id);
+  Blox_KV_Read(KV_KEY_SYSVAR + 1, &id, &len);
+  return id;
 }
 
 /**
- * @brief Returns the current SysVar struct.
+ * @brief Returns the current SysVar struct, read out of the KV index.
  * @retval the current SysVar struct
  */
 void Blox_System_GetVars(SysVar *retSys) { 
-  memcpy(retSys, sys, sizeof(SysVar));
+  uint32_t *vars = (uint32_t *)retSys;
+  uint32_t i;
+  uint16_t len;
+  for (i = 0; i < SYS_NUM_VARS; i++) {
+    vars[i] = 0;
+    len = sizeof(uint32_t);
+    Blox_KV_Read(KV_KEY_SYSVAR + i, &vars[i], &len);
+  }
 }
 
 /**
- * @brief Writes over the SysVar in flash.
+ * @brief Stores the SysVar in flash. Each field is its own KV record, so
+ *        only the fields that changed cost any flash writes. The magic goes
+ *        last, so an interrupted first write is redone on the next boot.
  * @param newVars: a SysVar with the new contents to be stored in flash.
  * @retval None.
  */
 void Blox_System_WriteVars(SysVar *newVars) {
-  FS_SwapPage((uint32_t *)newVars, (uint32_t *)sys);
+  uint32_t *vars = (uint32_t *)newVars;
+  uint32_t i;
+  for (i = SYS_NUM_VARS; i-- > 0; ) {
+    if (Blox_KV_Write(KV_KEY_SYSVAR + i, &vars[i], sizeof(uint32_t)) != KV_OK)
+      Blox_DebugPat("Blox_System_WriteVars failed on field:%d\r\n", i);
+  }
 }
 /** @} */
@@ -153,42 +153,38 @@ void Blox_Timer_RCC_Configuration(uint8_t TIMx) {
  * @retval None
  */
 void Blox_Timer_NVIC_Configuration(uint8_t TIMx) {
-  NVIC_InitTypeDef NVIC_InitStructure;
-  NVIC_PriorityGroupConfig(NVIC_PriorityGroup_4);
-  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 10;
-  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
-  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  IRQn_Type irq;
   switch(TIMx) {
     case 1:
-      NVIC_InitStructure.NVIC_IRQChannel = TIM1_UP_IRQn;
-      NVIC_Init(&NVIC_InitStructure);
-      NVIC_InitStructure.NVIC_IRQChannel = TIM1_CC_IRQn;
+      Blox_System_EnableIRQ(TIM1_UP_IRQn, NVIC_PRIO_TIMER);
+      irq = TIM1_CC_IRQn;
       break;
     case 2:
-      NVIC_InitStructure.NVIC_IRQChannel = TIM2_IRQn;
+      irq = TIM2_IRQn;
       break;
     case 3:
-      NVIC_InitStructure.NVIC_IRQChannel = TIM3_IRQn;
+      irq = TIM3_IRQn;
       break;
     case 4:
-      NVIC_InitStructure.NVIC_IRQChannel = TIM4_IRQn;
+      irq = TIM4_IRQn;
       break;
     case 5:
-      NVIC_InitStructure.NVIC_IRQChannel = TIM5_IRQn;
+      irq = TIM5_IRQn;
       break;
     case 6:
-      NVIC_InitStructure.NVIC_IRQChannel = TIM6_IRQn;
+      irq = TIM6_IRQn;
       break;
     case 7:
-      NVIC_InitStructure.NVIC_IRQChannel = TIM7_IRQn;
+      irq = TIM7_IRQn;
       break;
     case 8:
-      NVIC_InitStructure.NVIC_IRQChannel = TIM8_UP_IRQn;
-      NVIC_Init(&NVIC_InitStructure);
-      NVIC_InitStructure.NVIC_IRQChannel = TIM8_CC_IRQn;
+      Blox_System_EnableIRQ(TIM8_UP_IRQn, NVIC_PRIO_TIMER);
+      irq = TIM8_CC_IRQn;
       break;
+    default:
+      return;
   }
-  NVIC_Init(&NVIC_InitStructure);
+  Blox_System_EnableIRQ(irq, NVIC_PRIO_TIMER);
 }
 
 /**
@@ -553,7 +549,7 @@ void Blox_Timer_Release_IRQ(TIMER_ID id) {
  * @param id specifies the id of the timer interrupt
  * @retval None
  */
-void Blox_Timer_Enable_IRQ(TIMER_ID id) {
+BLOX_RAMFUNC void Blox_Timer_Enable_IRQ(TIMER_ID id) {
   switch(id) {
     case TIM1UP:
       TIM_ClearITPendingBit(TIM1, TIM_IT_Update);
@@ -702,7 +698,7 @@ void Blox_Timer_Enable_IRQ(TIMER_ID id) {
  * @param id specifies the id of the timer interrupt
  * @retval None
  */
-void Blox_Timer_Disable_IRQ(TIMER_ID id) {
+BLOX_RAMFUNC void Blox_Timer_Disable_IRQ(TIMER_ID id) {
   switch(id) {
     case TIM1UP:
       TIM_ITConfig(TIM1, TIM_IT_Update, DISABLE);
@@ -797,7 +793,7 @@ void Blox_Timer_Disable_IRQ(TIMER_ID id) {
  * @param period specifies the new period between timer interrupts.
  * @retval None
  */
-void Blox_Timer_Modify_IRQ(TIMER_ID id, uint16_t period) {
+BLOX_RAMFUNC void Blox_Timer_Modify_IRQ(TIMER_ID id, uint16_t period) {
   TIM_IRQ_period[id] = period;
 }
 
@@ -840,7 +836,7 @@ void TIM1_CC_IRQHandler(void) {
   * @brief  This function handles timer 2 interrupt request.
   * @retval None
   */
-void TIM2_IRQHandler(void) {
+BLOX_RAMFUNC void TIM2_IRQHandler(void) {
   if (TIM_GetITStatus(TIM2, TIM_IT_CC1) != RESET) {
     TIM_ClearITPendingBit(TIM2, TIM_IT_CC1);
     if(TIM_Handler[TIM2CH1] != NULL) {
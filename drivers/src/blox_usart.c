@@ -220,29 +220,27 @@ GPIO_InitTypeDef GPIO_InitStructure;
  * @retval None
  */
 void Blox_USART_NVIC_Configuration(uint8_t id) {
-  NVIC_InitTypeDef NVIC_InitStructure;
-  NVIC_PriorityGroupConfig(NVIC_PriorityGroup_4);
-  NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 10;
-  NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
-  NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+  IRQn_Type irq;
   switch(id) {
     case 1:
-      NVIC_InitStructure.NVIC_IRQChannel = USART1_IRQn;
+      irq = USART1_IRQn;
       break;
     case 2:
-      NVIC_InitStructure.NVIC_IRQChannel = USART2_IRQn;
+      irq = USART2_IRQn;
       break;
     case 3:
-      NVIC_InitStructure.NVIC_IRQChannel = USART3_IRQn;
+      irq = USART3_IRQn;
       break;
     case 4:
-      NVIC_InitStructure.NVIC_IRQChannel = UART4_IRQn;
+      irq = UART4_IRQn;
       break;
     case 5:
-      NVIC_InitStructure.NVIC_IRQChannel = UART5_IRQn;
+      irq = UART5_IRQn;
       break;
+    default:
+      return;
   }
-  NVIC_Init(&NVIC_InitStructure);
+  Blox_System_EnableIRQ(irq, NVIC_PRIO_USART);
 }
 
 /**
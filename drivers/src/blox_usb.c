@@ -37,6 +37,13 @@
  */
 static uint8_t usb_init = 0;
 
+/**
+ * @brief The ring USB_StartRxDMA has the DMA fill, and where the next byte
+ *        to read from it is.
+ */
+static uint8_t *rx_ring;
+static uint16_t rx_len, rx_tail;
+
 /**
  * @brief Initializes the USB module. Basically a wrapper on USART
  * @retval None
@@ -102,5 +109,58 @@ void USB_SendPat(char *format, ...) {
   USB_SendData((uint8_t *)buffer, strlen(buffer));
 }
 
+/**
+ * @brief Starts receiving into a ring by DMA, so bytes keep arriving while
+ *        the CPU is busy, including while it waits on the flash. Read the
+ *        ring with USB_ReceiveDMA. The sender must never be more than len
+ *        bytes ahead, or the ring overwrites bytes not yet read.
+ * @param ring the buffer to receive into
+ * @param len the length of the buffer
+ * @retval None.
+ */
+void USB_StartRxDMA(uint8_t *ring, uint16_t len) {
+  DMA_InitTypeDef DMA_InitStructure;
+  rx_ring = ring;
+  rx_len = len;
+  rx_tail = 0;
+  RCC_AHBPeriphClockCmd(USB_RX_DMA_CLK, ENABLE);
+  DMA_DeInit(USB_RX_DMA);
+  DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&USART1->DR;
+  DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)ring;
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+  DMA_InitStructure.DMA_BufferSize = len;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+  DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+  DMA_Init(USB_RX_DMA, &DMA_InitStructure);
+  DMA_Cmd(USB_RX_DMA, ENABLE);
+  USART_DMACmd(USART1, USART_DMAReq_Rx, ENABLE);
+}
+
+/**
+ * @brief Stops receiving by DMA, so USB_Receive works again.
+ * @retval None.
+ */
+void USB_StopRxDMA(void) {
+  USART_DMACmd(USART1, USART_DMAReq_Rx, DISABLE);
+  DMA_Cmd(USB_RX_DMA, DISABLE);
+}
+
+/**
+ * @brief Blocking receive of a byte from the ring USB_StartRxDMA set up.
+ * @retval The received byte.
+ */
+uint8_t USB_ReceiveDMA(void) {
+  uint8_t data;
+  while ((rx_len - DMA_GetCurrDataCounter(USB_RX_DMA)) % rx_len == rx_tail) ;
+  data = rx_ring[rx_tail];
+  rx_tail = (rx_tail + 1) % rx_len;
+  return data;
+}
+
 /** @} */
 
@@ -82,7 +82,7 @@ void Blox_VUSART_Init(uint8_t id) {
   Blox_VUSART_RCC_Configuration(id);  
   Blox_VUSART_GPIO_Configuration(id);
   Blox_Timer_Init(VUSART_TIMx, VUSART_TIM_CLK);
-  NVIC_SetPriority(VUSART_TIM_IRQn, 1);
+  NVIC_SetPriority(VUSART_TIM_IRQn, NVIC_PRIO_VUSART_BIT);
   Blox_EXTI_Init();
   
   switch(id) {
@@ -136,7 +136,7 @@ void Blox_VUSART_SetBaudrate(uint8_t id, uint16_t baudrate) {
  * @brief Turns on a timer for VUSART1 which samples at the specified baud rate when a falling edge is received
  * @retval None
  */
-void VUSART1_RxStart(void) {
+BLOX_RAMFUNC void VUSART1_RxStart(void) {
   if(VUSART1_RxNotEmpty == 0) {
     Blox_Timer_Enable_IRQ(VUSART1_RxDataID);
     Blox_EXTI_Disable_IRQ(VUSART1_RxStartID);
@@ -149,7 +149,7 @@ void VUSART1_RxStart(void) {
  * @brief Samples incoming data at the specified baud rate for VUSART1
  * @retval None
  */
-void VUSART1_RxData(void) {
+BLOX_RAMFUNC void VUSART1_RxData(void) {
   static uint8_t bit_num;
   static uint8_t data;
   if(bit_num == 0) {
@@ -184,7 +184,7 @@ void VUSART1_RxData(void) {
  * @brief Outputs data at the specified baud rate for VUSART1
  * @retval None
  */
-void VUSART1_TxData(void) {
+BLOX_RAMFUNC void VUSART1_TxData(void) {
   static uint8_t bit_num;
   static uint8_t data;
   //static uint8_t parity;
@@ -215,7 +215,7 @@ void VUSART1_TxData(void) {
  * @brief Turns on a timer for VUSART2 which samples at the specified baud rate when a falling edge is received
  * @retval None
  */
-void VUSART2_RxStart(void) {
+BLOX_RAMFUNC void VUSART2_RxStart(void) {
   if(VUSART2_RxNotEmpty == 0) {
     Blox_Timer_Enable_IRQ(VUSART2_RxDataID);
     Blox_EXTI_Disable_IRQ(VUSART2_RxStartID);
@@ -226,7 +226,7 @@ void VUSART2_RxStart(void) {
  * @brief Samples incoming data at the specified baud rate for VUSART2
  * @retval None
  */
-void VUSART2_RxData(void) {
+BLOX_RAMFUNC void VUSART2_RxData(void) {
   static uint8_t bit_num;
   static uint8_t data;
   if(bit_num == 0) {
@@ -261,7 +261,7 @@ void VUSART2_RxData(void) {
  * @brief Outputs data at the specified baud rate for VUSART1
  * @retval None
  */
-void VUSART2_TxData(void) {
+BLOX_RAMFUNC void VUSART2_TxData(void) {
   static uint8_t bit_num;
   static uint8_t data;
   //static uint8_t parity;
@@ -346,7 +346,7 @@ void Blox_VUSART_GPIO_Configuration(uint8_t id) {
  * @param data a pointer to the location the data will be returned
  * @retval The current status of the VUSART.
  */
-VUSART_STATUS Blox_VUSART_TryReceive(uint8_t id, uint8_t *data) {
+BLOX_RAMFUNC VUSART_STATUS Blox_VUSART_TryReceive(uint8_t id, uint8_t *data) {
   //uint8_t data;
   switch(id) {
     case 1:
@@ -374,13 +374,32 @@ VUSART_STATUS Blox_VUSART_TryReceive(uint8_t id, uint8_t *data) {
   } 
 }
 
+/**
+ * @brief Tries to fill a buffer from the given virtual USART without
+ *        blocking. Call again with the same count until it succeeds.
+ * @param id the virtual USART id to use.
+ * @param data the buffer to fill.
+ * @param len the number of bytes wanted.
+ * @param count the number of bytes already in data; updated.
+ * @retval VUSART_SUCCESS once len bytes are in data, RX_EMPTY before that.
+ */
+VUSART_STATUS Blox_VUSART_TryReceiveData(uint8_t id, uint8_t *data, uint32_t len, uint32_t *count) {
+  VUSART_STATUS ret;
+  while (*count < len) {
+    if ((ret = Blox_VUSART_TryReceive(id, &data[*count])) != VUSART_SUCCESS)
+      return ret;
+    (*count)++;
+  }
+  return VUSART_SUCCESS;
+}
+
 /**
  * @brief Tries to send a byte out on the given virtual USART
  * @param id the virtual USART id to use
  * @param data the byte to send
  * @retval The current status of the VUSART.
  */
-VUSART_STATUS Blox_VUSART_TrySend(uint8_t id, uint8_t data) {
+BLOX_RAMFUNC VUSART_STATUS Blox_VUSART_TrySend(uint8_t id, uint8_t data) {
   switch(id) {
     case 1:
       /* check for transmit data register empty and transmission complete */
@@ -473,6 +492,29 @@ VUSART_STATUS Blox_VUSART_Register_RXNE_IRQ(uint8_t id, void (*RXNE_Handler)(voi
   }
 }
 
+/**
+ * @brief Triggers the SW Interrupt registered for RXNE without a new byte.
+ *        Lets the RXNE handler finish work it had to put off.
+ * @param id the virtual USART id to use.
+ * @retval The current status of the VUSART.
+ */
+VUSART_STATUS Blox_VUSART_Trigger_RXNE_IRQ(uint8_t id) {
+  switch(id) {
+    case 1:
+      if(VUSART1_RXNE_IRQ_ID == EXTI_INVALID_LINE || VUSART1_RXNE_IRQ_ID == EXTI_IRQ_UNAVAILABLE)
+        return RXNE_IRQ_UNAVAILABLE;
+      Blox_EXTI_Trigger_SW_IRQ(VUSART1_RXNE_IRQ_ID);
+      return VUSART_SUCCESS;
+    case 2:
+      if(VUSART2_RXNE_IRQ_ID == EXTI_INVALID_LINE || VUSART2_RXNE_IRQ_ID == EXTI_IRQ_UNAVAILABLE)
+        return RXNE_IRQ_UNAVAILABLE;
+      Blox_EXTI_Trigger_SW_IRQ(VUSART2_RXNE_IRQ_ID);
+      return VUSART_SUCCESS;
+    default:
+      return INVALID_ID;
+  }
+}
+
 /**
  * @brief Enables the SW Interrupt on RXNE.
  * @param id the virtual USART id to use.
@@ -42,26 +42,94 @@ void (*XBee_RX_Handler)(BloxFrame *);
  */
 uint8_t XBee_RX_Enable = FALSE;
 /**
- * @brief Flag used to communicate information between interrupt and TxStatus
+ * @brief The transmit queue. Slots from XBee_TxRetire up to XBee_TxSend have
+ *        gone out and wait on their TX status; the rest up to XBee_TxWrite
+ *        are still to be sent. The counters wrap and are masked to index.
  */
-uint8_t XBee_TxStatus_Flag = XBEE_TXSTATUS_NORMAL;
+static XBeeTxSlot XBee_TxQueue[XBEE_TX_QUEUE_LEN];
+static volatile uint8_t XBee_TxWrite = 0, XBee_TxSend = 0, XBee_TxRetire = 0;
+/**
+ * @brief How much of the slot at XBee_TxSend has been written to the XBee.
+ */
+static uint8_t XBee_TxPos = 0;
+/**
+ * @brief Set while a caller of Blox_XBee_Poll is writing out the queue.
+ */
+static volatile uint8_t XBee_TxPumping = FALSE;
+/**
+ * @brief The next API frame id to hand out. Id 0 asks for no TX status.
+ */
+static uint8_t XBee_NextFrameId = 1;
+/**
+ * @brief The frame Blox_XBee_Send is waiting on and how it went.
+ */
+static volatile uint8_t XBee_SyncId;
+static volatile uint8_t XBee_SyncPending = FALSE;
+static volatile XBEE_STATUS XBee_SyncStatus;
+/**
+ * @brief A received frame held back because the flash was busy, so the
+ *        (flash-resident) RX handler could not be called.
+ */
+static BloxFrame XBee_PendingFrame;
+static volatile uint8_t XBee_FramePending = FALSE;
 
 /* Private function prototypes */
 void XBee_RCC_Configuration(void);
 void XBee_GPIO_Configuration(void);
 uint8_t XBee_CheckOkResponse(void);
-XBEE_STATUS XBee_SendTxFrame (XBeeTxFrame *frame);
-XBEE_STATUS XBee_TxStatus (void);
+uint8_t XBee_IsOkResponse(uint8_t *resp, uint32_t len);
+uint8_t XBee_PackTxFrame(XBeeTxFrame *frame, uint8_t *wire);
+uint8_t XBee_PutByte(uint8_t *wire, uint8_t pos, uint8_t data, uint8_t *checksum);
+uint8_t XBee_Unpack(const uint8_t *wire, uint32_t wireLen, BloxFrame *frame);
+uint8_t XBee_Retire(XBeeTxCallback *callback, uint8_t *frame_id, XBEE_STATUS *status);
+void XBee_SyncDone(uint8_t frame_id, XBEE_STATUS status);
 void Blox_XBee_VUSART_RXNE_IRQ(void);
+void XBee_DeliverPending(void);
+void XBee_RetriggerRXNE(void);
+
+/**
+ * @brief The commands Blox_XBee_ConfigTask sends after ATMY, in order.
+ */
+static const char *XBee_ConfigCmds[] = {
+  "ATDLFFFF\r",    //Set broadcast dest ID
+  "ATDH0\r",       //Set high of dest ID
+  "ATAP1\r",       //API Mode 1 (no escapes)
+  "ATRN1\r",       //Random delay slots for backoff
+  "ATWR\r",        //Write to non-volatile memory
+  "ATCN\r"         //Exit command mode
+};
+#define XBEE_NUM_CONFIG_CMDS (sizeof(XBee_ConfigCmds)/sizeof(XBee_ConfigCmds[0]))
 
 /**
  * @brief Configures the XBee and writes the configuration to non-volatile mem.
+ *        Blocks for over 3 seconds; see Blox_XBee_ConfigTask.
  * @retval XBEE_OK if successfull, XBEE_INIT_FAIL on failure.
  */
 XBEE_STATUS Blox_XBee_Config(void) {
-  char buffer[10];
+  BloxPT pt;
+  XBEE_STATUS status;
+  PT_INIT(&pt);
+  while (PT_SCHEDULE(Blox_XBee_ConfigTask(&pt, &status))) ;
+  return status;
+}
+
+/**
+ * @brief Configures the XBee as a task, returning at each wait so other
+ *        tasks can run. Call until it returns PT_ENDED or PT_EXITED.
+ * @param pt the task's state, PT_INIT before the first call
+ * @param status set to XBEE_OK once configured, XBEE_INIT_FAIL on failure.
+ * @retval the PT_STATUS of the task.
+ */
+PT_THREAD(Blox_XBee_ConfigTask(BloxPT *pt, XBEE_STATUS *status)) {
+  static char buffer[10];
+  static uint8_t resp[3];
+  static uint8_t i;
+  const char *cmd;
   uint8_t garbage;
   SysVar sys;
+
+  PT_BEGIN(pt);
+  *status = XBEE_INIT_FAIL;
   XBee_RCC_Configuration();
   XBee_GPIO_Configuration();
   
@@ -69,60 +137,36 @@ XBEE_STATUS Blox_XBee_Config(void) {
   SysTick_Init();
   Blox_System_Init();
   Blox_System_GetVars(&sys);
+  sprintf(buffer, "ATMY%d\r", sys.id);
   
   XBEE_SLEEP_GPIO->ODR &= ~(XBEE_SLEEP_PIN);
   XBEE_RESET_GPIO->ODR |= XBEE_RESET_PIN;
-  SysTick_Wait(1);
+  PT_WAIT_MS(pt, 1);
   XBEE_RESET_GPIO->ODR &= ~(XBEE_RESET_PIN);
-  SysTick_Wait(1);
+  PT_WAIT_MS(pt, 1);
   XBEE_RESET_GPIO->ODR |= XBEE_RESET_PIN;
-  SysTick_Wait(1100);
+  PT_WAIT_MS(pt, 1100);
 
   Blox_VUSART_TryReceive(XBEE_VUSART_ID, &garbage);   //clear VUSART buffer before send/receive
   Blox_VUSART_Send(XBEE_VUSART_ID, 'X');           // Junk character to before init
-  SysTick_Wait(1100);
+  PT_WAIT_MS(pt, 1100);
   Blox_VUSART_SendData(XBEE_VUSART_ID, "+++", 3) ; //Enter Command Mode
-  if (XBee_CheckOkResponse() == FALSE)
-    return XBEE_INIT_FAIL;
-  SysTick_Wait(1100);
+  PT_WAIT_BYTES(pt, XBEE_VUSART_ID, resp, 3, XBEE_RESPONSE_TIMEOUT);
+  if (XBee_IsOkResponse(resp, pt->count) == FALSE)
+    PT_EXIT(pt);
+  PT_WAIT_MS(pt, 1100);
   
-  sprintf(buffer, "ATMY%d\r", sys.id);
-  Blox_VUSART_SendData(XBEE_VUSART_ID, (uint8_t *)buffer, strlen(buffer)) ; //Enter Command Mode
-  if (XBee_CheckOkResponse() == FALSE)
-    return XBEE_INIT_FAIL;
-  SysTick_Wait(20);  
-  
-  Blox_VUSART_SendData(XBEE_VUSART_ID, "ATDLFFFF\r", 9) ; //Set broadcast dest ID
-  if (XBee_CheckOkResponse() == FALSE)
-    return XBEE_INIT_FAIL;
-  SysTick_Wait(20);    
-  
-  Blox_VUSART_SendData(XBEE_VUSART_ID, "ATDH0\r", 6) ; //Set high of dest ID
-  if (XBee_CheckOkResponse() == FALSE)
-    return XBEE_INIT_FAIL;
-  SysTick_Wait(20);
-  
-  Blox_VUSART_SendData(XBEE_VUSART_ID, "ATAP1\r", 6) ; //API Mode 1 (no escapes)
-  if (XBee_CheckOkResponse() == FALSE)
-    return XBEE_INIT_FAIL;
-  SysTick_Wait(20);
-  
-  Blox_VUSART_SendData(XBEE_VUSART_ID, "ATRN1\r", 6) ; //API Mode 1 (no escapes)
-  if (XBee_CheckOkResponse() == FALSE)
-    return XBEE_INIT_FAIL;
-  SysTick_Wait(20);
-  
-  Blox_VUSART_SendData(XBEE_VUSART_ID, "ATWR\r", 9) ; //Write to non-volatile memory
-  if (XBee_CheckOkResponse() == FALSE)
-    return XBEE_INIT_FAIL;
-  SysTick_Wait(20);
-  
-  Blox_VUSART_SendData(XBEE_VUSART_ID, "ATCN\r", 5) ; //Exit command mode
-  if (XBee_CheckOkResponse() == FALSE)
-    return XBEE_INIT_FAIL;
-  SysTick_Wait(20);
+  for (i = 0; i <= XBEE_NUM_CONFIG_CMDS; i++) {
+    cmd = (i == 0) ? buffer : XBee_ConfigCmds[i-1];
+    Blox_VUSART_SendData(XBEE_VUSART_ID, (uint8_t *)cmd, strlen(cmd));
+    PT_WAIT_BYTES(pt, XBEE_VUSART_ID, resp, 3, XBEE_RESPONSE_TIMEOUT);
+    if (XBee_IsOkResponse(resp, pt->count) == FALSE)
+      PT_EXIT(pt);
+    PT_WAIT_MS(pt, 20);
+  }
   
-  return XBEE_OK;
+  *status = XBEE_OK;
+  PT_END(pt);
 }
 
 /**
@@ -235,6 +279,24 @@ void XBee_GPIO_Configuration() {
   GPIO_Init(XBEE_SLEEP_GPIO, &GPIO_InitStructure);
 }
 
+/**
+ * @brief Checks if a response received without blocking is "OK<CR>".
+ * @param resp the received bytes
+ * @param len the number of bytes received; short on a timeout
+ * @retval TRUE if it is "OK<CR>", FALSE otherwise.
+ */
+uint8_t XBee_IsOkResponse(uint8_t *resp, uint32_t len) {
+  if (len != 3) {
+    Blox_DebugPat("XBee_IsOkResponse timed out after %d bytes\r\n", len);
+    return FALSE;
+  }
+  if (resp[0] != 'O' || resp[1] != 'K' || resp[2] != CR) {
+    Blox_DebugPat("XBee_IsOkResponse received %x%x%x instead of OK<CR>\r\n", resp[0], resp[1], resp[2]);
+    return FALSE;
+  }
+  return TRUE;
+}
+
 /**
  * @brief Checks if "OK<CR>" is waiting in the buffer
  * @retval TRUE if "OK<CR>" is received, FALSE otherwise.
@@ -260,16 +322,40 @@ uint8_t XBee_CheckOkResponse(void) {
 }
 
 
+/**
+ * @brief Hands the held-back frame to the RX handler once the flash is free.
+ * @retval None.
+ */
+BLOX_RAMFUNC void XBee_DeliverPending(void) {
+  if (XBee_FramePending == FALSE || Blox_Flash_IsBusy())
+    return;
+  XBee_FramePending = FALSE;
+  if (XBee_RX_Handler != NULL && XBee_RX_Enable == TRUE)
+    XBee_RX_Handler(&XBee_PendingFrame);
+}
+
+/**
+ * @brief Deferred until the flash operation finishes; re-enters the RXNE
+ *        interrupt so the pending frame is delivered in interrupt context.
+ * @retval None.
+ */
+void XBee_RetriggerRXNE(void) {
+  Blox_VUSART_Trigger_RXNE_IRQ(XBEE_VUSART_ID);
+}
+
 /**
  * @brief The function that XBee registers with VUSART to execute on byte received.
+ *        Runs from SRAM so bytes keep being parsed during flash operations.
  * @retval None.
  */
-void Blox_XBee_VUSART_RXNE_IRQ(void) {
+BLOX_RAMFUNC void Blox_XBee_VUSART_RXNE_IRQ(void) {
   static uint8_t num = 0;
   static uint8_t checksum = 0;
   static XBeeFrame frame;
   uint8_t data;
+  uint8_t i;
   
+  XBee_DeliverPending();
   if (Blox_VUSART_TryReceive(XBEE_VUSART_ID, &data) == RX_EMPTY)
     return;
   
@@ -293,30 +379,42 @@ void Blox_XBee_VUSART_RXNE_IRQ(void) {
         num = 0;
       else {
         XBeeTxStatusFrame *status;
+        XBeeTxSlot *slot;
         switch(frame.data[0]) {
         case API_TX_STATUS:
+          //Match it to the frame in flight with the same id
           status = (XBeeTxStatusFrame *)&frame;
-          if (status->status == 0 && data == 0xFF-checksum)
-            XBee_TxStatus_Flag = XBEE_TXSTATUS_SUCCESS;
-          else
-            XBee_TxStatus_Flag = XBEE_TXSTATUS_ERROR;
+          for (i = XBee_TxRetire; i != XBee_TxSend; i++) {
+            slot = &XBee_TxQueue[i & (XBEE_TX_QUEUE_LEN-1)];
+            if (slot->frame_id == status->frame_id && slot->status == XBEE_TXSTATUS_NORMAL) {
+              slot->status = (status->status == 0) ? XBEE_TXSTATUS_SUCCESS : XBEE_TXSTATUS_ERROR;
+              break;
+            }
+          }
           break;
         case API_RX_FRAME:
           if (XBee_RX_Handler != NULL && XBee_RX_Enable == TRUE) {
             XBeeRxFrame rx_frame;
-            BloxFrame *retFrame;
             rx_frame.length = frame.length;
             rx_frame.api = frame.data[0];
             rx_frame.source = frame.data[1] << 8;
             rx_frame.source = frame.data[2];
             rx_frame.rssi = frame.data[3];
             rx_frame.options = frame.data[4];
-            memcpy(&(rx_frame.blox_frame), &(frame.data[5]), rx_frame.length-5);
+            if (XBee_Unpack(&frame.data[XBEE_RX_HEADER_LEN], rx_frame.length-XBEE_RX_HEADER_LEN,
+                            &(rx_frame.blox_frame)) == FALSE)
+              break;
             rx_frame.checksum = data;
-            retFrame = (BloxFrame *)malloc(sizeof(BloxFrame));
-            memcpy(retFrame, &(rx_frame.blox_frame), sizeof(BloxFrame));
-            XBee_RX_Handler(retFrame);
-            free(retFrame);
+            if (Blox_Flash_IsBusy() || XBee_FramePending) {
+              /* Only one frame is held; a newer one replaces it. Copied by
+               * hand since the library memcpy lives in flash. */
+              for (i = 0; i < sizeof(BloxFrame); i++)
+                ((uint8_t *)&XBee_PendingFrame)[i] = ((uint8_t *)&(rx_frame.blox_frame))[i];
+              XBee_FramePending = TRUE;
+              Blox_Flash_Defer(&XBee_RetriggerRXNE);
+            } else {
+              XBee_RX_Handler(&(rx_frame.blox_frame));
+            }
           }
           break;
         }
@@ -361,6 +459,7 @@ void Blox_XBee_Disable_RX_IRQ(void) {
 BloxFrame * Blox_XBee_Receive(void) {
   XBeeRxFrame frame;
   BloxFrame *retFrame;
+  uint8_t wire[XBEE_WIRE_HEADER_LEN + BLOX_FRAME_DATA_LEN];
   uint8_t ret = 0;
   uint8_t checksum = 0;
   uint32_t i;
@@ -375,7 +474,7 @@ BloxFrame * Blox_XBee_Receive(void) {
   frame.length = ret << 8;
   Blox_VUSART_Receive(XBEE_VUSART_ID, &ret);
   frame.length |= ret;
-  if(frame.length > 100) {
+  if(frame.length < XBEE_RX_HEADER_LEN || frame.length > XBEE_RX_HEADER_LEN + sizeof(wire)) {
     return NULL;
   }
   Blox_VUSART_Receive(XBEE_VUSART_ID, &(frame.api));
@@ -394,63 +493,213 @@ BloxFrame * Blox_XBee_Receive(void) {
   frame.options = ret;
   checksum += ret;
 
-  for(i = 0; i < frame.length-5; i++) {
-    Blox_VUSART_Receive(XBEE_VUSART_ID, ((uint8_t *)&(frame.blox_frame))+i);
-    checksum += ((char *)&(frame.blox_frame))[i];
+  for(i = 0; i < frame.length-XBEE_RX_HEADER_LEN; i++) {
+    Blox_VUSART_Receive(XBEE_VUSART_ID, &wire[i]);
+    checksum += wire[i];
   }
   Blox_VUSART_Receive(XBEE_VUSART_ID, &(frame.checksum));
   
-  if (frame.checksum != 0xFF-checksum)
+  if (frame.checksum != 0xFF-checksum
+        || XBee_Unpack(wire, frame.length-XBEE_RX_HEADER_LEN, &(frame.blox_frame)) == FALSE)
     return NULL;
   
   retFrame = (BloxFrame *)malloc(sizeof(BloxFrame));
+  if (retFrame == NULL)
+    return NULL;
   memcpy(retFrame, &(frame.blox_frame), sizeof(BloxFrame));
   
   return retFrame;
 }
 
 /**
- * @brief Sends data out of a specific type on the XBee.
+ * @brief Sends data out of a specific type on the XBee and waits for the
+ *        XBee to report on it. From an interrupt, where the report could
+ *        not come in, it only writes the frame out, or leaves it queued if
+ *        the code it interrupted was part way through writing another.
  * @param data: the data to be sent.
  * @param len: the amount of data being sent.
  * @param type: the type of the BloxFrame.
  * @param dst_id: the dest xbee id to send to.
- * @retval XBEE_OK if successful, XBEE_INIT_FAIL on failure.
+ * @retval XBEE_OK if successful, XBEE_TX_FAIL if the frame could not be
+ *         queued, XBEE_TX_STATUS_FAIL if the XBee did not send it.
  */
 XBEE_STATUS Blox_XBee_Send (uint8_t *data, uint32_t len, BloxFrameType type, uint32_t dst_id) {
+  if (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) {
+    if (Blox_XBee_SendAsync(data, len, type, dst_id, NULL, NULL) != XBEE_OK)
+      return XBEE_TX_FAIL;
+    while (Blox_XBee_Poll()) ;
+    return XBEE_OK;
+  }
+  
+  XBee_SyncPending = TRUE;
+  if (Blox_XBee_SendAsync(data, len, type, dst_id, &XBee_SyncDone, (uint8_t *)&XBee_SyncId) != XBEE_OK) {
+    XBee_SyncPending = FALSE;
+    return XBEE_TX_FAIL;
+  }
+  while (XBee_SyncPending)
+    Blox_XBee_Poll();
+  return XBee_SyncStatus;
+}
+
+/**
+ * @brief Records the outcome of the frame Blox_XBee_Send is waiting on.
+ * @param frame_id: the frame's API frame id.
+ * @param status: how it went.
+ * @retval None.
+ */
+void XBee_SyncDone(uint8_t frame_id, XBEE_STATUS status) {
+  if (frame_id != XBee_SyncId)
+    return;
+  XBee_SyncStatus = status;
+  XBee_SyncPending = FALSE;
+}
+
+/**
+ * @brief Queues data out of a specific type on the XBee without waiting.
+ *        Only len bytes of data go over the air, after a packed header.
+ *        Blox ids are sent as 16 bits, the width of the XBee address ATMY
+ *        sets from them. The data is copied, so the buffer may be reused
+ *        straight away. Frames go out as Blox_XBee_Poll is called.
+ * @param data: the data to be sent.
+ * @param len: the amount of data being sent.
+ * @param type: the type of the BloxFrame.
+ * @param dst_id: the dest xbee id to send to.
+ * @param callback: called from Blox_XBee_Poll with the frame's TX status,
+ *        or NULL. Frames without a callback ask the XBee for no status and
+ *        leave the queue as soon as they are written.
+ * @param frame_id: set to the frame's API frame id, if not NULL.
+ * @retval XBEE_OK if queued, XBEE_TX_FAIL if too long or the queue is full.
+ */
+XBEE_STATUS Blox_XBee_SendAsync(uint8_t *data, uint32_t len, BloxFrameType type, uint32_t dst_id,
+                                XBeeTxCallback callback, uint8_t *frame_id) {
   XBeeTxFrame frame;
-  uint16_t i;
+  XBeeTxSlot *slot;
+  BloxCritical crit;
   if(len > BLOX_FRAME_DATA_LEN)
     return XBEE_TX_FAIL;
   
   frame.start = 0x7E;
   frame.api = 0x01;
-  frame.length = sizeof(BloxFrame) + 5; // length includes checksum
+  frame.length = XBEE_TX_HEADER_LEN + XBEE_WIRE_HEADER_LEN + len;
   frame.dest_addr = 0xFFFF;
   frame.options = 0x04;
-  frame.id = 1;
-  frame.blox_frame.src_id = Blox_System_GetId();
-  frame.blox_frame.dst_id = dst_id;
-  frame.blox_frame.type = type;
-  frame.blox_frame.len = len;
-  for (i = 0; i < len; i++)
-    frame.blox_frame.data[i] = data[i];
+  frame.src_id = Blox_System_GetId();
+  frame.dst_id = dst_id;
+  frame.type = type;
+  frame.len = len;
+  frame.data = data;
   
-  //checksum split up for hand debugging
-  frame.checksum = 0xFF;
-  frame.checksum -= frame.api;
-  frame.checksum -= frame.id;
-  frame.checksum -= (frame.dest_addr >> 8) & 0xFF;
-  frame.checksum -= frame.dest_addr & 0xFF;
-  frame.checksum -= frame.options;
-  for (i = 0; i < sizeof(BloxFrame); i++)
-    frame.checksum -= ((uint8_t *)&(frame.blox_frame))[i];
+  crit = Blox_System_EnterCritical(NVIC_PRIO_SOFTIRQ);
+  if ((uint8_t)(XBee_TxWrite - XBee_TxRetire) == XBEE_TX_QUEUE_LEN) {
+    Blox_System_ExitCritical(crit);
+    return XBEE_TX_FAIL;
+  }
+  frame.id = 0;
+  if (callback != NULL) {
+    frame.id = XBee_NextFrameId;
+    XBee_NextFrameId = (XBee_NextFrameId == 0xFF) ? 1 : XBee_NextFrameId + 1;
+  }
+  slot = &XBee_TxQueue[XBee_TxWrite & (XBEE_TX_QUEUE_LEN-1)];
+  slot->frame_id = frame.id;
+  slot->status = XBEE_TXSTATUS_NORMAL;
+  slot->callback = callback;
+  slot->length = XBee_PackTxFrame(&frame, slot->wire);
+  if (frame_id != NULL)
+    *frame_id = frame.id;
+  XBee_TxWrite++;
+  Blox_System_ExitCritical(crit);
+  return XBEE_OK;
+}
+
+/**
+ * @brief Moves the transmit queue along without blocking: writes what the
+ *        VUSART will take, fails frames whose TX status is overdue and
+ *        calls the callbacks of finished frames. Call it often while
+ *        frames are queued. If another caller is already writing, only
+ *        the callbacks are run.
+ * @retval TRUE if there are bytes left to write that this call could have
+ *         written, FALSE otherwise.
+ */
+uint8_t Blox_XBee_Poll(void) {
+  XBeeTxSlot *slot;
+  XBeeTxCallback callback;
+  XBEE_STATUS status;
+  uint8_t frame_id, more = FALSE;
+  BloxCritical crit;
+  
+  crit = Blox_System_EnterCritical(NVIC_PRIO_SOFTIRQ);
+  if (XBee_TxPumping == FALSE) {
+    XBee_TxPumping = TRUE;
+    Blox_System_ExitCritical(crit);
+    while (XBee_TxSend != XBee_TxWrite) {
+      slot = &XBee_TxQueue[XBee_TxSend & (XBEE_TX_QUEUE_LEN-1)];
+      if (Blox_VUSART_TrySend(XBEE_VUSART_ID, slot->wire[XBee_TxPos]) != VUSART_SUCCESS)
+        break;
+      if (++XBee_TxPos == slot->length) {
+        XBee_TxPos = 0;
+        slot->sent = SysTick_Get_Milliseconds();
+        if (slot->frame_id == 0)
+          slot->status = XBEE_TXSTATUS_SUCCESS;
+        XBee_TxSend++;
+      }
+    }
+    more = (XBee_TxSend != XBee_TxWrite);
+    XBee_TxPumping = FALSE;
+  } else {
+    Blox_System_ExitCritical(crit);
+  }
   
-  return XBee_SendTxFrame(&frame);
+  while (XBee_Retire(&callback, &frame_id, &status)) {
+    if (callback != NULL)
+      callback(frame_id, status);
+  }
+  return more;
+}
+
+/**
+ * @brief Blox_XBee_Poll in the shape of an idle hook, for loops such as
+ *        Blox_Event_Run that should keep the transmit queue moving.
+ * @retval None.
+ */
+void Blox_XBee_Idle(void) {
+  Blox_XBee_Poll();
+}
+
+/**
+ * @brief Takes the oldest frame in flight off the queue if it is done, or
+ *        its TX status is overdue. Frames leave in the order they were sent.
+ * @param callback: set to the frame's callback.
+ * @param frame_id: set to the frame's API frame id.
+ * @param status: set to XBEE_OK or XBEE_TX_STATUS_FAIL.
+ * @retval TRUE if a frame was taken off, FALSE otherwise.
+ */
+uint8_t XBee_Retire(XBeeTxCallback *callback, uint8_t *frame_id, XBEE_STATUS *status) {
+  XBeeTxSlot *slot;
+  BloxCritical crit = Blox_System_EnterCritical(NVIC_PRIO_SOFTIRQ);
+  if (XBee_TxRetire == XBee_TxSend) {
+    Blox_System_ExitCritical(crit);
+    return FALSE;
+  }
+  slot = &XBee_TxQueue[XBee_TxRetire & (XBEE_TX_QUEUE_LEN-1)];
+  if (slot->status == XBEE_TXSTATUS_NORMAL) {
+    if ((int32_t)(SysTick_Get_Milliseconds() - slot->sent) < XBEE_TX_STATUS_TIMEOUT) {
+      Blox_System_ExitCritical(crit);
+      return FALSE;
+    }
+    slot->status = XBEE_TXSTATUS_ERROR;
+  }
+  *callback = slot->callback;
+  *frame_id = slot->frame_id;
+  *status = (slot->status == XBEE_TXSTATUS_SUCCESS) ? XBEE_OK : XBEE_TX_STATUS_FAIL;
+  XBee_TxRetire++;
+  Blox_System_ExitCritical(crit);
+  return TRUE;
 }
 
 /**
  * @brief Sends data out of a specific type on the XBee for a period of time.
+ *        Keeps the transmit queue full rather than waiting on each frame's
+ *        TX status, and returns once the last frame is written.
  * @param data: the data to be sent.
  * @param len: the amount of data being sent.
  * @param type: the type of the BloxFrame.
@@ -461,38 +710,81 @@ XBEE_STATUS Blox_XBee_Send (uint8_t *data, uint32_t len, BloxFrameType type, uin
 void Blox_XBee_Send_Period (uint8_t *data, uint32_t len, BloxFrameType type, uint32_t dst_id, uint32_t millis) {
   uint32_t cur_time = SysTick_Get_Milliseconds();
   while (SysTick_Get_Milliseconds() < cur_time+millis) {
-    Blox_XBee_Send(data, len, type, dst_id);
+    Blox_XBee_SendAsync(data, len, type, dst_id, NULL, NULL);
+    Blox_XBee_Poll();
   }
+  while (Blox_XBee_Poll()) ;
 }
 
 /**
- * @brief Sends a XBeeTxFrame.
- * @param frame: the frame to be sent.
- * @retval XBEE_OK if successful, XBEE_INIT_FAIL on failure.
+ * @brief Packs a XBeeTxFrame into the bytes sent to the XBee, working out
+ *        the checksum on the way.
+ * @param frame: the frame to be packed.
+ * @param wire: XBEE_TX_FRAME_MAX bytes to pack it into.
+ * @retval the number of bytes packed.
  */
-XBEE_STATUS XBee_SendTxFrame (XBeeTxFrame *frame) {
-  uint8_t i;
-  uint8_t len = frame->length-5;
-  
-  XBee_TxStatus_Flag = XBEE_TXSTATUS_NORMAL;
-
-  Blox_VUSART_Send(XBEE_VUSART_ID, frame->start);
-	Blox_VUSART_Send(XBEE_VUSART_ID, (uint8_t)(frame->length >> 8));
-	Blox_VUSART_Send(XBEE_VUSART_ID, (uint8_t)frame->length);
-	Blox_VUSART_Send(XBEE_VUSART_ID, frame->api);
-	Blox_VUSART_Send(XBEE_VUSART_ID, frame->id);
-	Blox_VUSART_Send(XBEE_VUSART_ID, (uint8_t)(frame->dest_addr >> 8));
-	Blox_VUSART_Send(XBEE_VUSART_ID, (uint8_t)frame->dest_addr);
-	Blox_VUSART_Send(XBEE_VUSART_ID, frame->options);
-	for (i = 0; i < len; i++)
-	  Blox_VUSART_Send(XBEE_VUSART_ID, ((uint8_t *)&(frame->blox_frame))[i]);
-	Blox_VUSART_Send(XBEE_VUSART_ID, frame->checksum);
+uint8_t XBee_PackTxFrame(XBeeTxFrame *frame, uint8_t *wire) {
+  uint8_t i, pos = 0;
+  uint8_t checksum = 0;
   
-  SysTick_Wait(1); //Give it a chance to send.
-  if(XBee_TxStatus_Flag == XBEE_TXSTATUS_SUCCESS)
-    return XBEE_OK;
+  wire[pos++] = frame->start;
+  wire[pos++] = (uint8_t)(frame->length >> 8);
+  wire[pos++] = (uint8_t)frame->length;
+  pos = XBee_PutByte(wire, pos, frame->api, &checksum);
+  pos = XBee_PutByte(wire, pos, frame->id, &checksum);
+  pos = XBee_PutByte(wire, pos, (uint8_t)(frame->dest_addr >> 8), &checksum);
+  pos = XBee_PutByte(wire, pos, (uint8_t)frame->dest_addr, &checksum);
+  pos = XBee_PutByte(wire, pos, frame->options, &checksum);
+  pos = XBee_PutByte(wire, pos, (uint8_t)(frame->src_id >> 8), &checksum);
+  pos = XBee_PutByte(wire, pos, (uint8_t)frame->src_id, &checksum);
+  pos = XBee_PutByte(wire, pos, (uint8_t)(frame->dst_id >> 8), &checksum);
+  pos = XBee_PutByte(wire, pos, (uint8_t)frame->dst_id, &checksum);
+  pos = XBee_PutByte(wire, pos, frame->type, &checksum);
+  pos = XBee_PutByte(wire, pos, frame->len, &checksum);
+  for (i = 0; i < frame->len; i++)
+    pos = XBee_PutByte(wire, pos, frame->data[i], &checksum);
+  wire[pos++] = 0xFF - checksum;
+  return pos;
+}
 
-  return XBEE_TX_FAIL;
+/**
+ * @brief Packs a byte of a frame and adds it to the frame's checksum.
+ * @param wire: the frame being packed.
+ * @param pos: where the byte goes.
+ * @param data: the byte.
+ * @param checksum: the running checksum to update.
+ * @retval the position of the next byte.
+ */
+uint8_t XBee_PutByte(uint8_t *wire, uint8_t pos, uint8_t data, uint8_t *checksum) {
+  wire[pos] = data;
+  *checksum += data;
+  return pos + 1;
+}
+
+/**
+ * @brief Unpacks a BloxFrame as it came over the air, see XBeeTxFrame.
+ *        The data past len is zeroed. Runs from SRAM, since the RX
+ *        interrupt calls it, and copies by hand for the same reason.
+ * @param wire: the packed frame.
+ * @param wireLen: the number of bytes of it received.
+ * @param frame: the frame to fill in.
+ * @retval TRUE if the frame is whole, FALSE if not.
+ */
+BLOX_RAMFUNC uint8_t XBee_Unpack(const uint8_t *wire, uint32_t wireLen, BloxFrame *frame) {
+  uint16_t src, dst;
+  uint8_t i;
+  if (wireLen < XBEE_WIRE_HEADER_LEN || wire[5] > BLOX_FRAME_DATA_LEN
+        || wireLen != XBEE_WIRE_HEADER_LEN + wire[5])
+    return FALSE;
+  src = (wire[0] << 8) | wire[1];
+  dst = (wire[2] << 8) | wire[3];
+  frame->src_id = (src == XBEE_WIRE_BROADCAST) ? XBEE_BLOX_BROADCAST_ID : src;
+  frame->dst_id = (dst == XBEE_WIRE_BROADCAST) ? XBEE_BLOX_BROADCAST_ID : dst;
+  frame->type = (BloxFrameType)wire[4];
+  frame->len = wire[5];
+  for (i = 0; i < BLOX_FRAME_DATA_LEN; i++)
+    frame->data[i] = (i < frame->len) ? wire[XBEE_WIRE_HEADER_LEN + i] : 0;
+  return TRUE;
 }
 /** @} */
 
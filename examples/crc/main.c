@@ -0,0 +1,78 @@
+/********************************************************************************
+ * @file    crc.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief Times the CRC of a page of flash fed by the CPU, fed by DMA and
+ *        computed in software.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "blox_system.h"
+#include "blox_crc.h"
+#include "blox_usb.h"
+
+#define DWT_CTRL    (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT  (*(volatile uint32_t *)0xE0001004)
+#define ROUNDS 16
+
+uint32_t CpuFed(const uint32_t *data, uint32_t words);
+void Measure(char *label, uint32_t (*fn)(const uint32_t *, uint32_t));
+
+/**
+ * Times a CRC of one page of the file store each way, with the cycle
+ * counter in the DWT. All three must give the same CRC.
+ */
+int main(void)
+{
+  USB_Init();
+  Blox_CRC_Init();
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= 1;
+
+  Measure("cpu-fed", CpuFed);
+  Measure("dma-fed", Blox_CRC_Calc);
+  Measure("software", Blox_CRC_Software);
+  while (1);
+}
+
+/**
+ * Feeds the peripheral a word at a time from the CPU.
+ */
+uint32_t CpuFed(const uint32_t *data, uint32_t words)
+{
+  CRC_ResetDR();
+  return CRC_CalcBlockCRC((uint32_t *)data, words);
+}
+
+/**
+ * Prints the average cycles a page took and the CRC it gave.
+ */
+void Measure(char *label, uint32_t (*fn)(const uint32_t *, uint32_t))
+{
+  const uint32_t *page = (const uint32_t *)MEM_STORE_START;
+  uint32_t i, crc = 0, start = DWT_CYCCNT;
+  for (i = 0; i < ROUNDS; i++)
+    crc = fn(page, PAGE_SIZE/WORD_SIZE);
+  Blox_DebugPat("%s: %d cycles/page, crc %x\r\n", label,
+      (DWT_CYCCNT - start)/ROUNDS, crc);
+}
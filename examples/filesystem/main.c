@@ -30,13 +30,21 @@
 #include "stm32f10x.h"
 #include "blox_filesystem.h"
 #include "blox_usb.h"
+#include "blox_counter.h"
 
 #define MKFS 1
 
+void Measure(char *label, FS_STATUS (*op)(void));
+FS_STATUS DeleteFirst(void);
+FS_STATUS LogSamples(void);
+
 int main(void)
 {
   uint32_t *page;
+  FLASH_Stats stats;
+  FLASH_Wear wear;
   USB_Init();
+  SysTick_Init();
   
   Blox_DebugStr("Testing!!!\r\n");
   FS_Init(1);
@@ -78,5 +86,59 @@ int main(void)
   FS_DeleteFile(1);
   FS_DeleteFile(2);
 
+  /* Delete the first app out of 180 used pages. Compacting afterwards moves
+     the same pages the old packing delete did. */
+  FS_CreateFS();
+  FS_CreateFile("first", 8);
+  FS_CreateFile("rest", 172);
+  Measure("delete", DeleteFirst);
+  Measure("compact", FS_Compact);
+  Measure("log", LogSamples);
+
+  Blox_Flash_GetStats(&stats);
+  Blox_DebugPat("flash: %d erases, %d avoided, %d unchanged pages, %d halfwords\r\n",
+      stats.erases, stats.erasesAvoided, stats.unchanged, stats.halfWords);
+  Blox_Flash_GetWear(MEM_STORE_START, MEM_STORE_SIZE/PAGE_SIZE, &wear);
+  Blox_DebugPat("store wear: %d erases, min %d, max %d at %x\r\n",
+      wear.total, wear.min, wear.max, wear.hottest);
   while (1);
 }
+
+/**
+ * Runs a filesystem operation and prints how long it took and how many
+ * pages it erased.
+ */
+void Measure(char *label, FS_STATUS (*op)(void))
+{
+  uint32_t start = SysTick_Get_Milliseconds();
+  uint32_t erases = Blox_Flash_GetEraseCount();
+  FS_STATUS status = op();
+  Blox_DebugPat("%s: status %d, %d ms, %d erases\r\n", label, status,
+      SysTick_Get_Milliseconds() - start, Blox_Flash_GetEraseCount() - erases);
+}
+
+FS_STATUS DeleteFirst(void)
+{
+  return FS_DeleteFile(0);
+}
+
+/**
+ * Logs 1000 timestamped samples to a data file, syncing every 100, then
+ * reads the last one back.
+ */
+FS_STATUS LogSamples(void)
+{
+  FS_DataFile log;
+  uint32_t sample[2], i;
+  FS_STATUS status = FS_Open(&log, "log");
+  for (i = 0; i < 1000 && status == FS_OK; i++) {
+    sample[0] = SysTick_Get_Milliseconds();
+    sample[1] = i;
+    status = FS_Append(&log, sample, sizeof(sample));
+    if (status == FS_OK && i % 100 == 99)
+      status = FS_Sync(&log);
+  }
+  FS_Read(&log, log.size - sizeof(sample), sample, sizeof(sample));
+  Blox_DebugPat("log: %d bytes, last sample %d\r\n", log.size, sample[1]);
+  return status;
+}
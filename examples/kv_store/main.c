@@ -0,0 +1,101 @@
+/********************************************************************************
+ * @file    kv_store.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief Runs a touch calibration workload against the KV store and reports
+ *        the erase counts it costs.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+ 
+ 
+#include "blox_system.h"
+#include "blox_kv.h"
+#include "blox_usb.h"
+
+#define CAL_ROUNDS 1000
+#define CAL_KEY_GAIN KV_KEY_USER
+
+void Report(char *label);
+
+/**
+ * Each round recalibrates one touch panel, as the touch calibration
+ * program would, and rewrites the whole SysVar. With the old SysVar page
+ * every round cost an erase; here only changed fields are appended.
+ */
+int main(void)
+{
+  SysVar vars;
+  uint32_t i, gain;
+
+  USB_Init();
+  Blox_KV_Init();
+  Blox_System_GetVars(&vars);
+  if (vars.magic != SYS_MAGIC) {
+    Blox_System_Create();
+    Blox_System_GetVars(&vars);
+  }
+  Report("before");
+
+  for (i = 0; i < CAL_ROUNDS; i++) {
+    switch (i % 4) {
+      case 0:
+        vars.TOUCH_1_X = i;
+        vars.TOUCH_1_Y = -i;
+        break;
+      case 1:
+        vars.TOUCH_2_X = i;
+        vars.TOUCH_2_Y = -i;
+        break;
+      case 2:
+        vars.TOUCH_3_X = i;
+        vars.TOUCH_3_Y = -i;
+        break;
+      default:
+        vars.TOUCH_4_X = i;
+        vars.TOUCH_4_Y = -i;
+        break;
+    }
+    Blox_System_WriteVars(&vars);
+    gain = i / 100;
+    Blox_KV_Write(CAL_KEY_GAIN, &gain, sizeof(gain));
+  }
+  Report("after");
+  USB_SendPat("SysVar page would have taken %d erases\r\n", CAL_ROUNDS);
+
+  while(1);
+}
+
+/**
+ * Prints the KV store's counters.
+ */
+void Report(char *label)
+{
+  KV_Stats stats;
+  uint32_t i;
+
+  Blox_KV_GetStats(&stats);
+  USB_SendPat("KV %s: %d writes, %d skipped, %d gcs, %d records, %d bytes free\r\n",
+      label, stats.writes, stats.skipped, stats.gcs, stats.records, stats.free);
+  for (i = 0; i < KV_NUM_PAGES; i++)
+    USB_SendPat("  page %d: %d erases\r\n", i, stats.erases[i]);
+}
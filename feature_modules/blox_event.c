@@ -0,0 +1,467 @@
+/**
+ * @file    blox_event.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   A run-to-completion event loop. Interrupts post events into
+ *          priority queues and the main loop dispatches them to handlers.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "blox_event.h"
+#include "blox_usb.h"
+
+/**
+ * @ingroup feature_event
+ * @{
+ */
+
+/**
+ * @brief An event waiting in a queue.
+ */
+typedef struct {
+  uint8_t type;
+  int8_t buf;           /**< Index into the data pool, or -1 */
+  uint16_t src;
+  uint32_t arg;
+  uint32_t posted;
+} QueuedEvent;
+
+/**
+ * @brief A ring buffer of events for one priority.
+ */
+typedef struct {
+  QueuedEvent events[EVENT_QUEUE_SIZE];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+} EventQueue;
+
+/**
+ * @brief A software timer checked by the event loop.
+ */
+typedef struct {
+  uint32_t period;
+  uint32_t next;
+  uint8_t active;
+  uint8_t periodic;
+} EventTimer;
+
+/* Private function prototypes */
+EVENT_STATUS Event_Enqueue(BloxEventType type, uint16_t src, uint32_t arg, int8_t buf, uint32_t posted);
+int8_t Event_AllocBuf(void);
+void Event_FreeBuf(int8_t buf);
+uint8_t Event_Pending(void);
+void Event_CheckTimers(void);
+
+static EventQueue queues[EVENT_NUM_PRIOS];
+static BloxEventHandler handlers[EVENT_MAX_TYPES];
+static uint8_t prios[EVENT_MAX_TYPES];
+static BloxEventStats stats[EVENT_NUM_PRIOS];
+static EventTimer timers[EVENT_MAX_TIMERS];
+static ptrVoidFn idleHooks[EVENT_MAX_IDLE];
+
+/**
+ * @brief Storage for events that carry a frame. An XBee frame only lives
+ *        on the interrupt's stack and an IR frame is freed by its source
+ *        once posted, so the data is copied here.
+ */
+static uint32_t pool[EVENT_POOL_SIZE][(EVENT_DATA_SIZE+3)/4];
+static volatile uint8_t poolUsed;
+
+/**
+ * @brief Clears all queues, handlers, timers and statistics.
+ * @retval None
+ */
+void Blox_Event_Init(void) {
+  memset(queues, 0, sizeof(queues));
+  memset(handlers, 0, sizeof(handlers));
+  memset(timers, 0, sizeof(timers));
+  poolUsed = 0;
+  memset(idleHooks, 0, sizeof(idleHooks));
+  Blox_Event_ClearStats();
+}
+
+/**
+ * @brief Registers the handler for a type of event. Events of a type with
+ *        no handler are not queued.
+ * @param type the type of event
+ * @param prio the queue events of this type are posted to
+ * @param handler the function called from Blox_Event_Dispatch
+ * @retval EVENT_OK, or EVENT_BAD_TYPE if type or prio is out of range.
+ */
+EVENT_STATUS Blox_Event_Register(BloxEventType type, BloxEventPrio prio, BloxEventHandler handler) {
+  if (type >= EVENT_MAX_TYPES || prio >= EVENT_NUM_PRIOS)
+    return EVENT_BAD_TYPE;
+  prios[type] = prio;
+  handlers[type] = handler;
+  return EVENT_OK;
+}
+
+/**
+ * @brief Removes the handler for a type of event. Events of this type that
+ *        are already queued are dropped when dispatched.
+ * @param type the type of event
+ * @retval None
+ */
+void Blox_Event_Unregister(BloxEventType type) {
+  if (type < EVENT_MAX_TYPES)
+    handlers[type] = NULL;
+}
+
+/**
+ * @brief Posts an event. Safe to call from interrupts.
+ * @param type the type of event
+ * @param src which source posted it
+ * @param arg a type-specific value
+ * @retval EVENT_OK if queued, or why it was not.
+ */
+EVENT_STATUS Blox_Event_Post(BloxEventType type, uint16_t src, uint32_t arg) {
+  if (type >= EVENT_MAX_TYPES)
+    return EVENT_BAD_TYPE;
+  if (handlers[type] == NULL)
+    return EVENT_NO_HANDLER;
+  return Event_Enqueue(type, src, arg, -1, Blox_Event_Now());
+}
+
+/**
+ * @brief Posts an event with a copy of a buffer. Safe to call from
+ *        interrupts. The handler sees the copy in event->data.
+ * @param type the type of event
+ * @param src which source posted it
+ * @param arg a type-specific value
+ * @param data the buffer to copy
+ * @param len the length of data, at most EVENT_DATA_SIZE
+ * @retval EVENT_OK if queued, or why it was not.
+ */
+EVENT_STATUS Blox_Event_PostData(BloxEventType type, uint16_t src, uint32_t arg, void *data, uint32_t len) {
+  uint32_t posted = Blox_Event_Now();
+  EVENT_STATUS status;
+  int8_t buf;
+
+  if (type >= EVENT_MAX_TYPES || len > EVENT_DATA_SIZE)
+    return EVENT_BAD_TYPE;
+  if (handlers[type] == NULL)
+    return EVENT_NO_HANDLER;
+  if ((buf = Event_AllocBuf()) < 0) {
+    stats[prios[type]].dropped++;
+    return EVENT_NO_BUFFER;
+  }
+  memcpy(pool[buf], data, len);
+  if ((status = Event_Enqueue(type, src, arg, buf, posted)) != EVENT_OK)
+    Event_FreeBuf(buf);
+  return status;
+}
+
+/**
+ * @brief Adds an event to the queue for its type's priority.
+ * @retval EVENT_OK, or EVENT_QUEUE_FULL.
+ */
+EVENT_STATUS Event_Enqueue(BloxEventType type, uint16_t src, uint32_t arg, int8_t buf, uint32_t posted) {
+  EventQueue *q = &queues[prios[type]];
+  QueuedEvent *e;
+  BloxCritical crit = Blox_System_EnterCritical(EVENT_CRITICAL_PRIO);
+  if ((uint8_t)(q->head - q->tail) == EVENT_QUEUE_SIZE) {
+    stats[prios[type]].dropped++;
+    Blox_System_ExitCritical(crit);
+    return EVENT_QUEUE_FULL;
+  }
+  e = &q->events[q->head % EVENT_QUEUE_SIZE];
+  e->type = type;
+  e->buf = buf;
+  e->src = src;
+  e->arg = arg;
+  e->posted = posted;
+  q->head++;
+  Blox_System_ExitCritical(crit);
+  return EVENT_OK;
+}
+
+/**
+ * @brief Takes a buffer from the data pool.
+ * @retval the buffer index, or -1 if the pool is empty.
+ */
+int8_t Event_AllocBuf(void) {
+  int8_t i;
+  BloxCritical crit = Blox_System_EnterCritical(EVENT_CRITICAL_PRIO);
+  for (i = 0; i < EVENT_POOL_SIZE; i++) {
+    if (!(poolUsed & (1<<i))) {
+      poolUsed |= (1<<i);
+      Blox_System_ExitCritical(crit);
+      return i;
+    }
+  }
+  Blox_System_ExitCritical(crit);
+  return -1;
+}
+
+/**
+ * @brief Returns a buffer to the data pool.
+ * @retval None
+ */
+void Event_FreeBuf(int8_t buf) {
+  BloxCritical crit = Blox_System_EnterCritical(EVENT_CRITICAL_PRIO);
+  poolUsed &= ~(1<<buf);
+  Blox_System_ExitCritical(crit);
+}
+
+/**
+ * @brief Returns whether any queue holds an event.
+ * @retval TRUE if an event is waiting.
+ */
+uint8_t Event_Pending(void) {
+  uint8_t i;
+  for (i = 0; i < EVENT_NUM_PRIOS; i++) {
+    if (queues[i].head != queues[i].tail)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/**
+ * @brief Posts EVENT_TIMER for every timer that has expired.
+ * @retval None
+ */
+void Event_CheckTimers(void) {
+  uint32_t now = SysTick_Get_Milliseconds();
+  uint8_t i;
+  for (i = 0; i < EVENT_MAX_TIMERS; i++) {
+    if (timers[i].active && (int32_t)(now - timers[i].next) >= 0) {
+      if (timers[i].periodic)
+        timers[i].next += timers[i].period;
+      else
+        timers[i].active = FALSE;
+      Blox_Event_Post(EVENT_TIMER, i, now);
+    }
+  }
+}
+
+/**
+ * @brief Runs the handler for the oldest event of the highest priority
+ *        that has one waiting. Handlers run to completion, one at a time.
+ * @retval 1 if an event was dispatched, 0 if all queues were empty.
+ */
+uint8_t Blox_Event_Dispatch(void) {
+  BloxEvent event;
+  BloxEventHandler handler;
+  QueuedEvent *e;
+  EventQueue *q;
+  uint32_t latency;
+  int8_t buf;
+  int8_t i;
+
+  Event_CheckTimers();
+  for (i = EVENT_NUM_PRIOS-1; i >= 0; i--) {
+    q = &queues[i];
+    if (q->head == q->tail)
+      continue;
+
+    e = &q->events[q->tail % EVENT_QUEUE_SIZE];
+    event.type = (BloxEventType)e->type;
+    event.src = e->src;
+    event.arg = e->arg;
+    event.posted = e->posted;
+    buf = e->buf;
+    event.data = (buf < 0) ? NULL : pool[buf];
+    q->tail++;
+
+    latency = Blox_Event_Now() - event.posted;
+    stats[i].count++;
+    stats[i].total += latency;
+    if (latency > stats[i].max)
+      stats[i].max = latency;
+
+    handler = handlers[event.type];
+    if (handler != NULL)
+      handler(&event);
+    if (buf >= 0)
+      Event_FreeBuf(buf);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Dispatches events forever. When every queue is empty, calls the
+ *        idle hooks and then sleeps until the next interrupt.
+ * @retval None
+ */
+void Blox_Event_Run(void) {
+  uint8_t i;
+  while (1) {
+    if (Blox_Event_Dispatch())
+      continue;
+    for (i = 0; i < EVENT_MAX_IDLE && idleHooks[i] != NULL; i++)
+      idleHooks[i]();
+    /* An interrupt between the check and the WFI still wakes the core,
+     * since a pending interrupt ends WFI even while masked. */
+    __disable_irq();
+    if (!Event_Pending())
+      __WFI();
+    __enable_irq();
+  }
+}
+
+/**
+ * @brief Adds a function to call each time the loop runs out of events,
+ *        before it sleeps. It should return quickly. The loop wakes at
+ *        least every SysTick, so work left over is picked up shortly.
+ * @param idle the function, or NULL to remove them all
+ * @retval EVENT_OK, or EVENT_QUEUE_FULL if EVENT_MAX_IDLE are registered.
+ */
+EVENT_STATUS Blox_Event_Register_Idle(ptrVoidFn idle) {
+  uint8_t i;
+  if (idle == NULL) {
+    memset(idleHooks, 0, sizeof(idleHooks));
+    return EVENT_OK;
+  }
+  for (i = 0; i < EVENT_MAX_IDLE; i++) {
+    if (idleHooks[i] == NULL || idleHooks[i] == idle) {
+      idleHooks[i] = idle;
+      return EVENT_OK;
+    }
+  }
+  return EVENT_QUEUE_FULL;
+}
+
+/**
+ * @brief Starts a software timer that posts EVENT_TIMER when it expires.
+ *        Needs SysTick_Init.
+ * @param period_ms the time until it expires, in milliseconds
+ * @param periodic TRUE to restart the timer each time it expires
+ * @retval the timer id, posted as the event's src, or -1 if none are free.
+ */
+int8_t Blox_Event_StartTimer(uint32_t period_ms, uint8_t periodic) {
+  int8_t i;
+  for (i = 0; i < EVENT_MAX_TIMERS; i++) {
+    if (!timers[i].active) {
+      timers[i].period = period_ms;
+      timers[i].next = SysTick_Get_Milliseconds() + period_ms;
+      timers[i].periodic = periodic;
+      timers[i].active = TRUE;
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Stops a software timer.
+ * @param id the id returned by Blox_Event_StartTimer
+ * @retval None
+ */
+void Blox_Event_StopTimer(int8_t id) {
+  if (id >= 0 && id < EVENT_MAX_TIMERS)
+    timers[id].active = FALSE;
+}
+
+/**
+ * @brief Returns the time since SysTick_Init in microseconds, using the
+ *        SysTick counter for the part below a millisecond.
+ * @retval the current time in microseconds.
+ */
+uint32_t Blox_Event_Now(void) {
+  uint32_t ms, val;
+  do {
+    ms = SysTick_Get_Milliseconds();
+    val = SysTick->VAL;
+  } while (ms != SysTick_Get_Milliseconds());
+  return ms*1000 + ((SysTick->LOAD - val) * 1000) / (SysTick->LOAD + 1);
+}
+
+/**
+ * @brief Returns the latency statistics for one priority.
+ * @param prio the priority
+ * @param retStats where the statistics are copied
+ * @retval None
+ */
+void Blox_Event_GetStats(BloxEventPrio prio, BloxEventStats *retStats) {
+  if (prio < EVENT_NUM_PRIOS)
+    memcpy(retStats, &stats[prio], sizeof(BloxEventStats));
+}
+
+/**
+ * @brief Resets the latency statistics for all priorities.
+ * @retval None
+ */
+void Blox_Event_ClearStats(void) {
+  memset(stats, 0, sizeof(stats));
+}
+
+/**
+ * @brief Posts EVENT_GESTURE. Register with Blox_Gesture_Register_IRQ.
+ * @param touchNumber the touch panel
+ * @param gesture the gesture id
+ * @retval None
+ */
+void Blox_Event_GestureSource(int touchNumber, int gesture) {
+  Blox_Event_Post(EVENT_GESTURE, touchNumber, gesture);
+}
+
+/**
+ * @brief Posts EVENT_XBEE_FRAME. Register with Blox_XBee_Register_RX_IRQ.
+ * @param frame the received frame
+ * @retval None
+ */
+void Blox_Event_XBeeSource(BloxFrame *frame) {
+  Blox_Event_PostData(EVENT_XBEE_FRAME, 0, frame->src_id, frame, sizeof(BloxFrame));
+}
+
+/**
+ * @brief Posts EVENT_IR_FRAME. Register with Blox_IR_Register_RX_IRQ.
+ *        The payload is copied after the IRFrame and its data pointer fixed.
+ *        The IR driver hands over the frame and its data, which are freed
+ *        here whether or not the event is posted; handlers get the copy
+ *        and must not free it.
+ * @param frame the received frame
+ * @retval None
+ */
+void Blox_Event_IRSource(IRFrame *frame) {
+  IRFrame *copy;
+  int8_t buf;
+
+  if (handlers[EVENT_IR_FRAME] != NULL && sizeof(IRFrame) + frame->len <= EVENT_DATA_SIZE) {
+    if ((buf = Event_AllocBuf()) < 0) {
+      stats[prios[EVENT_IR_FRAME]].dropped++;
+    } else {
+      copy = (IRFrame *)pool[buf];
+      memcpy(copy, frame, sizeof(IRFrame));
+      copy->data = (uint8_t *)copy + sizeof(IRFrame);
+      memcpy(copy->data, frame->data, frame->len);
+      if (Event_Enqueue(EVENT_IR_FRAME, frame->src_face_id, frame->src_id, buf, Blox_Event_Now()) != EVENT_OK)
+        Event_FreeBuf(buf);
+    }
+  }
+  free(frame->data);
+  free(frame);
+}
+
+/**
+ * @brief Posts EVENT_USB_BYTE for each received byte. Register with
+ *        Blox_USART_Register_RXNE_IRQ(USB_USART_ID, ...).
+ * @retval None
+ */
+void Blox_Event_USBSource(void) {
+  int16_t data;
+  while ((data = USB_TryReceive()) >= 0)
+    Blox_Event_Post(EVENT_USB_BYTE, 0, data);
+}
+/** @} */
@@ -0,0 +1,125 @@
+/**
+ * @file    blox_event.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   A run-to-completion event loop. Interrupts post events into
+ *          priority queues and the main loop dispatches them to handlers.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __BLOX_EVENT_H
+#define __BLOX_EVENT_H
+
+#include "blox_system.h"
+#include "blox_counter.h"
+#include "blox_xbee.h"
+#include "blox_ir.h"
+
+/**
+ * @ingroup feature_event
+ * @{
+ */
+#define EVENT_QUEUE_SIZE   16     /**< Events per priority queue, a power of 2 */
+#define EVENT_POOL_SIZE    8      /**< Buffers for events that carry a frame */
+#define EVENT_DATA_SIZE    120    /**< Fits a BloxFrame, or an IRFrame and its payload */
+#define EVENT_MAX_TIMERS   8
+#define EVENT_MAX_IDLE     4      /**< Functions called when the queues run dry */
+/** The most urgent level that posts events: USB and IR bytes arrive there */
+#define EVENT_CRITICAL_PRIO NVIC_PRIO_USART
+
+/**
+ * @brief The kinds of events. Applications may define their own types from
+ *        EVENT_USER up to EVENT_MAX_TYPES.
+ */
+typedef enum {
+  EVENT_GESTURE,      /**< src is the touch panel, arg the gesture id */
+  EVENT_XBEE_FRAME,   /**< data is a copy of the BloxFrame */
+  EVENT_IR_FRAME,     /**< src is the sender's face, data is a copy of the IRFrame */
+  EVENT_TIMER,        /**< src is the timer id */
+  EVENT_USB_BYTE,     /**< arg is the received byte */
+  EVENT_USER,
+  EVENT_MAX_TYPES = 16
+} BloxEventType;
+
+/**
+ * @brief Queue priorities. Higher queues are always drained first.
+ */
+typedef enum {
+  EVENT_PRIO_LOW,
+  EVENT_PRIO_NORMAL,
+  EVENT_PRIO_HIGH,
+  EVENT_NUM_PRIOS
+} BloxEventPrio;
+
+typedef enum {
+  EVENT_OK = 0,
+  EVENT_QUEUE_FULL = -1,
+  EVENT_NO_HANDLER = -2,
+  EVENT_NO_BUFFER = -3,
+  EVENT_BAD_TYPE = -4
+} EVENT_STATUS;
+
+/**
+ * @brief An event as seen by a handler.
+ */
+typedef struct {
+  BloxEventType type;   /**< The type of event */
+  uint16_t src;         /**< Which source posted it (panel, IR id, timer id) */
+  uint32_t arg;         /**< A type-specific value */
+  void *data;           /**< A type-specific buffer, valid during the handler */
+  uint32_t posted;      /**< Blox_Event_Now() when the event was posted */
+} BloxEvent;
+
+/**
+ * @brief Post-to-handler latency, in microseconds, for one priority.
+ */
+typedef struct {
+  uint32_t count;       /**< Events dispatched */
+  uint32_t dropped;     /**< Events lost to a full queue or pool */
+  uint32_t max;         /**< Worst latency seen */
+  uint32_t total;       /**< Sum of latencies, for the average */
+} BloxEventStats;
+
+typedef void (*BloxEventHandler)(BloxEvent *event);
+
+void Blox_Event_Init(void);
+EVENT_STATUS Blox_Event_Register(BloxEventType type, BloxEventPrio prio, BloxEventHandler handler);
+void Blox_Event_Unregister(BloxEventType type);
+EVENT_STATUS Blox_Event_Post(BloxEventType type, uint16_t src, uint32_t arg);
+EVENT_STATUS Blox_Event_PostData(BloxEventType type, uint16_t src, uint32_t arg, void *data, uint32_t len);
+uint8_t Blox_Event_Dispatch(void);
+void Blox_Event_Run(void);
+EVENT_STATUS Blox_Event_Register_Idle(ptrVoidFn idle);
+int8_t Blox_Event_StartTimer(uint32_t period_ms, uint8_t periodic);
+void Blox_Event_StopTimer(int8_t id);
+uint32_t Blox_Event_Now(void);
+void Blox_Event_GetStats(BloxEventPrio prio, BloxEventStats *stats);
+void Blox_Event_ClearStats(void);
+
+/* Event sources, for registering with the drivers' RX callbacks */
+void Blox_Event_GestureSource(int touchNumber, int gesture);
+void Blox_Event_XBeeSource(BloxFrame *frame);
+void Blox_Event_IRSource(IRFrame *frame);
+void Blox_Event_USBSource(void);
+/** @} */
+#endif
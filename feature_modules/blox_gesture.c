@@ -39,6 +39,7 @@ uint16_t val[4]={0,0,0,0}; //[Touch1 #datapoints, Touch2 #datapoints, Touch3 #da
 uint16_t XVals[4][50]; 
 uint16_t YVals[4][50];   
 GestureRecord LastGesture[4]; //Timestamp and last gesture recorded for each touchpanel 
+void (*Gesture_Handler)(int touchNumber, int gesture) = NULL;
  
 //private functions/*
 void Blox_touch1_isTouched(void);
@@ -305,6 +306,9 @@ void Blox_gestureHandler(int touchNumber){
 	LastGesture[touchNumber-1].gesture=gestureNow; 
 	val[0]=val[1]=val[2]=val[3]=0; //clear 
 	
+  if(Gesture_Handler != NULL)
+    Gesture_Handler(touchNumber, gestureNow);
+	
   for(counter=0; counter<50; counter++) //clear memory
   {
     XVals[touchNumber-1][counter]=0;
@@ -328,5 +332,15 @@ int Blox_Gesture_GetGesture(int touchNumber){
 int Blox_Gesture_GetGestureTime(int touchNumber){
   return LastGesture[touchNumber-1].timestamp; 
 }
+
+/**
+ * @brief Registers a function called from the touch interrupt each time a
+ *        gesture is recognized.
+ * @param handler the function, or NULL for none
+ * @retval None
+ */
+void Blox_Gesture_Register_IRQ(void (*handler)(int touchNumber, int gesture)){
+  Gesture_Handler = handler;
+}
 /** @} */
 
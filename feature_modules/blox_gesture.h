@@ -81,5 +81,6 @@ void Blox_touch3_tracker(void);
 void Blox_touch4_tracker(void);
 int Blox_Gesture_GetGesture(int touchNumber);
 int Blox_Gesture_GetGestureTime(int touchNumber);
+void Blox_Gesture_Register_IRQ(void (*handler)(int touchNumber, int gesture));
 /** @} */
 #endif
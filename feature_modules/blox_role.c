@@ -34,12 +34,15 @@
  * @ingroup feature_role
  * @{
  */
-#define ROLE_FLAG_LOC 0x20006000
-#define ROLE_FN_LOC   0x20006004
+#define ROLE_FLAG_LOC (MEM_KEEP_START+8)
+#define ROLE_FN_LOC   (MEM_KEEP_START+12)
 
 /* Private function prototypes */
 void Blox_Role_RX(BloxFrame *frame);
 uint8_t Role_NextID(void);
+void Role_Start(void);
+uint8_t Role_QueryLen(void);
+void Role_TxDone(uint8_t frame_id, XBEE_STATUS status);
 
 /**
  * @brief The RoleInfo struct for this program.
@@ -66,7 +69,13 @@ static uint8_t role_id = 0;
 /**
  * @brief A flag denoting if a base program has been allocated but not yet run.
  */
-static uint8_t allocating = FALSE;
+static volatile uint8_t allocating = FALSE;
+/**
+ * @brief The frame id of the query Blox_Role_RunTask is waiting on, and
+ *        whether it is still waiting.
+ */
+static uint8_t role_tx_id;
+static volatile uint8_t role_tx_pending = FALSE;
 
 /**
  * @brief Initializes the role driver's data structures.
@@ -118,7 +127,8 @@ void Blox_Role_RX(BloxFrame *frame) {
             respFrame.opcode = PARENT_ACK;
             ((ParentAckFrame *)&(respFrame.data))->role_id = Role_NextID(); //TODO: Get a Role ID here
             Blox_LED_On(LED2);
-            Blox_XBee_Send_Period((uint8_t *)&respFrame, sizeof(RoleFrame), FRAME_TYPE_ROLE, frame->src_id, XBEE_HOLD_PERIOD);
+            Blox_XBee_Send_Period((uint8_t *)&respFrame, ROLE_OPCODE_LEN + sizeof(ParentAckFrame),
+                                  FRAME_TYPE_ROLE, frame->src_id, XBEE_HOLD_PERIOD);
             Blox_LED_Off(LED2);
             info.num_blox_started++;
             allocating = FALSE;
@@ -139,7 +149,7 @@ void Blox_Role_RX(BloxFrame *frame) {
         Blox_LED_Off(LED4);
         respFrame.opcode = PROG_START;
         memcpy(&(((QueryFrame *)&respFrame.data)->name), info.name, FS_FILE_MAX_NAME_LEN);
-        Blox_XBee_Send_Period((uint8_t *)&respFrame, sizeof(RoleFrame), FRAME_TYPE_ROLE, frame->src_id, XBEE_HOLD_PERIOD);
+        Blox_XBee_Send_Period((uint8_t *)&respFrame, Role_QueryLen(), FRAME_TYPE_ROLE, frame->src_id, XBEE_HOLD_PERIOD);
         info.num_blox_found++;
       }
     }
@@ -186,23 +196,45 @@ ROLE_STATUS Blox_Role_Add(ptrVoidFn fn, uint8_t min, uint8_t max) {
  *         otherwise this method never returns.
  */
 ROLE_STATUS Blox_Role_Run(void) {
-  RoleFrame frame;
-  uint8_t num_found;
+  BloxPT pt;
+  PT_INIT(&pt);
+  while (PT_SCHEDULE(Blox_Role_RunTask(&pt)))
+    Blox_XBee_Poll();
+  return ROLE_OK;
+}
+
+/**
+ * @brief  Blox_Role_Run as a task, returning at each wait so other tasks
+ *         can run during the several seconds of negotiation. Resets into
+ *         the allocated role when done, so it never ends. Its queries only
+ *         go out while Blox_XBee_Poll is called, by the loop running it or
+ *         as an idle hook.
+ * @param  pt the task's state, PT_INIT before the first call
+ * @retval the PT_STATUS of the task.
+ */
+PT_THREAD(Blox_Role_RunTask(BloxPT *pt)) {
+  static RoleFrame frame;
+  static uint8_t num_found;
   
+  PT_BEGIN(pt);
   //Am I the parent?
   frame.opcode = PARENT_QUERY;
   memcpy(&(((QueryFrame *)frame.data)->name), info.name, FS_FILE_MAX_NAME_LEN);
-  Blox_XBee_Send_Period((uint8_t *)&frame, sizeof(RoleFrame), FRAME_TYPE_ROLE, XBEE_BLOX_BROADCAST_ID, XBEE_HOLD_PERIOD);
+  PT_TIMER_SET(pt, XBEE_HOLD_PERIOD);
+  while (!PT_EXPIRED(pt)) {
+    role_tx_pending = TRUE;
+    if (Blox_XBee_SendAsync((uint8_t *)&frame, Role_QueryLen(), FRAME_TYPE_ROLE,
+                            XBEE_BLOX_BROADCAST_ID, &Role_TxDone, &role_tx_id) == XBEE_OK)
+      PT_WAIT_UNTIL(pt, role_tx_pending == FALSE);
+    else
+      PT_YIELD(pt); //Queue full, let it drain.
+  }
   Blox_LED_On(LED1);
-  SysTick_Wait(XBEE_HOLD_PERIOD*2); //Let parent respond.
+  PT_WAIT_MS(pt, XBEE_HOLD_PERIOD*2); //Let parent respond.
   Blox_LED_Off(LED1);
 
-  if (parent == STATE_CHILD) {
-    *(uint32_t *)ROLE_FLAG_LOC = 1;
-    FS_SetAppFlag(1);
-    *(uint32_t *)ROLE_FN_LOC = (uint32_t)info.roles[role_id].fn;
-    NVIC_SystemReset();
-  }
+  if (parent == STATE_CHILD)
+    Role_Start();
   
   //I'm the parent. Find base programs with the program.
   parent = STATE_PARENT;  
@@ -212,22 +244,58 @@ ROLE_STATUS Blox_Role_Run(void) {
   while (info.num_blox_found < info.num_wanted) {
     allocating = FALSE;
     Blox_LED_On(LED3);
-    Blox_XBee_Send_Period((uint8_t *)&frame, sizeof(RoleFrame), FRAME_TYPE_ROLE, XBEE_BLOX_BROADCAST_ID, XBEE_HOLD_PERIOD);
+    PT_TIMER_SET(pt, XBEE_HOLD_PERIOD);
+    while (!PT_EXPIRED(pt)) {
+      role_tx_pending = TRUE;
+      if (Blox_XBee_SendAsync((uint8_t *)&frame, Role_QueryLen(), FRAME_TYPE_ROLE,
+                              XBEE_BLOX_BROADCAST_ID, &Role_TxDone, &role_tx_id) == XBEE_OK)
+        PT_WAIT_UNTIL(pt, role_tx_pending == FALSE);
+      else
+        PT_YIELD(pt);
+    }
     Blox_LED_Off(LED3);
-    SysTick_Wait(XBEE_HOLD_PERIOD*4);
+    PT_WAIT_MS(pt, XBEE_HOLD_PERIOD*4);
     if(info.num_blox_found == num_found)
       break;
     num_found = info.num_blox_found;
-    while (allocating == TRUE) ; //Wait for the other program to PROG_QUERY
+    PT_WAIT_WHILE(pt, allocating == TRUE); //Wait for the other program to PROG_QUERY
   }
   
   //Done finding nodes, start yourself.
+  Role_Start();
+  PT_END(pt);
+}
+
+/**
+ * @brief Called from Blox_XBee_Poll once a query Blox_Role_RunTask queued
+ *        has been sent, or given up on.
+ * @param frame_id the frame's API frame id
+ * @param status how it went, which the task does not need
+ * @retval None
+ */
+void Role_TxDone(uint8_t frame_id, XBEE_STATUS status) {
+  if (frame_id == role_tx_id)
+    role_tx_pending = FALSE;
+}
+
+/**
+ * @brief Returns how much of a RoleFrame carrying a QueryFrame needs to be
+ *        sent: the opcode, the name and its terminating NUL.
+ * @retval the length to send
+ */
+uint8_t Role_QueryLen(void) {
+  return ROLE_OPCODE_LEN + info.name_len + 1;
+}
+
+/**
+ * @brief Resets into the allocated role.
+ * @retval None. Never returns.
+ */
+void Role_Start(void) {
   *(uint32_t *)ROLE_FLAG_LOC = 1;
   FS_SetAppFlag(1);
   *(uint32_t *)ROLE_FN_LOC = (uint32_t)info.roles[role_id].fn;
   NVIC_SystemReset();
-  
-  return ROLE_OK;
 }
 
 /**
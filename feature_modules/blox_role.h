@@ -42,6 +42,7 @@
  */
 #define ROLE_MAX 64
 #define ROLE_INF 255
+#define ROLE_OPCODE_LEN 1   /**< Bytes a RoleFrame's opcode takes */
 
 /**
  * @brief Status to return on Role functions
@@ -115,5 +116,6 @@ typedef struct {
 ROLE_STATUS Blox_Role_Init(char *name, uint8_t len);
 ROLE_STATUS Blox_Role_Add(ptrVoidFn fn, uint8_t min, uint8_t max);
 ROLE_STATUS Blox_Role_Run(void);
+PT_THREAD(Blox_Role_RunTask(BloxPT *pt));
 /** @} */
 #endif
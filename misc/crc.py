@@ -0,0 +1,48 @@
+#!/usr/bin/env python
+# (C) 2010 Project Blox <JesseTannahill@gmail.com>
+# CRC-32 as computed by the STM32 CRC peripheral and drivers/src/blox_crc.c.
+#
+# Copyright (C) 2010 by Project Blox
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+import struct
+
+POLY = 0x04C11DB7
+
+def _entry(i):
+	c = i << 24
+	for k in range(8):
+		c = ((c << 1) ^ POLY) if c & 0x80000000 else (c << 1)
+	return c & 0xFFFFFFFF
+
+TABLE = [_entry(i) for i in range(256)]
+
+def crc32(data):
+	"""Returns the CRC of data, zero-padded to whole words, as Blox_CRC_Calc
+	computes it: each little-endian word fed MSB first, starting from
+	0xFFFFFFFF, no final XOR."""
+	if len(data) % 4:
+		data = data + bytes(4 - len(data) % 4)
+	crc = 0xFFFFFFFF
+	for (word,) in struct.iter_unpack("<L", data):
+		crc ^= word
+		for k in range(4):
+			crc = ((crc << 8) & 0xFFFFFFFF) ^ TABLE[crc >> 24]
+	return crc
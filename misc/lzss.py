@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+# (C) 2010 Project Blox <JesseTannahill@gmail.com>
+# LZSS compressor for app images stored compressed on a Blox. Matches
+# drivers/src/blox_lz.c.
+#
+# Copyright (C) 2010 by Project Blox
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+import struct
+import sys
+import crc
+
+MIN_MATCH = 3
+MAX_MATCH = MIN_MATCH + 0x1F
+WINDOW = 2048
+CHAIN = 64
+
+# Must match FS_LZ_MAGIC and FS_LZHeader in blox_filesystem.h
+MAGIC = 0x315A4C42
+PAGE_SIZE = 2048
+
+def compress(data, start=0):
+	"""Returns the LZSS stream for data: a flag byte (LSB first, 1 = literal)
+	before every 8 items, and matches packed as an 11-bit distance-1 and a
+	5-bit length-MIN_MATCH. Only data[start:] is encoded, with matches
+	reaching back into the bytes before it."""
+	out = bytearray()
+	table = {}
+	for k in range(start):
+		table.setdefault(data[k:k+MIN_MATCH], []).append(k)
+	i = start
+	n = len(data)
+	while i < n:
+		flagpos = len(out)
+		out.append(0)
+		for bit in range(8):
+			if i >= n:
+				break
+			best_len = 0
+			best_dist = 0
+			for p in reversed(table.get(data[i:i+MIN_MATCH], [])[-CHAIN:]):
+				if i - p > WINDOW:
+					break
+				l = 0
+				while l < MAX_MATCH and i + l < n and data[p+l] == data[i+l]:
+					l += 1
+				if l > best_len:
+					best_len = l
+					best_dist = i - p
+					if l == MAX_MATCH:
+						break
+			if best_len >= MIN_MATCH:
+				d = best_dist - 1
+				out += bytes([d & 0xFF, ((d >> 8) << 5) | (best_len - MIN_MATCH)])
+				step = best_len
+			else:
+				out[flagpos] |= 1 << bit
+				out.append(data[i])
+				step = 1
+			for k in range(i, i + step):
+				table.setdefault(data[k:k+MIN_MATCH], []).append(k)
+			i += step
+	return bytes(out)
+
+def decompress(stream, history=b''):
+	"""Decodes a stream from compress(), the way Blox_LZ_Decode does, after
+	the bytes in history."""
+	out = bytearray(history)
+	i = 0
+	flags = 0
+	while i < len(stream):
+		if flags <= 1:
+			flags = stream[i] | 0x100
+			i += 1
+			if i >= len(stream):
+				break
+		if flags & 1:
+			out.append(stream[i])
+			i += 1
+		else:
+			d = (stream[i] | ((stream[i+1] & 0xE0) << 3)) + 1
+			l = (stream[i+1] & 0x1F) + MIN_MATCH
+			i += 2
+			for k in range(l):
+				out.append(out[-d])
+		flags >>= 1
+	return bytes(out[len(history):])
+
+def image(data):
+	"""Returns data as a compressed app image: the FS_LZHeader, then the stream.
+	The header carries the CRC of data padded to whole pages, which is what
+	FS_RunFile checks staging against."""
+	stream = compress(data)
+	if decompress(stream) != data:
+		raise Exception ("image failed, stream doesn't decode back to the input")
+	padded = data + bytes(pages(len(data)) * PAGE_SIZE - len(data))
+	return struct.pack("<4L", MAGIC, len(data), len(stream), crc.crc32(padded)) + stream
+
+def pages(size):
+	return (size + PAGE_SIZE - 1) // PAGE_SIZE
+
+if __name__ == '__main__':
+	if len(sys.argv) < 2:
+		print("Usage: lzss.py app.bin [app.blz]")
+		sys.exit(1)
+	data = open(sys.argv[1], 'rb').read()
+	out = image(data)
+	print(sys.argv[1]+": "+str(len(data))+" -> "+str(len(out))+" bytes ("
+		+ "%.1f%%" % (100.0 * len(out) / max(len(data), 1)) + "), "
+		+ str(pages(len(data)))+" -> "+str(pages(len(out)))+" pages")
+	if len(sys.argv) > 2:
+		open(sys.argv[2], 'wb').write(out)
@@ -0,0 +1,83 @@
+#!/usr/bin/env python
+# (C) 2010 Project Blox <JesseTannahill@gmail.com>
+# Reports which functions armlink placed in SRAM.
+#
+# Copyright (C) 2010 by Project Blox
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+import re
+import sys
+
+# Functions that must run from SRAM for comms and timekeeping to survive a
+# flash erase or program. Keep in sync with the BLOX_RAMFUNC markings.
+required = [
+	'SysTick_Handler',
+	'TIM2_IRQHandler',
+	'EXTI15_10_IRQHandler',
+	'VUSART1_RxStart',
+	'VUSART1_RxData',
+	'VUSART1_TxData',
+	'Blox_XBee_VUSART_RXNE_IRQ',
+	'Blox_Flash_ErasePage',
+	'Blox_Flash_ProgramHalfWord',
+]
+
+RAM_START = 0x20000000
+RAM_END = 0x20010000
+
+# e.g. "    SysTick_Handler     0x20000201   Thumb Code    40  blox_counter.o(blox_ramfunc)"
+symbol = re.compile(r'^\s+(\S+)\s+0x([0-9a-fA-F]+)\s+(?:Thumb|ARM) Code\s+(\d+)\s+(\S+)')
+
+def help():
+	"""\
+	Usage: ramfunc_report.py [mapfile]
+
+	Lists the code armlink placed in SRAM, from a map file generated with
+	--map --symbols, and fails if a required function was left in flash."""
+	print(help.__doc__)
+	sys.exit(1)
+
+if len(sys.argv) < 2:
+	help()
+
+inRam = {}
+inFlash = {}
+for line in open(sys.argv[1]):
+	m = symbol.match(line)
+	if m is None:
+		continue
+	name, addr, size, obj = m.group(1), int(m.group(2), 16), int(m.group(3)), m.group(4)
+	if RAM_START <= addr < RAM_END:
+		inRam[name] = (addr & ~1, size, obj)
+	else:
+		inFlash[name] = (addr & ~1, size, obj)
+
+total = 0
+for name in sorted(inRam, key=lambda n: inRam[n][0]):
+	addr, size, obj = inRam[name]
+	total += size
+	print("0x%08x %6d  %-32s %s" % (addr, size, name, obj))
+print(str(len(inRam))+" functions, "+str(total)+" bytes in SRAM")
+
+missing = [name for name in required if name not in inRam]
+for name in missing:
+	where = "in flash" if name in inFlash else "not linked"
+	print("ERROR: "+name+" is "+where)
+sys.exit(1 if missing else 0)
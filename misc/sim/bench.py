@@ -0,0 +1,193 @@
+#!/usr/bin/env python
+# (C) 2010 Project Blox <JesseTannahill@gmail.com>
+# Times misc/transfer.py against the base program built for Linux in misc/sim.
+#
+# Copyright (C) 2010 by Project Blox
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+import os
+import sys
+import signal
+import random
+import resource
+import struct
+import subprocess
+import tempfile
+import time
+
+here = os.path.dirname(os.path.abspath(__file__))
+
+class bench:
+	"""Runs blox_sim and times transfer.py commands against it, reading the simulator's counters before and after each."""
+	sim = os.path.join(here, 'blox_sim')
+	transfer = os.path.join(os.path.dirname(here), 'transfer.py')
+
+	def __init__(self, baud, image):
+		self.proc = subprocess.Popen([self.sim, '-b', str(baud), '-f', image],
+			stdout=subprocess.PIPE, universal_newlines=True)
+		line = self.proc.stdout.readline()
+		if not line.startswith('pty '):
+			raise Exception ("bench failed, blox_sim didn't start")
+		self.pty = line.split()[1]
+		self.rows = []
+
+	def stats(self):
+		# blox_sim answers SIGUSR1 once the base program is waiting for a command
+		self.proc.send_signal(signal.SIGUSR1)
+		while True:
+			line = self.proc.stdout.readline()
+			if not line:
+				raise Exception ("bench failed, blox_sim exited")
+			if line.startswith('stats '):
+				return dict((k, int(v)) for (k, v) in (f.split('=') for f in line.split()[1:]))
+
+	def run(self, label, flags, args, size=0):
+		before = self.stats()
+		start = time.time()
+		subprocess.check_call([sys.executable, self.transfer] + flags + [self.pty] + args,
+			stdout=subprocess.DEVNULL, cwd=os.path.dirname(self.transfer))
+		after = self.stats()
+		elapsed = time.time() - start
+		self.rows.append((label, elapsed, size, dict((k, after[k] - before[k]) for k in after)))
+
+	def report(self):
+		print("%-28s %8s %9s %7s %9s %7s %10s" % ("command", "seconds", "bytes/s", "trips",
+			"trips/pg", "erases", "halfwords"))
+		for (label, elapsed, size, d) in self.rows:
+			# Uploads count the app's bytes, everything else the bytes on the wire
+			rate = (size or d['rx'] + d['tx']) / elapsed
+			perPage = "%9.2f" % (d['roundtrips'] / ((size + 2047) // 2048)) if size else "%9s" % "-"
+			print("%-28s %8.2f %9.0f %7d %s %7d %10d" % (label, elapsed, rate, d['roundtrips'],
+				perPage, d['erases'], d['halfwords']))
+			if d['overruns']:
+				print("\t%d bytes overran the Blox" % d['overruns'])
+
+	def close(self):
+		self.proc.kill()
+		self.proc.wait()
+
+def app(path, pages, seed=0):
+	"""Writes an app image of about pages pages: a vector table, then words from a small vocabulary so it compresses like code."""
+	rnd = random.Random(pages + 1000*seed)
+	words = [rnd.getrandbits(32) for i in range(256)]
+	size = pages*2048 - 100
+	data = struct.pack("<LL", 0x2000C000, 0x08010801 + 0x400)
+	while len(data) < size:
+		data += struct.pack("<L", rnd.choice(words))
+	f = open(path, 'wb')
+	f.write(data[:size])
+	f.close()
+	return size
+
+def main(args):
+	baud = 115200
+	pages = 16
+	devices = 20
+	path = None
+	while args:
+		if args[0] == '--baud':
+			baud = int(args[1])
+		elif args[0] == '--pages':
+			pages = int(args[1])
+		elif args[0] == '--app':
+			path = args[1]
+		elif args[0] == '--devices':
+			devices = int(args[1])
+		else:
+			help()
+			return
+		args = args[2:]
+
+	tmp = tempfile.mkdtemp()
+	if path is None:
+		path = os.path.join(tmp, 'bench.bin')
+		size = app(path, pages)
+	else:
+		size = os.path.getsize(path)
+	other = os.path.join(tmp, 'other.bin')
+	otherSize = app(other, pages, 1)
+	b = bench(baud, os.path.join(tmp, 'flash.bin'))
+	try:
+		b.run("RCV_APP stop-and-wait", ['--stop-wait'], ['RCV_APP', path], size)
+		b.run("LST_APPS", [], ['LST_APPS'])
+		b.run("DEL_APP", [], ['DEL_APP', '0'])
+		b.run("RCV_APP streamed, raw", ['--no-resume', '--no-compress'], ['RCV_APP', path], size)
+		b.run("DEL_APP", [], ['DEL_APP', '0'])
+		b.run("RCV_APP streamed, packed", ['--no-resume'], ['RCV_APP', path], size)
+		b.run("RCV_APP resumed, same image", [], ['RCV_APP', path], size)
+		b.run("SYNC_APPS, 1 of 2 stored", [], ['SYNC_APPS', path, other], otherSize)
+		b.run("SYNC_APPS, 2 of 2 stored", [], ['SYNC_APPS', path, other])
+		b.run("RUN_APP", [], ['RUN_APP', '0'])
+		b.run("DEL_APP", [], ['DEL_APP', '0'])
+	finally:
+		b.close()
+	(one, oneCpu) = fleet(baud, tmp, 1, [path, other])
+	(many, manyCpu) = fleet(baud, tmp, devices, [path, other]) if devices > 1 else (one, oneCpu)
+	print("%d byte app, %s" % (size, ("%d baud" % baud) if baud else "unpaced link"))
+	b.report()
+	raw = [r[1] for r in b.rows if r[0] == "RCV_APP streamed, raw"][0]
+	packed = [r[1] for r in b.rows if r[0] == "RCV_APP streamed, packed"][0]
+	print("packing chunks took the streamed upload from %.2fs to %.2fs (%.2fx)" % (raw, packed, raw / packed))
+	print("SYNC_APPS of both apps took %.2fs on 1 Blox, %.2fs on %d at once (%.0f bytes/s in all)"
+		% (one, many, devices, devices*(size + otherSize) / many))
+	print("transfer.py used %.2fs of CPU for 1 Blox, %.2fs for %d; the rest is %d simulators pacing their links on %d CPU(s)"
+		% (oneCpu, manyCpu, devices, devices, os.cpu_count()))
+
+def fleet(baud, tmp, devices, apps):
+	"""Syncs apps onto devices Blox with fresh flash, all at once, and returns the seconds it took and the CPU seconds transfer.py used."""
+	sims = []
+	try:
+		for i in range(devices):
+			sims.append(bench(baud, os.path.join(tmp, 'fleet%d-%d.bin' % (devices, i))))
+		start = time.time()
+		before = resource.getrusage(resource.RUSAGE_CHILDREN)
+		subprocess.check_call([sys.executable, bench.transfer, ','.join(b.pty for b in sims), 'SYNC_APPS']
+			+ apps, stdout=subprocess.DEVNULL, cwd=os.path.dirname(bench.transfer))
+		after = resource.getrusage(resource.RUSAGE_CHILDREN)
+		return (time.time() - start, after.ru_utime - before.ru_utime + after.ru_stime - before.ru_stime)
+	finally:
+		for b in sims:
+			b.close()
+
+def help():
+	"""\
+	Usage: bench.py [--baud N] [--pages N] [--app FILE] [--devices N]
+
+	Builds nothing: run make in misc/sim first. Starts blox_sim on fresh
+	flash, uploads, lists, runs and deletes an app of N pages (16 by
+	default) with misc/transfer.py, syncs it and a second app as a
+	manifest, and reports for each command the time taken, bytes per
+	second, round trips (times the host waited on the Blox's answer before
+	sending more), and the pages erased and halfwords programmed. The link
+	is paced at N baud, 115200 by default, with the flash taking as long as
+	the datasheet says; --baud 0 runs it flat out. The streamed upload is
+	timed with and without packed chunks. --app uploads a real BIN instead
+	of the generated image. Last, both apps are synced onto one fresh Blox,
+	then onto N at once (20 by default) through a single transfer.py.
+
+	Examples:
+	bench.py
+	bench.py --pages 40
+	bench.py --baud 0
+	bench.py --devices 4
+	bench.py --app ../../applications/countdown/countdown.bin"""
+	print(help.__doc__)
+
+main(sys.argv[1:])
@@ -0,0 +1,67 @@
+/**
+ * @file    sim.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Builds the base program's transfer path for Linux, with flash in a
+ *          mapped file and USART1 on a pseudo-terminal, so misc/transfer.py can be
+ *          run and timed against it without a Blox. See bench.py.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __SIM_H
+#define __SIM_H
+
+#include <stdint.h>
+
+/**
+ * @ingroup base_sim
+ * @{
+ */
+#define SIM_FLASH_SIZE  0x80000       /**< The STM32F103VE's 512K of flash */
+#define SIM_SRAM_START  0x20000000
+#define SIM_SRAM_SIZE   0x10000       /**< Enough SRAM for the app flag and address */
+#define SIM_ERASE_NS    20000000      /**< Page erase time, from the datasheet */
+#define SIM_PROGRAM_NS  52500         /**< Halfword program time, from the datasheet */
+#define SIM_BAUD        115200        /**< USART1's rate, 8 data bits, even parity */
+#define SIM_BITS        11            /**< Bits on the wire per byte */
+#define SIM_RX_QUEUE    8192          /**< Bytes the host may send before USART1 drops them */
+
+/**
+ * @brief What the simulated USART1 has seen since the simulator started.
+ */
+typedef struct {
+  uint32_t rxBytes;       /**< Bytes from the host */
+  uint32_t txBytes;       /**< Bytes to the host */
+  uint32_t roundTrips;    /**< Times the host waited on an answer before sending more */
+  uint32_t overruns;      /**< Bytes dropped because nothing was reading them */
+} SimLinkStats;
+
+void Sim_Flash_Init(const char *image);
+uint64_t Sim_Flash_GetBusyNs(void);
+void Sim_Link_Init(uint32_t baud);
+void Sim_Link_GetStats(SimLinkStats *stats);
+void Sim_Link_RequestStats(void);
+void Sim_Spend(uint64_t ns);
+void Sim_PrintStats(void);
+/** @} */
+#endif
@@ -0,0 +1,296 @@
+/**
+ * @file    sim_flash.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   The flash driver for the simulator. Flash is a file mapped at the
+ *          address the STM32F103VE has it, so the filesystem reads it in place.
+ *          Erases and programs follow the hardware's rules and take its time.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sim.h"
+#include "blox_flash.h"
+
+/**
+ * @ingroup base_sim
+ * @{
+ */
+
+static uint8_t locked = TRUE;
+static FLASH_Stats stats;
+static uint16_t wear[FLASH_NUM_PAGES];
+static uint64_t busyNs;
+
+/**
+ * @brief Maps the flash at MEM_MAP_START. A new image starts erased.
+ * @param image the file holding the flash, NULL for flash that is gone on exit
+ * @retval None
+ */
+void Sim_Flash_Init(const char *image) {
+  struct stat st;
+  void *flash;
+  int fd = -1, blank = TRUE;
+
+  if (image != NULL) {
+    fd = open(image, O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      perror(image);
+      exit(1);
+    }
+    blank = st.st_size == 0;
+    if (ftruncate(fd, SIM_FLASH_SIZE) != 0) {
+      perror(image);
+      exit(1);
+    }
+    flash = mmap((void *)MEM_MAP_START, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_FIXED | MAP_SHARED, fd, 0);
+  } else {
+    flash = mmap((void *)MEM_MAP_START, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  if (flash == MAP_FAILED) {
+    perror("sim flash");
+    exit(1);
+  }
+  if (blank)
+    memset(flash, 0xFF, SIM_FLASH_SIZE);
+}
+
+/**
+ * @brief Returns how long the flash has spent erasing and programming.
+ * @retval the time in ns
+ */
+uint64_t Sim_Flash_GetBusyNs(void) {
+  return busyNs;
+}
+
+/**
+ * @brief Unlocks the flash controller for erasing and programming.
+ * @retval None
+ */
+void Blox_Flash_Unlock(void) {
+  locked = FALSE;
+}
+
+/**
+ * @brief Locks the flash controller.
+ * @retval None
+ */
+void Blox_Flash_Lock(void) {
+  locked = TRUE;
+}
+
+/**
+ * @brief Erases a page of flash. Reports erasing while locked, which the
+ *        hardware silently ignores.
+ * @param addr the address of the start of the page
+ * @retval FLASH_COMPLETE if successful, FLASH_ERROR_WRP if locked.
+ */
+FLASH_Status Blox_Flash_ErasePage(uint32_t addr) {
+  if (locked) {
+    fprintf(stderr, "sim: erase of 0x%08x while the flash is locked\n", addr);
+    return FLASH_ERROR_WRP;
+  }
+  addr -= addr % PAGE_SIZE;
+  memset((void *)(uintptr_t)addr, 0xFF, PAGE_SIZE);
+  stats.erases++;
+  if (wear[FLASH_PAGE(addr)] != 0xFFFF)
+    wear[FLASH_PAGE(addr)]++;
+  busyNs += SIM_ERASE_NS;
+  Sim_Spend(SIM_ERASE_NS);
+  return FLASH_COMPLETE;
+}
+
+/**
+ * @brief Programs a halfword of flash. Like the hardware, only an erased
+ *        halfword can be programmed, unless to zero.
+ * @param addr the halfword-aligned address to program
+ * @param data the value to program
+ * @retval FLASH_COMPLETE if successful, another FLASH_Status if not.
+ */
+FLASH_Status Blox_Flash_ProgramHalfWord(uint32_t addr, uint16_t data) {
+  uint16_t *dst = (uint16_t *)(uintptr_t)addr;
+  if (locked) {
+    fprintf(stderr, "sim: program of 0x%08x while the flash is locked\n", addr);
+    return FLASH_ERROR_WRP;
+  }
+  if ((addr & 1) || (*dst != FLASH_ERASED_HALF && data != 0)) {
+    fprintf(stderr, "sim: program of 0x%08x holding 0x%04x\n", addr, *dst);
+    return FLASH_ERROR_PG;
+  }
+  *dst = data;
+  stats.halfWords++;
+  busyNs += SIM_PROGRAM_NS;
+  Sim_Spend(SIM_PROGRAM_NS);
+  return FLASH_COMPLETE;
+}
+
+/**
+ * @brief Programs a word of flash as two halfwords.
+ * @param addr the word-aligned address to program
+ * @param data the value to program
+ * @retval FLASH_COMPLETE if successful, another FLASH_Status if not.
+ */
+FLASH_Status Blox_Flash_ProgramWord(uint32_t addr, uint32_t data) {
+  FLASH_Status status = Blox_Flash_ProgramHalfWord(addr, data & 0xFFFF);
+  if (status != FLASH_COMPLETE)
+    return status;
+  return Blox_Flash_ProgramHalfWord(addr + 2, data >> 16);
+}
+
+/**
+ * @brief Writes a page of data over a page of flash the way the flash
+ *        driver does: nothing if unchanged, no erase if every halfword that
+ *        changes is blank, and only the halfwords that differ programmed.
+ * @param addr the address of the start of the page
+ * @param data PAGE_SIZE bytes to store there
+ * @retval FLASH_COMPLETE if successful, another FLASH_Status if not.
+ */
+FLASH_Status Blox_Flash_WritePage(uint32_t addr, const uint32_t *data) {
+  const uint16_t *src = (const uint16_t *)data;
+  const uint16_t *dst = (const uint16_t *)(uintptr_t)addr;
+  FLASH_Status status;
+  uint8_t changed = FALSE, erase = FALSE;
+  uint32_t i;
+
+  for (i = 0; i < PAGE_SIZE/2; i++) {
+    if (dst[i] == src[i])
+      continue;
+    changed = TRUE;
+    if (dst[i] != FLASH_ERASED_HALF) {
+      erase = TRUE;
+      break;
+    }
+  }
+  if (!changed) {
+    stats.unchanged++;
+    return FLASH_COMPLETE;
+  }
+
+  if (erase) {
+    status = Blox_Flash_ErasePage(addr);
+    if (status != FLASH_COMPLETE)
+      return status;
+  } else {
+    stats.erasesAvoided++;
+  }
+  for (i = 0; i < PAGE_SIZE/2; i++) {
+    if (dst[i] == src[i])
+      continue;
+    status = Blox_Flash_ProgramHalfWord((uint32_t)(uintptr_t)&dst[i], src[i]);
+    if (status != FLASH_COMPLETE)
+      return status;
+  }
+  return FLASH_COMPLETE;
+}
+
+/**
+ * @brief Erases and programs finish before returning here.
+ * @retval FALSE
+ */
+uint8_t Blox_Flash_IsBusy(void) {
+  return FALSE;
+}
+
+/**
+ * @brief Returns how many pages have been erased since the simulator started.
+ * @retval the erase count
+ */
+uint32_t Blox_Flash_GetEraseCount(void) {
+  return stats.erases;
+}
+
+/**
+ * @brief Copies out the flash driver's counters.
+ * @param ret the struct to fill in
+ * @retval None
+ */
+void Blox_Flash_GetStats(FLASH_Stats *ret) {
+  memcpy(ret, &stats, sizeof(FLASH_Stats));
+}
+
+/**
+ * @brief Returns how many times a page has been erased.
+ * @param addr an address in the page
+ * @retval the erase count
+ */
+uint16_t Blox_Flash_GetPageErases(uint32_t addr) {
+  if (FLASH_PAGE(addr) >= FLASH_NUM_PAGES)
+    return 0;
+  return wear[FLASH_PAGE(addr)];
+}
+
+/**
+ * @brief Adds erases the driver didn't see to a page's count.
+ * @param addr an address in the page
+ * @param erases the erases to add
+ * @retval None
+ */
+void Blox_Flash_AddPageErases(uint32_t addr, uint16_t erases) {
+  uint32_t count;
+  if (FLASH_PAGE(addr) >= FLASH_NUM_PAGES)
+    return;
+  count = wear[FLASH_PAGE(addr)] + erases;
+  wear[FLASH_PAGE(addr)] = count > 0xFFFF ? 0xFFFF : count;
+}
+
+/**
+ * @brief Sums up the erase counts of a range of pages.
+ * @param addr the address of the first page
+ * @param numPages the number of pages
+ * @param ret the struct to fill in
+ * @retval None
+ */
+void Blox_Flash_GetWear(uint32_t addr, uint32_t numPages, FLASH_Wear *ret) {
+  uint32_t i;
+  uint16_t erases;
+  ret->total = 0;
+  ret->min = 0xFFFF;
+  ret->max = 0;
+  ret->hottest = addr;
+  for (i = 0; i < numPages; i++) {
+    erases = Blox_Flash_GetPageErases(addr + i*PAGE_SIZE);
+    ret->total += erases;
+    if (erases < ret->min)
+      ret->min = erases;
+    if (erases > ret->max) {
+      ret->max = erases;
+      ret->hottest = addr + i*PAGE_SIZE;
+    }
+  }
+}
+
+/**
+ * @brief Nothing interrupts the simulator, so deferred work runs at once.
+ * @param fn the function to call
+ * @retval None
+ */
+void Blox_Flash_Defer(ptrVoidFn fn) {
+  fn();
+}
+/** @} */
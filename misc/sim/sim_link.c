@@ -0,0 +1,402 @@
+/**
+ * @file    sim_link.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   USART1 and its receive DMA for the simulator, on a pseudo-terminal
+ *          that misc/transfer.py opens as the Blox's serial port. Bytes are paced
+ *          at the line rate in both directions.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim.h"
+#include "blox_usb.h"
+
+/**
+ * @ingroup base_sim
+ * @{
+ */
+
+/* Private function prototypes */
+void *Link_Reader(void *arg);
+void Link_Deliver(uint8_t data);
+uint64_t Link_Now(void);
+void Link_SleepUntil(uint64_t ns);
+
+USART_TypeDef Sim_USART1;
+DMA_Channel_TypeDef Sim_DMA1_Channel5;
+
+static int master = -1, slave = -1;
+static uint64_t byteNs;
+
+/**
+ * @brief Bytes read from the host but not yet due, by the line rate, to
+ *        have arrived, and when each is due. A byte is due byteNs after
+ *        the one before it.
+ */
+static uint8_t pending[SIM_RX_QUEUE];
+static uint64_t pendingDue[SIM_RX_QUEUE];
+static uint32_t pendHead, pendTail;
+
+/**
+ * @brief Bytes that have arrived and are waiting for USART_ReceiveData.
+ */
+static uint8_t rxQueue[SIM_RX_QUEUE];
+static uint32_t rxHead, rxTail;
+static uint8_t rxWaiting;
+
+/**
+ * @brief The receive DMA: where it writes and whether USART1 requests it.
+ */
+static uint8_t *dmaRing;
+static uint16_t dmaLen;
+static volatile uint16_t dmaPos;
+static uint8_t dmaOn, dmaRx;
+
+static uint64_t txDue;
+static uint8_t answered;
+static volatile uint8_t statsWanted;
+static SimLinkStats stats;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t arrived = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Opens the pseudo-terminal and prints the name of its slave end.
+ * @param baud the line rate to pace bytes at, 0 for as fast as they come
+ * @retval None
+ */
+void Sim_Link_Init(uint32_t baud) {
+  pthread_t reader;
+  struct termios raw;
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("sim pty");
+    exit(1);
+  }
+  /* Hold the slave open so the master doesn't hang up between hosts */
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  tcgetattr(slave, &raw);
+  cfmakeraw(&raw);
+  tcsetattr(slave, TCSANOW, &raw);
+  byteNs = baud ? 1000000000ull*SIM_BITS/baud : 0;
+  printf("pty %s\n", ptsname(master));
+  fflush(stdout);
+  pthread_create(&reader, NULL, Link_Reader, NULL);
+}
+
+/**
+ * @brief Copies out the link's counters.
+ * @param ret the struct to fill in
+ * @retval None
+ */
+void Sim_Link_GetStats(SimLinkStats *ret) {
+  pthread_mutex_lock(&lock);
+  *ret = stats;
+  pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Asks for the counters to be printed once the base program is
+ *        waiting for a command with nothing left to read. Safe to call
+ *        from a signal handler.
+ * @retval None
+ */
+void Sim_Link_RequestStats(void) {
+  statsWanted = TRUE;
+}
+
+/**
+ * @brief Takes bytes from the host and hands them to USART1 or its DMA when
+ *        they are due. A round trip is counted when the host sends again
+ *        after the Blox answered while the line from the host was idle.
+ * @param arg unused
+ * @retval None
+ */
+void *Link_Reader(void *arg) {
+  struct pollfd pfd;
+  struct timespec wait;
+  uint8_t buf[256];
+  uint64_t now, due = 0, next;
+  uint32_t space;
+  int i, n;
+  (void)arg;
+  pfd.fd = master;
+  while (1) {
+    /* Wake for the next byte due, or every 10ms to check for a stats request */
+    now = Link_Now();
+    next = now + 10000000;
+    if (pendHead != pendTail && pendingDue[pendHead] < next)
+      next = pendingDue[pendHead] > now ? pendingDue[pendHead] : now;
+    wait.tv_sec = (next - now) / 1000000000ull;
+    wait.tv_nsec = (next - now) % 1000000000ull;
+    space = (pendHead - pendTail - 1 + SIM_RX_QUEUE) % SIM_RX_QUEUE;
+    pfd.events = space ? POLLIN : 0;
+    n = ppoll(&pfd, 1, &wait, NULL);
+
+    pthread_mutex_lock(&lock);
+    now = Link_Now();
+    if (n > 0 && (pfd.revents & POLLIN)) {
+      n = read(master, buf, space < sizeof(buf) ? space : sizeof(buf));
+      if (n > 0 && answered) {
+        stats.roundTrips++;
+        answered = FALSE;
+      }
+      for (i = 0; i < n; i++) {
+        due = (due > now ? due : now) + byteNs;
+        pending[pendTail] = buf[i];
+        pendingDue[pendTail] = due;
+        pendTail = (pendTail + 1) % SIM_RX_QUEUE;
+      }
+    }
+    while (pendHead != pendTail && pendingDue[pendHead] <= now) {
+      Link_Deliver(pending[pendHead]);
+      pendHead = (pendHead + 1) % SIM_RX_QUEUE;
+    }
+    pthread_cond_broadcast(&arrived);
+    if (statsWanted && rxWaiting && pendHead == pendTail) {
+      statsWanted = FALSE;
+      pthread_mutex_unlock(&lock);
+      Sim_PrintStats();
+      continue;
+    }
+    pthread_mutex_unlock(&lock);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Puts a byte that has arrived where the base program reads it.
+ *        Called with the lock held.
+ * @param data the byte
+ * @retval None
+ */
+void Link_Deliver(uint8_t data) {
+  stats.rxBytes++;
+  if (dmaOn && dmaRx) {
+    dmaRing[dmaPos] = data;
+    __sync_synchronize();
+    dmaPos = (dmaPos + 1) % dmaLen;
+    return;
+  }
+  if ((rxTail + 1) % SIM_RX_QUEUE == rxHead) {
+    stats.overruns++;
+    return;
+  }
+  rxQueue[rxTail] = data;
+  rxTail = (rxTail + 1) % SIM_RX_QUEUE;
+}
+
+/**
+ * @brief Returns the time on a monotonic clock.
+ * @retval the time in ns
+ */
+uint64_t Link_Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief Sleeps until a time on the monotonic clock.
+ * @param ns the time in ns
+ * @retval None
+ */
+void Link_SleepUntil(uint64_t ns) {
+  struct timespec ts;
+  ts.tv_sec = ns / 1000000000ull;
+  ts.tv_nsec = ns % 1000000000ull;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) ;
+}
+
+/**
+ * @brief Takes up time the hardware would, when the link is paced. Short
+ *        spans are added up and slept off together.
+ * @param ns the time in ns
+ * @retval None
+ */
+void Sim_Spend(uint64_t ns) {
+  static uint64_t owed;
+  if (byteNs == 0)
+    return;
+  owed += ns;
+  if (owed < 1000000)
+    return;
+  Link_SleepUntil(Link_Now() + owed);
+  owed = 0;
+}
+
+/**
+ * @brief There is only USART1, and the pseudo-terminal is already open.
+ * @param id the USART id
+ * @retval None
+ */
+void Blox_USART_Init(uint8_t id) {
+  (void)id;
+}
+
+/**
+ * @brief Blocking receive of a byte on USART1.
+ * @param id the USART id, only 1 is simulated
+ * @retval The received byte.
+ */
+uint8_t Blox_USART_Receive(uint8_t id) {
+  uint8_t data;
+  (void)id;
+  pthread_mutex_lock(&lock);
+  while (rxHead == rxTail) {
+    rxWaiting = TRUE;
+    pthread_cond_wait(&arrived, &lock);
+  }
+  rxWaiting = FALSE;
+  data = rxQueue[rxHead];
+  rxHead = (rxHead + 1) % SIM_RX_QUEUE;
+  pthread_mutex_unlock(&lock);
+  return data;
+}
+
+/**
+ * @brief Non-blocking receive of a byte on USART1.
+ * @param id the USART id, only 1 is simulated
+ * @retval The received byte or -1 if there is none.
+ */
+int16_t Blox_USART_TryReceive(uint8_t id) {
+  int16_t data = -1;
+  (void)id;
+  pthread_mutex_lock(&lock);
+  if (rxHead != rxTail) {
+    data = rxQueue[rxHead];
+    rxHead = (rxHead + 1) % SIM_RX_QUEUE;
+  }
+  pthread_mutex_unlock(&lock);
+  return data;
+}
+
+/**
+ * @brief Sends a byte on USART1 once the one before it is out.
+ * @param id the USART id, only 1 is simulated
+ * @param data the byte to send
+ * @retval None
+ */
+void Blox_USART_Send(uint8_t id, uint8_t data) {
+  struct pollfd pfd;
+  (void)id;
+  if (byteNs && txDue > Link_Now())
+    Link_SleepUntil(txDue);
+  txDue = Link_Now() + byteNs;
+  pfd.fd = master;
+  pfd.events = POLLIN;
+  pthread_mutex_lock(&lock);
+  if (pendHead == pendTail && poll(&pfd, 1, 0) == 0)
+    answered = TRUE;
+  stats.txBytes++;
+  pthread_mutex_unlock(&lock);
+  if (write(master, &data, 1) != 1)
+    perror("sim pty");
+}
+
+/**
+ * @brief Clocks need no enabling in the simulator.
+ * @param periph the peripherals
+ * @param state ENABLE or DISABLE
+ * @retval None
+ */
+void RCC_AHBPeriphClockCmd(uint32_t periph, FunctionalState state) {
+  (void)periph;
+  (void)state;
+}
+
+/**
+ * @brief Stops the receive DMA.
+ * @param channel the channel, only USART1's receive is simulated
+ * @retval None
+ */
+void DMA_DeInit(DMA_Channel_TypeDef *channel) {
+  (void)channel;
+  pthread_mutex_lock(&lock);
+  dmaOn = FALSE;
+  pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Sets up the receive DMA's ring. Only circular peripheral to
+ *        memory transfers are simulated.
+ * @param channel the channel, only USART1's receive is simulated
+ * @param init the setup
+ * @retval None
+ */
+void DMA_Init(DMA_Channel_TypeDef *channel, DMA_InitTypeDef *init) {
+  (void)channel;
+  pthread_mutex_lock(&lock);
+  dmaRing = (uint8_t *)(uintptr_t)init->DMA_MemoryBaseAddr;
+  dmaLen = init->DMA_BufferSize;
+  dmaPos = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Starts or stops the receive DMA.
+ * @param channel the channel, only USART1's receive is simulated
+ * @param state ENABLE or DISABLE
+ * @retval None
+ */
+void DMA_Cmd(DMA_Channel_TypeDef *channel, FunctionalState state) {
+  (void)channel;
+  pthread_mutex_lock(&lock);
+  dmaOn = state;
+  pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Returns how many bytes the receive DMA has left before it wraps.
+ * @param channel the channel, only USART1's receive is simulated
+ * @retval the count, from the ring's length down to 1
+ */
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef *channel) {
+  uint16_t pos = dmaPos;
+  (void)channel;
+  __sync_synchronize();
+  return dmaLen - pos;
+}
+
+/**
+ * @brief Routes received bytes to the DMA instead of the data register.
+ * @param usart the USART, only USART1 is simulated
+ * @param req the request, only USART_DMAReq_Rx is simulated
+ * @param state ENABLE or DISABLE
+ * @retval None
+ */
+void USART_DMACmd(USART_TypeDef *usart, uint16_t req, FunctionalState state) {
+  (void)usart;
+  pthread_mutex_lock(&lock);
+  if (req & USART_DMAReq_Rx)
+    dmaRx = state;
+  pthread_mutex_unlock(&lock);
+}
+/** @} */
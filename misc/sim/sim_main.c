@@ -0,0 +1,127 @@
+/**
+ * @file    sim_main.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Runs the base program's transfer loop on Linux. Prints the
+ *          pseudo-terminal standing in for USART1, and the simulator's counters
+ *          when sent SIGUSR1.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "sim.h"
+#include "blox_transfer.h"
+
+/**
+ * @ingroup base_sim
+ * @{
+ */
+
+/* Private function prototypes */
+void Sim_OnSignal(int sig);
+
+static jmp_buf boot;
+
+/**
+ * @brief Starts the transfer loop over the simulated flash and USART1.
+ *        Usage: blox_sim [-b baud] [-f flash.bin], with -b 0 for an
+ *        unpaced link and the flash lost on exit without -f.
+ * @retval Doesn't return.
+ */
+int main(int argc, char **argv) {
+  const char *image = NULL;
+  uint32_t baud = SIM_BAUD;
+  void *sram;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:f:")) != -1) {
+    if (opt == 'b')
+      baud = strtoul(optarg, NULL, 0);
+    else if (opt == 'f')
+      image = optarg;
+    else {
+      fprintf(stderr, "usage: %s [-b baud] [-f flash.bin]\n", argv[0]);
+      return 1;
+    }
+  }
+  sram = mmap((void *)SIM_SRAM_START, SIM_SRAM_SIZE, PROT_READ | PROT_WRITE,
+              MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (sram == MAP_FAILED) {
+    perror("sim sram");
+    return 1;
+  }
+  Sim_Flash_Init(image);
+  signal(SIGUSR1, Sim_OnSignal);
+  Sim_Link_Init(baud);
+
+  /* FS_RunFile resets into the app; report it and carry on as the base program */
+  if (setjmp(boot) && FS_GetAppFlag() == 1) {
+    printf("run 0x%08x entry 0x%08x\n", *(uint32_t *)FS_APP_ADDR_LOC,
+           *(uint32_t *)(uintptr_t)(*(uint32_t *)FS_APP_ADDR_LOC + 4));
+    fflush(stdout);
+    FS_SetAppFlag(0);
+  }
+  Blox_KV_Init();
+  Transfer_Init();
+  Transfer_Slave();
+  return 0;
+}
+
+/**
+ * @brief Resets the Blox, which in the simulator restarts the transfer loop.
+ * @retval Doesn't return.
+ */
+void Sim_Reset(void) {
+  longjmp(boot, 1);
+}
+
+/**
+ * @brief Asks for the counters on SIGUSR1.
+ * @param sig the signal
+ * @retval None
+ */
+void Sim_OnSignal(int sig) {
+  (void)sig;
+  Sim_Link_RequestStats();
+}
+
+/**
+ * @brief Prints the counters on one line, for bench.py to read.
+ * @retval None
+ */
+void Sim_PrintStats(void) {
+  SimLinkStats link;
+  FLASH_Stats flash;
+  Sim_Link_GetStats(&link);
+  Blox_Flash_GetStats(&flash);
+  printf("stats rx=%u tx=%u roundtrips=%u overruns=%u erases=%u halfwords=%u "
+         "unchanged=%u avoided=%u flash_ms=%u\n", link.rxBytes, link.txBytes,
+         link.roundTrips, link.overruns, flash.erases, flash.halfWords,
+         flash.unchanged, flash.erasesAvoided, (uint32_t)(Sim_Flash_GetBusyNs()/1000000));
+  fflush(stdout);
+}
+/** @} */
@@ -0,0 +1,99 @@
+/**
+ * @file    sim_system.c
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   The CRC and memory drivers for the simulator, which have no
+ *          hardware to use.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "sim.h"
+#include "blox_crc.h"
+#include "blox_mem.h"
+
+/**
+ * @ingroup base_sim
+ * @{
+ */
+
+/**
+ * @brief There is no CRC peripheral to start.
+ * @retval None
+ */
+void Blox_CRC_Init(void) {
+}
+
+/**
+ * @brief Computes the CRC the CRC peripheral would: CRC-32 over words, MSB
+ *        first, starting from 0xFFFFFFFF with no final XOR.
+ * @param data the words
+ * @param words the number of words
+ * @retval the CRC
+ */
+uint32_t Blox_CRC_Software(const uint32_t *data, uint32_t words) {
+  uint32_t crc = 0xFFFFFFFF;
+  uint32_t i, j;
+  for (i = 0; i < words; i++) {
+    crc ^= data[i];
+    for (j = 0; j < 32; j++)
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+  }
+  return crc;
+}
+
+/**
+ * @brief Computes a CRC as the CRC peripheral would.
+ * @param data the words
+ * @param words the number of words
+ * @retval the CRC
+ */
+uint32_t Blox_CRC_Calc(const uint32_t *data, uint32_t words) {
+  return Blox_CRC_Software(data, words);
+}
+
+/**
+ * @brief The host's heap isn't the Blox's, so there is nothing to track.
+ * @retval None
+ */
+void Blox_Mem_Init(void) {
+}
+
+/**
+ * @brief The host's heap isn't the Blox's, so its stats are all zero.
+ * @param stats the struct to fill in
+ * @retval None
+ */
+void Blox_Mem_GetHeapStats(MemHeapStats *stats) {
+  memset(stats, 0, sizeof(MemHeapStats));
+}
+
+/**
+ * @brief The host's stack isn't the Blox's, so its stats are all zero.
+ * @param stats the struct to fill in
+ * @retval None
+ */
+void Blox_Mem_GetStackStats(MemStackStats *stats) {
+  memset(stats, 0, sizeof(MemStackStats));
+}
+/** @} */
@@ -0,0 +1,117 @@
+/**
+ * @file    stm32f10x.h
+ * @author  Project Blox
+ * @version V0.1
+ * @date    10/19/2026
+ * @brief   Stands in for the device header when the base program is built
+ *          for Linux by the simulator. Declares only what the simulated drivers use.
+ *
+ * Copyright (C) 2010 by Project Blox
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* blox_system.h defines its own */
+#undef NULL
+
+/**
+ * @ingroup base_sim
+ * @{
+ */
+#define __IO volatile
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef int IRQn_Type;
+
+typedef enum {
+  FLASH_BUSY = 1,
+  FLASH_ERROR_PG,
+  FLASH_ERROR_WRP,
+  FLASH_COMPLETE,
+  FLASH_TIMEOUT
+} FLASH_Status;
+
+/**
+ * @brief USART1, of which only the data register's address is taken.
+ */
+typedef struct {
+  __IO uint16_t SR;
+  uint16_t RESERVED0;
+  __IO uint16_t DR;
+  uint16_t RESERVED1;
+} USART_TypeDef;
+
+/**
+ * @brief A DMA channel, set up through the functions below.
+ */
+typedef struct {
+  uint32_t CCR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+  uint32_t DMA_PeripheralBaseAddr;
+  uint32_t DMA_MemoryBaseAddr;
+  uint32_t DMA_DIR;
+  uint32_t DMA_BufferSize;
+  uint32_t DMA_PeripheralInc;
+  uint32_t DMA_MemoryInc;
+  uint32_t DMA_PeripheralDataSize;
+  uint32_t DMA_MemoryDataSize;
+  uint32_t DMA_Mode;
+  uint32_t DMA_Priority;
+  uint32_t DMA_M2M;
+} DMA_InitTypeDef;
+
+extern USART_TypeDef Sim_USART1;
+extern DMA_Channel_TypeDef Sim_DMA1_Channel5;
+#define USART1 (&Sim_USART1)
+#define DMA1_Channel5 (&Sim_DMA1_Channel5)
+
+#define RCC_AHBPeriph_DMA1 0x01
+#define DMA_DIR_PeripheralSRC 0x00
+#define DMA_PeripheralInc_Disable 0x00
+#define DMA_MemoryInc_Enable 0x80
+#define DMA_PeripheralDataSize_Byte 0x00
+#define DMA_MemoryDataSize_Byte 0x00
+#define DMA_Mode_Circular 0x20
+#define DMA_Priority_VeryHigh 0x3000
+#define DMA_M2M_Disable 0x00
+#define USART_DMAReq_Rx 0x40
+
+void RCC_AHBPeriphClockCmd(uint32_t periph, FunctionalState state);
+void DMA_DeInit(DMA_Channel_TypeDef *channel);
+void DMA_Init(DMA_Channel_TypeDef *channel, DMA_InitTypeDef *init);
+void DMA_Cmd(DMA_Channel_TypeDef *channel, FunctionalState state);
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef *channel);
+void USART_DMACmd(USART_TypeDef *usart, uint16_t req, FunctionalState state);
+
+void Sim_Reset(void) __attribute__((noreturn));
+#define NVIC_SystemReset() Sim_Reset()
+#define NVIC_SetVectorTable(table, offset)
+#define NVIC_VectTab_FLASH 0x08000000
+#define __set_MSP(top)
+/** @} */
+#endif
@@ -26,23 +26,82 @@ import serial
 import os
 import sys
 import struct
+import time
+import threading
+import io
+import lzss
+import crc
 
 class transfer:
 	"""A class that interacts with a Blox running the base program to exchange programs and other information."""
 	ACK = 0x79
 	NAK = 0x1F
+	# Streamed uploads, see Transfer_RcvStream in blox_transfer.c
+	SYNC = 0xA5
+	CHUNK = 256
+	WINDOW = 8
+	DONE = 0xFFFF
+	RESEND = 0.5
+	PACKED = 0x8000
+	MANIFEST_MAX = 16
 
 	opcodes = {
 		'RCV_APP' : 0x1,
 		'DEL_APP' : 0x2,
 		'LST_APPS': 0x3,
-		'RUN_APP' : 0x4
+		'RUN_APP' : 0x4,
+		'MEM_STATS': 0x5,
+		'RCV_APP_AT': 0x6,
+		'RCV_APP_LZ': 0x7,
+		'WEAR_STATS': 0x8,
+		'RCV_STREAM': 0x9,
+		'RESUME': 0xA,
+		'SYNC_APPS': 0xB
 	}
+	streamed = ('RCV_APP', 'RCV_APP_AT', 'RCV_APP_LZ')
+
+	# Images read, checksummed and chunked once and shared by every port.
+	# reads maps an app's path and modification time to its BIN's name and
+	# data, images maps that data to its CRCs and chunks.
+	reads = {}
+	images = {}
+	imagesLock = threading.Lock()
             
 	def processCmd(self, args):
 		opcode = args[0]
+		if opcode == 'BENCH_RCV':
+			self.benchRcvApp(args[1:])
+			return
 		if opcode not in self.opcodes:
 			raise Exception ("Invalid opcode: " + str(opcode));
+		# Uploads are streamed unless asked to wait for each page, and carry
+		# on from an earlier upload of the same image unless asked not to
+		if opcode in self.streamed and self.stream:
+			self.sendOpcode('RESUME' if self.resume else 'RCV_STREAM')
+			self.sendOpcode(opcode)
+		else:
+			self.sendOpcode(opcode)
+
+		if opcode == 'RCV_APP':
+			self.sendRcvApp(args[1:])
+		elif opcode == 'RCV_APP_AT':
+			self.sendRcvApp(args[1:], True)
+		elif opcode == 'RCV_APP_LZ':
+			self.sendRcvApp(args[1:], False, True)
+		elif opcode == 'DEL_APP':
+			self.sendDelApp(args[1:])
+		elif opcode == 'LST_APPS':
+			self.sendLstApps(args[1:])
+		elif opcode == 'MEM_STATS':
+			self.sendMemStats(args[1:])
+		elif opcode == 'WEAR_STATS':
+			self.sendWearStats(args[1:])
+		elif opcode == 'SYNC_APPS':
+			self.sendSyncApps(args[1:])
+		else:
+			self.sendRunApp(args[1:])
+
+	def sendOpcode(self, opcode):
 		#Send opcode + checksum
 		print("Sending opcode ("+opcode+","+str(self.opcodes[opcode])+")...", end='')
 		sys.stdout.flush()
@@ -57,27 +116,45 @@ class transfer:
 			raise Exception ("processCmd failed, opcode "+opcode+" return malform ACK: "+ret.decode('utf-8'))
 		print("ACKed")		
 
-		if opcode == 'RCV_APP':
-			self.sendRcvApp(args[1:])
-		elif opcode == 'DEL_APP':
-			self.sendDelApp(args[1:])
-		elif opcode == 'LST_APPS':
-			self.sendLstApps(args[1:])
-		else:
-			self.sendRunApp(args[1:])
+	def hexBase(self, filename):
+		"""Returns the address of the first data record in an Intel HEX file."""
+		upper = 0
+		for line in open(filename):
+			line = line.strip()
+			if not line.startswith(':'):
+				continue
+			addr = int(line[3:7], 16)
+			rectype = int(line[7:9], 16)
+			if rectype == 0x04:
+				upper = int(line[9:13], 16) << 16
+			elif rectype == 0x00:
+				return upper + addr
+		raise Exception ("hexBase failed, no data in "+filename)
 
-	def sendRcvApp(self, args):
-		# Convert to a BIN if its a HEX
-		if args[0][-3:] == "hex":
-			os.system("hex2bin "+args[0])
-			args[0] = args[0][0:-3] + "bin"
-		f = open(args[0], 'rb')
-		size = os.path.getsize(args[0])
+	def sendRcvApp(self, args, placed=False, compressed=False, name=None):
+		"""Uploads an app, returning the seconds its data took to send and store."""
+		# Apps linked to run in place are stored at their link address, given
+		# after the file name or read from the HEX file
+		if placed:
+			if len(args) > 1:
+				base = int(args[1], 0)
+			elif args[0][-3:] == "hex":
+				base = self.hexBase(args[0])
+			else:
+				raise Exception ("sendRcvApp failed, RCV_APP_AT needs a HEX file or an address")
+		(args[0], data) = self.readImage(args[0])
+		if compressed:
+			raw = len(data)
+			data = lzss.image(data)
+			print("\tRcvApp compressed "+str(raw)+" -> "+str(len(data))+" bytes, "
+				+str(lzss.pages(raw))+" -> "+str(lzss.pages(len(data)))+" pages")
+		size = len(data)
 		# Strip the file type if there is one
 		if args[0].rfind(".") != -1:
 			args[0] = args[0][0:args[0].rfind(".")]
 		# Send length of file name
-		name = os.path.basename(args[0])
+		if name is None:
+			name = os.path.basename(args[0])
 		if len(name) > 31:
 			name = name[0:31]
 		print("\tRcvApp sending name len ("+name+","+str(len(name))+")...", end='')
@@ -116,7 +193,7 @@ class transfer:
 		numPages = int(size/2048)
 		if (size % 2048) > 0:
 			numPages += 1
-		sizeArray = struct.pack("L", size)
+		sizeArray = struct.pack("<L", size)
 		checksum[0] = (checksum[0] + sizeArray[0]) % 0x100
 		checksum[0] = (checksum[0] + sizeArray[1]) % 0x100
 		checksum[0] = (checksum[0] + sizeArray[2]) % 0x100
@@ -135,21 +212,118 @@ class transfer:
 			raise Exception ("sendRcvApp failed, opcode RCV_APP return malform ACK: "+ret.decode('utf-8'))
 		print("ACKed")
 
-		# Send each page 1 at a time
+		# Send the link address
+		if placed:
+			baseArray = struct.pack("<L", base)
+			checksum[0] = 0xFF - (sum(baseArray) % 0x100)
+			print("\tRcvApp sending the link address ("+hex(base)+")...", end='')
+			sys.stdout.flush()
+			self.ser.write(baseArray)
+			self.ser.write(checksum)
+			ret = self.ser.read(1)
+			if len(ret) == 0:
+				raise Exception ("processCmd failed, opcode timed out")
+			elif ret[0] == self.NAK:
+				raise Exception ("sendRcvApp failed, link address "+hex(base)+" is taken or outside the store")
+			elif ret[0] != self.ACK:
+				raise Exception ("sendRcvApp failed, opcode RCV_APP_AT return malform ACK: "+ret.decode('utf-8'))
+			print("ACKed")
+
+		start = time.time()
+		if self.stream and self.resume:
+			first = self.sendPageCrcs(data, numPages)
+			if first == numPages:
+				print("\tEnd RcvApp, the same image is already stored")
+				return time.time() - start
+			if first > 0:
+				print("\tRcvApp resuming from page "+str(first))
+			self.readAck("RESUME")
+			self.sendChunks(data, first)
+		elif self.stream:
+			self.sendChunks(data)
+		else:
+			self.sendPages(data)
+		elapsed = time.time() - start
+		print("\tEnd RcvApp, %d bytes in %.2f s (%.0f bytes/s)" % (size, elapsed, size/elapsed))
+		return elapsed
+
+	def readImage(self, filename):
+		"""Reads an app, converting it to a BIN first if it is a HEX. Returns the BIN's name and its data, read once for every port until the app changes."""
+		with self.imagesLock:
+			key = (filename, os.path.getmtime(filename))
+			if key not in self.reads:
+				path = filename
+				if path[-3:] == "hex":
+					os.system("hex2bin "+path)
+					path = path[0:-3] + "bin"
+				f = open(path, 'rb')
+				self.reads[key] = (path, f.read())
+				f.close()
+			return self.reads[key]
+
+	def image(self, data, packed=False):
+		"""Returns the CRCs of an image, and its packed chunks if asked, working them out the first time any port needs them."""
+		with self.imagesLock:
+			if data not in self.images:
+				numPages = (len(data) + 2047) // 2048
+				numChunks = (len(data) + self.CHUNK - 1) // self.CHUNK
+				padded = data + bytes(numPages*2048 - len(data))
+				self.images[data] = {
+					'crc': crc.crc32(padded),
+					'pageCrcs': [crc.crc32(padded[i*2048:(i+1)*2048]) for i in range(numPages)],
+					'chunkCrcs': [crc.crc32(padded[i*self.CHUNK:(i+1)*self.CHUNK]) for i in range(numChunks)]
+				}
+			cached = self.images[data]
+			if packed and 'packed' not in cached:
+				cached['packed'] = self.packChunks(data, len(cached['chunkCrcs']))
+			return cached
+
+	def readAck(self, what):
+		ret = self.ser.read(1)
+		if len(ret) == 0:
+			raise Exception ("sendRcvApp failed, "+what+" timed out")
+		elif ret[0] == self.NAK:
+			raise Exception ("sendRcvApp failed, "+what+" returned NAK")
+		elif ret[0] != self.ACK:
+			raise Exception ("sendRcvApp failed, "+what+" return malform ACK: "+ret.hex())
+
+	def sendPageCrcs(self, data, numPages):
+		# Send the CRC of the whole padded image, which the file is created
+		# with, then the CRC of each padded page. The Blox answers with the
+		# first page it doesn't already hold, see Transfer_RcvResume.
+		cached = self.image(data)
+		imageCrc = struct.pack("<L", cached['crc'])
+		print("\tRcvApp sending the image CRC...", end='')
+		sys.stdout.flush()
+		self.ser.write(imageCrc + bytes([0xFF - sum(imageCrc) % 0x100]))
+		self.readAck("image CRC")
+		print("ACKed")
+		pageCrcs = b''.join(struct.pack("<L", pageCrc) for pageCrc in cached['pageCrcs'])
+		print("\tRcvApp sending the page CRCs...", end='')
+		sys.stdout.flush()
+		self.ser.write(pageCrcs + bytes([0xFF - sum(pageCrcs) % 0x100]))
+		self.readAck("page CRCs")
+		ret = self.ser.read(5)
+		if len(ret) < 5 or sum(ret) % 0x100 != 0xFF:
+			raise Exception ("sendRcvApp failed, bad first page")
+		first = struct.unpack("<L", ret[0:4])[0]
+		print("ACKed, "+str(first)+"/"+str(numPages)+" pages stored")
+		return first
+
+	def sendPages(self, data):
+		# Send each page 1 at a time, followed by the CRC of the padded page
+		self.uploaded += len(data)
 		curPageNum = 0
 		while True:
-			checksum[0] = 0
-			page = f.read(2048)
+			page = data[curPageNum*2048:(curPageNum+1)*2048]
 			if not page:
 				break
-			for b in page:
-				checksum[0] = (checksum[0] + b) % 0x100
+			pageCrc = crc.crc32(page + bytes(2048 - len(page)))
 
 			print("\tRcvApp sending page " + str(curPageNum) + "...", end='')
 			sys.stdout.flush();
 			self.ser.write(page)
-			checksum[0] = 0xFF - checksum[0]
-			self.ser.write(checksum)
+			self.ser.write(struct.pack("<L", pageCrc))
 			ret = self.ser.read(1)
 			if len(ret) == 0:
 				raise Exception ("processCmd failed, opcode timed out")
@@ -159,8 +333,154 @@ class transfer:
 				raise Exception ("sendRcvApp failed, opcode RCV_APP return malform ACK: "+ret.decode('utf-8'))
 			print("ACKed")
 			curPageNum += 1
-		f.close()
-		print("\tEnd RcvApp")
+
+	def sendChunks(self, data, first=0, firstSeq=0):
+		# Keep up to WINDOW chunks unanswered, resending the ones NAKed and,
+		# after RESEND seconds without an answer, the ones still unanswered.
+		# The pages before first are already stored. Chunks are numbered from
+		# firstSeq on the wire, so answers to an earlier stream are told apart.
+		numChunks = (len(data) + self.CHUNK - 1) // self.CHUNK
+		nextSeq = min(first * (2048 // self.CHUNK), numChunks)
+		acked = set(range(nextSeq))
+		self.uploaded += len(data) - min(nextSeq*self.CHUNK, len(data))
+		cached = self.image(data, self.compress)
+		packed = cached['packed'] if self.compress else {}
+		lastHeard = time.time()
+		timeout = self.ser.timeout
+		self.ser.timeout = 0.05
+		def frame(seq):
+			chunk = data[seq*self.CHUNK:(seq+1)*self.CHUNK]
+			chunkCrc = cached['chunkCrcs'][seq]
+			if seq in packed:
+				header = struct.pack("<BHB", self.SYNC, (firstSeq + seq) | self.PACKED, len(packed[seq]))
+				chunk = packed[seq]
+			else:
+				header = struct.pack("<BH", self.SYNC, firstSeq + seq)
+			self.ser.write(header + chunk + struct.pack("<L", chunkCrc))
+		try:
+			while True:
+				base = min([s for s in range(numChunks) if s not in acked] or [numChunks])
+				while nextSeq < numChunks and nextSeq < base + self.WINDOW:
+					frame(nextSeq)
+					nextSeq += 1
+				ret = self.ser.read(3)
+				if len(ret) < 3:
+					if time.time() - lastHeard > self.RESEND:
+						print("\tRcvApp resending from chunk "+str(base))
+						for seq in range(base, nextSeq):
+							if seq not in acked:
+								frame(seq)
+						lastHeard = time.time()
+					continue
+				lastHeard = time.time()
+				(reply, seq) = struct.unpack("<BH", ret)
+				if seq == self.DONE:
+					if reply != self.ACK:
+						raise Exception ("sendRcvApp failed, the app couldn't be stored")
+					break
+				if seq < firstSeq or seq - firstSeq >= numChunks:
+					continue
+				seq -= firstSeq
+				if reply == self.ACK:
+					acked.add(seq)
+					if seq % (2048 // self.CHUNK) == 0:
+						print("\tRcvApp chunk "+str(seq)+"/"+str(numChunks)+" ACKed")
+				elif reply == self.NAK:
+					print("\tRcvApp chunk "+str(seq)+" NAKed, resending")
+					frame(seq)
+				else:
+					self.ser.reset_input_buffer()
+		finally:
+			self.ser.timeout = timeout
+
+	def packChunks(self, data, numChunks):
+		# Compress each chunk, with matches reaching back to the start of its
+		# page, see Transfer_Unpack. Chunks that don't shrink are sent raw.
+		packed = {}
+		for seq in range(numChunks):
+			start = seq*self.CHUNK - seq*self.CHUNK % 2048
+			end = min((seq+1)*self.CHUNK, len(data))
+			stream = lzss.compress(data[start:end], seq*self.CHUNK - start)
+			if len(stream) < end - seq*self.CHUNK:
+				if lzss.decompress(stream, data[start:seq*self.CHUNK]) != data[seq*self.CHUNK:end]:
+					raise Exception ("sendRcvApp failed, chunk "+str(seq)+" doesn't decode back")
+				packed[seq] = stream
+		sent = len(data) - sum(min((s+1)*self.CHUNK, len(data)) - s*self.CHUNK - len(packed[s]) - 1 for s in packed)
+		print("\tRcvApp packed "+str(len(packed))+"/"+str(numChunks)+" chunks, "
+			+str(len(data))+" -> "+str(sent)+" bytes")
+		return packed
+
+	def benchRcvApp(self, args):
+		# Upload the same app waiting for each page, then streamed, and delete
+		# each copy again
+		times = []
+		self.resume = False
+		for stream in (False, True):
+			self.stream = stream
+			if stream:
+				self.sendOpcode('RCV_STREAM')
+			self.sendOpcode('RCV_APP')
+			times.append(self.sendRcvApp(list(args), name="bench"))
+			self.sendOpcode('LST_APPS')
+			for (id, name, numPages) in self.sendLstApps([]):
+				if name == "bench":
+					self.sendOpcode('DEL_APP')
+					self.sendDelApp([str(id)])
+		print("\tBenchRcv stop-and-wait %.2f s, streamed %.2f s, %.1fx faster"
+			% (times[0], times[1], times[0]/times[1]))
+
+	def sendSyncApps(self, args):
+		# Send the whole manifest at once, then get back the listing and which
+		# apps are already stored in one answer, and stream only the rest.
+		# See Cmd_SYNC_APPS in blox_transfer.c.
+		apps = []
+		for filename in args:
+			(filename, data) = self.readImage(filename)
+			name = os.path.basename(filename)
+			if name.rfind(".") != -1:
+				name = name[0:name.rfind(".")]
+			name = name[0:31]
+			apps.append((name, data, self.image(data)['crc']))
+		if len(apps) > self.MANIFEST_MAX:
+			raise Exception ("sendSyncApps failed, at most "+str(self.MANIFEST_MAX)+" apps at a time")
+		manifest = bytes([len(apps)]) + b''.join(
+			struct.pack("<BB", self.opcodes['RCV_APP'], len(name)) + bytes(name, 'utf-8')
+			+ struct.pack("<LLL", len(data), imageCrc, 0) for (name, data, imageCrc) in apps)
+		print("\tSyncApps sending the manifest of "+str(len(apps))+" apps...", end='')
+		sys.stdout.flush()
+		self.ser.write(manifest + bytes([0xFF - sum(manifest) % 0x100]))
+		self.readAck("manifest")
+		print("ACKed")
+		# Receive the listing: the files, then whether each app is stored
+		ret = self.ser.read(1)
+		if len(ret) == 0:
+			raise Exception ("sendSyncApps failed, listing timed out")
+		numFiles = ret[0]
+		ret += self.ser.read(38*numFiles + len(apps) + 1)
+		if len(ret) != 38*numFiles + len(apps) + 2 or sum(ret) % 0x100 != 0xFF:
+			self.ser.write(bytes([self.NAK]))
+			raise Exception ("sendSyncApps failed, bad listing")
+		self.ser.write(bytes([self.ACK]))
+		files = []
+		for i in range(numFiles):
+			(id, name, numPages, fileCrc) = struct.unpack("<B32sBL", ret[1+38*i:1+38*(i+1)])
+			name = name.decode('utf-8').split('\0')[0]
+			print("\tSyncApps got id,name,numPages("+str(id)+","+name+","+str(numPages)+")")
+			files.append((id, name, numPages))
+		have = ret[1+38*numFiles:-1]
+		firstSeq = 0
+		for ((name, data, imageCrc), held) in zip(apps, have):
+			numChunks = (len(data) + self.CHUNK - 1) // self.CHUNK
+			if held:
+				print("\tSyncApps "+name+" is already stored")
+			else:
+				print("\tSyncApps sending "+name+"...", end='')
+				sys.stdout.flush()
+				self.readAck(name)
+				print("ACKed")
+				self.sendChunks(data, 0, firstSeq)
+			firstSeq += numChunks
+		return files
 
 	def sendDelApp(self, args):
 		# Send file id
@@ -190,6 +510,7 @@ class transfer:
 		self.ser.write([self.ACK])
 		print("got "+str(numFiles)+" files")
 		# Receive files 1 at a time
+		files = []
 		for i in range(numFiles):
 			print("\tLstApps receving file "+str(i)+"...", end='')
 			# Receive file id
@@ -221,7 +542,8 @@ class transfer:
 				self.ser.write([self.NAK])
 			self.ser.write([self.ACK])
 			print("got id,name,numPages("+str(id)+","+name+","+str(numPages)+")")
-		return
+			files.append((id, name, numPages))
+		return files
 	def sendRunApp(self, args):
 		# Send file id
 		print("\tRunApp Sending file id("+args[0]+")...", end='')
@@ -239,22 +561,166 @@ class transfer:
 		print("ACKed")
 		return
 
-	def __init__(self, ser):
+	def sendMemStats(self, args):
+		# Receive 10 words of heap and stack statistics + checksum
+		print("\tMemStats receiving statistics...", end='')
+		ret = self.ser.read(41)
+		if len(ret) != 41:
+			raise Exception ("sendMemStats failed, statistics timed out")
+		checksum = 0
+		for byte in ret:
+			checksum = (checksum + byte) % 0x100
+		if checksum != 0xFF:
+			raise Exception ("sendMemStats failed, bad checksum")
+		stats = struct.unpack("<10L", ret[0:40])
+		print("got")
+		print("\theap:  size "+str(stats[0])+" current "+str(stats[1])+" peak "+str(stats[2])
+			+" largest free "+str(stats[3])+" blocks "+str(stats[4])+" failures "+str(stats[5]))
+		print("\tstack: size "+str(stats[6])+" peak "+str(stats[7])+" main "+str(stats[8])
+			+" interrupts "+str(stats[9]))
+		return
+
+	# Must match the memory map in blox_system.h, as (name, first page, pages)
+	regions = [
+		('base', 0, 32),
+		('sysvar', 32, 1),
+		('stage', 33, 32),
+		('fat', 65, 1),
+		('store', 66, 181),
+		('dir', 247, 6),
+		('fat alt', 253, 1),
+		('kv', 254, 2)
+	]
+
+	def sendWearStats(self, args):
+		# Receive the number of pages, a word per page + checksum
+		print("\tWearStats receiving erase counts...", end='')
+		ret = self.ser.read(4)
+		if len(ret) != 4:
+			raise Exception ("sendWearStats failed, page count timed out")
+		numPages = struct.unpack("<L", ret)[0]
+		ret += self.ser.read(4*numPages + 1)
+		if len(ret) != 4*numPages + 5:
+			raise Exception ("sendWearStats failed, erase counts timed out")
+		if sum(ret) % 0x100 != 0xFF:
+			raise Exception ("sendWearStats failed, bad checksum")
+		counts = struct.unpack("<"+str(numPages)+"L", ret[4:4+4*numPages])
+		print("got")
+		for (name, first, num) in self.regions:
+			region = counts[first:first+num]
+			hottest = first + region.index(max(region))
+			print("\t%-8s erases: total %d min %d max %d mean %.1f, hottest page %d (0x%08x)"
+				% (name, sum(region), min(region), max(region), float(sum(region))/num,
+				hottest, 0x08000000 + hottest*2048))
+		return
+
+	def __init__(self, ser, stream=True, resume=True, compress=True):
 		self.ser = ser;
-			
+		self.stream = stream
+		self.resume = resume
+		self.compress = compress
+		self.uploaded = 0
+
+class threadLog:
+	"""Stands in for stdout while several ports run at once, keeping what each port's thread prints apart."""
+	def __init__(self, out):
+		self.out = out
+		self.logs = {}
+
+	def write(self, text):
+		log = self.logs.get(threading.current_thread().name)
+		if log is None:
+			self.out.write(text)
+		else:
+			log.write(text)
+
+	def flush(self):
+		self.out.flush()
+
+def parallel(ports, args, stream, resume, compress):
+	"""Runs the same command on every port at once, a thread per port since pyserial blocks, then reports how each went and the total throughput."""
+	results = {}
+	log = threadLog(sys.stdout)
+	def run(port):
+		begin = time.time()
+		t = None
+		try:
+			t = transfer(serial.Serial(port, 115200, parity=serial.PARITY_EVEN), stream, resume, compress)
+			t.processCmd(list(args))
+			status = "done"
+		except Exception as e:
+			status = "failed, " + str(e)
+		results[port] = (status, time.time() - begin, t.uploaded if t else 0)
+	threads = [threading.Thread(target=run, args=(port,), name=port) for port in ports]
+	for thread in threads:
+		log.logs[thread.name] = io.StringIO()
+	sys.stdout = log
+	start = time.time()
+	try:
+		for thread in threads:
+			thread.start()
+		for thread in threads:
+			thread.join()
+	finally:
+		sys.stdout = log.out
+	elapsed = time.time() - start
+	for port in ports:
+		print("== "+port)
+		print(log.logs[port].getvalue(), end='')
+	total = 0
+	for port in ports:
+		(status, seconds, uploaded) = results[port]
+		total += uploaded
+		print("%-16s %6.2f s %8d bytes  %s" % (port, seconds, uploaded, status))
+	print("%d ports in %.2f s, %d bytes uploaded (%.0f bytes/s)" % (len(ports), elapsed, total, total/elapsed))
+	if [port for port in ports if results[port][0] != "done"]:
+		sys.exit(1)
+
 if len(sys.argv) < 3:
 	help()
 
-ser = serial.Serial(sys.argv[1], 115200, parity=serial.PARITY_EVEN)
-transfer = transfer(ser)
-transfer.processCmd(sys.argv[2:])
+stream = "--stop-wait" not in sys.argv
+if not stream:
+	sys.argv.remove("--stop-wait")
+resume = "--no-resume" not in sys.argv
+if not resume:
+	sys.argv.remove("--no-resume")
+compress = "--no-compress" not in sys.argv
+if not compress:
+	sys.argv.remove("--no-compress")
+if ',' in sys.argv[1]:
+	parallel(sys.argv[1].split(','), sys.argv[2:], stream, resume, compress)
+else:
+	ser = serial.Serial(sys.argv[1], 115200, parity=serial.PARITY_EVEN)
+	transfer = transfer(ser, stream, resume, compress)
+	transfer.processCmd(sys.argv[2:])
 
 def help():
 	"""\
-	Usage: transfer.py [port] [command] [data|filename]
+	Usage: transfer.py [--stop-wait] [--no-resume] [--no-compress] [port] [command] [data|filename]
+
+	Uploads are streamed, unless --stop-wait is given to wait for each page
+	to be stored before sending the next. BENCH_RCV times an upload both ways.
+	A streamed upload keeps the pages an interrupted upload of the same image
+	stored and sends the rest, or nothing if the image is already stored;
+	--no-resume always sends the whole image. Streamed chunks are compressed
+	when that makes them smaller, unless --no-compress is given. SYNC_APPS
+	sends a manifest of several apps at once and streams only the ones the
+	Blox doesn't already hold.
+
+	Several ports separated by commas run the command on every one at once,
+	reading and chunking each image only once, and report how each went.
 
 	A transfer program for interacting with a base program loaded on a Blox.
 
 	Examples:
-	transfer.py COM4 RCV_APP myfile.hex"""
+	transfer.py COM4 RCV_APP myfile.hex
+	transfer.py COM4 RCV_APP_AT myfile.hex
+	transfer.py COM4 RCV_APP_AT myfile.bin 0x08030000
+	transfer.py COM4 RCV_APP_LZ myfile.hex
+	transfer.py --stop-wait COM4 RCV_APP myfile.hex
+	transfer.py --no-resume COM4 RCV_APP myfile.hex
+	transfer.py COM4 BENCH_RCV myfile.hex
+	transfer.py COM4 SYNC_APPS first.hex second.hex
+	transfer.py COM4,COM5,COM6 SYNC_APPS first.hex second.hex"""
 
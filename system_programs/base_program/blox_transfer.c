@@ -35,9 +35,35 @@
  */
 /* Private function prototypes */
 TRANSFER_STATUS Cmd_RCV_APP(void);
+TRANSFER_STATUS Cmd_RCV_APP_AT(void);
+TRANSFER_STATUS Cmd_RCV_APP_LZ(void);
 TRANSFER_STATUS Cmd_DEL_APP(void);
 TRANSFER_STATUS Cmd_LST_APPS(void);
 TRANSFER_STATUS Cmd_RUN_APP(void);
+TRANSFER_STATUS Cmd_MEM_STATS(void);
+TRANSFER_STATUS Cmd_WEAR_STATS(void);
+TRANSFER_STATUS Cmd_RCV_STREAM(void);
+TRANSFER_STATUS Cmd_RESUME(void);
+TRANSFER_STATUS Cmd_SYNC_APPS(void);
+TRANSFER_OPCODE Transfer_RcvUploadOp(void);
+TRANSFER_STATUS Transfer_RcvApp(TRANSFER_OPCODE op);
+TRANSFER_STATUS Transfer_RcvStream(TRANSFER_OPCODE op);
+TRANSFER_STATUS Transfer_RcvResume(TRANSFER_OPCODE op);
+TRANSFER_STATUS Transfer_RcvManifest(TransferEntry **entries, uint8_t *count);
+void Transfer_SendListing(TransferEntry *entries, uint8_t count);
+uint8_t Transfer_OpenFile(char *name, uint32_t numPages, uint32_t *addr, uint32_t crc);
+TRANSFER_STATUS Transfer_RcvChunks(TRANSFER_OPCODE op, uint8_t id, uint32_t size, uint32_t page,
+                                   uint16_t firstSeq);
+TRANSFER_STATUS Transfer_RcvHeader(TRANSFER_OPCODE op, char *name, uint32_t *size,
+                                   uint32_t **addr);
+TRANSFER_STATUS Transfer_StorePage(TRANSFER_OPCODE op, uint8_t id, uint8_t *page,
+                                   uint32_t i, uint32_t size);
+uint8_t Transfer_PageMask(uint32_t page, uint16_t numChunks);
+TRANSFER_STATUS Transfer_Unpack(const uint8_t *packed, uint8_t packedLen, uint8_t *page,
+                                uint8_t slot, uint16_t len);
+void Transfer_SendSeq(uint8_t reply, uint16_t seq);
+void Transfer_SendWord(uint32_t word, uint8_t *checksum);
+uint32_t Transfer_ReceiveWord(uint8_t *checksum);
 
 /**
  * @brief Initializes the transfer module.
@@ -67,6 +93,12 @@ void Transfer_Slave(void) {
     switch(opcode) {
     case RCV_APP:
       Cmd_RCV_APP();
+      break;
+    case RCV_APP_AT:
+      Cmd_RCV_APP_AT();
+      break;
+    case RCV_APP_LZ:
+      Cmd_RCV_APP_LZ();
       break;
 	  case DEL_APP:
       Cmd_DEL_APP();
@@ -77,6 +109,21 @@ void Transfer_Slave(void) {
 	  case RUN_APP:
       Cmd_RUN_APP();
       break;
+    case MEM_STATS:
+      Cmd_MEM_STATS();
+      break;
+    case WEAR_STATS:
+      Cmd_WEAR_STATS();
+      break;
+    case RCV_STREAM:
+      Cmd_RCV_STREAM();
+      break;
+    case RESUME:
+      Cmd_RESUME();
+      break;
+    case SYNC_APPS:
+      Cmd_SYNC_APPS();
+      break;
     }
   }
 }
@@ -87,10 +134,544 @@ void Transfer_Slave(void) {
  *         -TRANSFER_CMD_FAIL if the receive or store fail.
  */
 TRANSFER_STATUS Cmd_RCV_APP(void) {
-  uint8_t checksum, name_len, id, numPages, *page;
+  return Transfer_RcvApp(RCV_APP);
+}
+
+/**
+ * @brief Receives an application linked to run in place and stores it at
+ *        its link address.
+ * @retval TRANSFER_OK if the receive and application store succeed.
+ *         -TRANSFER_CMD_FAIL if the receive or store fail.
+ */
+TRANSFER_STATUS Cmd_RCV_APP_AT(void) {
+  return Transfer_RcvApp(RCV_APP_AT);
+}
+
+/**
+ * @brief Receives an application compressed by misc/lzss.py. It is stored
+ *        compressed and decompressed into staging when it is run.
+ * @retval TRANSFER_OK if the receive and application store succeed.
+ *         -TRANSFER_CMD_FAIL if the receive or store fail.
+ */
+TRANSFER_STATUS Cmd_RCV_APP_LZ(void) {
+  return Transfer_RcvApp(RCV_APP_LZ);
+}
+
+/**
+ * @brief Receives an application as a stream of chunks. Sent with the
+ *        RCV_APP* opcode it stands in for and a checksum, then goes on as
+ *        that opcode does until the data.
+ * @retval TRANSFER_OK if the receive and application store succeed.
+ *         -TRANSFER_CMD_FAIL if the receive or store fail.
+ */
+TRANSFER_STATUS Cmd_RCV_STREAM(void) {
+  TRANSFER_OPCODE op = Transfer_RcvUploadOp();
+  if (op == OP_TOP)
+    return TRANSFER_CMD_FAIL;
+  return Transfer_RcvStream(op);
+}
+
+/**
+ * @brief Receives an application as a stream, carrying on from where an
+ *        earlier upload of the same image stopped. Sent with the RCV_APP*
+ *        opcode it stands in for and a checksum, like RCV_STREAM.
+ * @retval TRANSFER_OK if the receive and application store succeed.
+ *         -TRANSFER_CMD_FAIL if the receive or store fail.
+ */
+TRANSFER_STATUS Cmd_RESUME(void) {
+  TRANSFER_OPCODE op = Transfer_RcvUploadOp();
+  if (op == OP_TOP)
+    return TRANSFER_CMD_FAIL;
+  return Transfer_RcvResume(op);
+}
+
+/**
+ * @brief Receives the RCV_APP* opcode a RCV_STREAM or RESUME stands in for
+ *        and its checksum, and ACKs or NAKs it.
+ * @retval the opcode, OP_TOP if it is bad.
+ */
+TRANSFER_OPCODE Transfer_RcvUploadOp(void) {
+  uint8_t checksum, op;
+  op = USB_Receive();
+  checksum = USB_Receive();
+  if ((checksum+op) != 0xFF || (op != RCV_APP && op != RCV_APP_AT && op != RCV_APP_LZ)) {
+    USB_Send(TRANSFER_NAK);
+    return OP_TOP;
+  }
+  USB_Send(TRANSFER_ACK);
+  return (TRANSFER_OPCODE)op;
+}
+
+/**
+ * @brief Receives an application and stores it in the fs, a page at a time.
+ *        Each page is followed by the CRC-32 of the page zero-padded to
+ *        PAGE_SIZE, as misc/crc.py computes it, and is stored before it is
+ *        ACKed.
+ * @param op the RCV_APP* opcode being handled
+ * @retval TRANSFER_OK if the receive and application store succeed.
+ *         -TRANSFER_CMD_FAIL if the receive or store fail.
+ */
+TRANSFER_STATUS Transfer_RcvApp(TRANSFER_OPCODE op) {
+  uint8_t checksum, id, numPages, *page;
   uint16_t i, j;
-  char name[FS_FILE_MAX_NAME_LEN];  
-  uint32_t size, remaining, read_amt;    
+  uint32_t size, remaining, read_amt, crc, *addr;
+  char name[FS_FILE_MAX_NAME_LEN];
+  
+  if (Transfer_RcvHeader(op, name, &size, &addr) != TRANSFER_OK)
+    return TRANSFER_CMD_FAIL;
+  numPages = FS_RoundPageUp(size); 
+  id = FS_CreateFileAt(name, numPages, addr, CRC_NONE);
+  if (id == FS_MAX_FILES) {
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
+  }
+  
+  /*** Receive pages 1 at a time ***/
+  remaining = size;  
+  page = (uint8_t *)malloc(PAGE_SIZE);  
+  if (page == NULL) {
+    FS_DeleteFile(id);
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
+  }
+  USB_Send(TRANSFER_ACK);
+  for(i = 0; i < numPages; i++) {
+    memset(page, 0, PAGE_SIZE); //Zero for funs
+    checksum = 0;
+    if(remaining < PAGE_SIZE)
+      read_amt = remaining; //Don't read too much on the last page
+    else
+      read_amt = PAGE_SIZE; 
+    for(j = 0; j < read_amt; j++)
+      page[j] = USB_Receive();
+    crc = Transfer_ReceiveWord(&checksum);
+    if (crc != Blox_CRC_Calc((uint32_t *)page, PAGE_SIZE/WORD_SIZE)
+          || Transfer_StorePage(op, id, page, i, size) != TRANSFER_OK) {
+      USB_Send(TRANSFER_NAK);
+      FS_DeleteFile(id);
+      free(page);
+      return TRANSFER_CMD_FAIL;
+    }
+    USB_Send(TRANSFER_ACK);        
+    remaining -= PAGE_SIZE;
+  }
+  free(page);
+  return TRANSFER_OK;
+}
+
+/**
+ * @brief Receives an application as a stream of chunks into a new file.
+ * @param op the RCV_APP* opcode the stream is for
+ * @retval TRANSFER_OK if the receive and application store succeed.
+ *         -TRANSFER_CMD_FAIL if the receive or store fail.
+ */
+TRANSFER_STATUS Transfer_RcvStream(TRANSFER_OPCODE op) {
+  uint8_t id;
+  char name[FS_FILE_MAX_NAME_LEN];
+  uint32_t size, *addr;
+  
+  if (Transfer_RcvHeader(op, name, &size, &addr) != TRANSFER_OK)
+    return TRANSFER_CMD_FAIL;
+  id = FS_CreateFileAt(name, FS_RoundPageUp(size), addr, CRC_NONE);
+  if (id == FS_MAX_FILES) {
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
+  }
+  if (Transfer_RcvChunks(op, id, size, 0, 0) != TRANSFER_OK) {
+    FS_DeleteFile(id);
+    return TRANSFER_CMD_FAIL;
+  }
+  return TRANSFER_OK;
+}
+
+/**
+ * @brief Receives an application as a stream, keeping what an earlier
+ *        upload of the same image stored. After the header come the
+ *        Blox_CRC_Calc of the whole image zero-padded to whole pages and a
+ *        checksum, which is recorded in the file as it is created. A file
+ *        of the same name with another CRC, size or link address is
+ *        replaced. Then come the CRC of each padded page and a checksum,
+ *        and the number of the first page that doesn't match is sent back
+ *        with a checksum. The stream starts from that page, and there is
+ *        none if every page matched. The file is kept if the stream fails,
+ *        so a RESUME of the same image carries on from there.
+ * @param op the RCV_APP* opcode the stream is for
+ * @retval TRANSFER_OK if the receive and application store succeed.
+ *         -TRANSFER_CMD_FAIL if the receive or store fail.
+ */
+TRANSFER_STATUS Transfer_RcvResume(TRANSFER_OPCODE op) {
+  uint8_t checksum, id;
+  char name[FS_FILE_MAX_NAME_LEN];
+  uint32_t i, size, crc, first = 0, numPages, *addr;
+  
+  if (Transfer_RcvHeader(op, name, &size, &addr) != TRANSFER_OK)
+    return TRANSFER_CMD_FAIL;
+  USB_Send(TRANSFER_ACK);
+  checksum = 0;
+  crc = Transfer_ReceiveWord(&checksum);
+  checksum += USB_Receive();
+  numPages = FS_RoundPageUp(size);
+  id = (checksum == 0xFF) ? Transfer_OpenFile(name, numPages, addr, crc) : FS_MAX_FILES;
+  if (id == FS_MAX_FILES) {
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
+  }
+  USB_Send(TRANSFER_ACK);
+  
+  /*** Find the first page that isn't stored yet ***/
+  checksum = 0;
+  for (i = 0; i < numPages; i++) {
+    crc = Transfer_ReceiveWord(&checksum);
+    if (first == i && crc == Blox_CRC_Calc(FS_GetFile(id)->data + i*PAGE_SIZE/WORD_SIZE,
+                                           PAGE_SIZE/WORD_SIZE))
+      first++;
+  }
+  checksum += USB_Receive();
+  if (checksum != 0xFF) {
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
+  }
+  if (first == numPages && FS_VerifyFile(FS_GetFile(id)) != FS_OK)
+    first = 0;
+  USB_Send(TRANSFER_ACK);
+  checksum = 0;
+  Transfer_SendWord(first, &checksum);
+  USB_Send(0xFF-checksum);
+  
+  if (first == numPages)
+    return TRANSFER_OK;
+  return Transfer_RcvChunks(op, id, size, first, 0);
+}
+
+/**
+ * @brief Brings the fs in line with a manifest of apps in one exchange.
+ *        The manifest is sent all at once: the number of apps, then for
+ *        each its RCV_APP* opcode, name length, name, size, the
+ *        Blox_CRC_Calc of the image zero-padded to whole pages and the
+ *        link address (0 unless RCV_APP_AT), words LSB first, then one
+ *        checksum. It is ACKed and answered with a listing of every file
+ *        and which apps are already held, see Transfer_SendListing. The
+ *        sender answers that with an ACK to go on or a NAK to stop, then
+ *        each app not held is streamed in manifest order as
+ *        Transfer_RcvChunks describes, each starting with its ACK once its
+ *        file is open, or a NAK if it can't be. Sequence numbers run on
+ *        from one app to the next, so a chunk of an earlier app resent late
+ *        is ignored rather than taken for one of the next.
+ * @retval TRANSFER_OK if every app is held once done.
+ *         -TRANSFER_CMD_FAIL if the manifest, or storing an app, fails.
+ */
+TRANSFER_STATUS Cmd_SYNC_APPS(void) {
+  uint8_t count, i, id;
+  uint16_t firstSeq = 0;
+  TransferEntry *entries, *e;
+  FS_File *file;
+  TRANSFER_STATUS status = TRANSFER_OK;
+  
+  if (Transfer_RcvManifest(&entries, &count) != TRANSFER_OK)
+    return TRANSFER_CMD_FAIL;
+  for (i = 0; i < count; i++) {
+    e = &entries[i];
+    file = FS_GetFileFromName(e->name);
+    e->have = file != NULL && file->crc == e->crc && file->numPages == FS_RoundPageUp(e->size)
+      && (e->addr == NULL || file->data == e->addr) && FS_VerifyFile(file) == FS_OK;
+  }
+  USB_Send(TRANSFER_ACK);
+  Transfer_SendListing(entries, count);
+  if (USB_Receive() != TRANSFER_ACK) {
+    free(entries);
+    return TRANSFER_CMD_FAIL;
+  }
+  
+  /*** Stream the apps that aren't held, a file left unsealed is resent ***/
+  for (i = 0; i < count && status == TRANSFER_OK; i++) {
+    e = &entries[i];
+    if (!e->have) {
+      id = Transfer_OpenFile(e->name, FS_RoundPageUp(e->size), e->addr, e->crc);
+      if (id == FS_MAX_FILES) {
+        USB_Send(TRANSFER_NAK);
+        status = TRANSFER_CMD_FAIL;
+      } else {
+        status = Transfer_RcvChunks((TRANSFER_OPCODE)e->op, id, e->size, 0, firstSeq);
+      }
+    }
+    firstSeq += (e->size + TRANSFER_CHUNK - 1)/TRANSFER_CHUNK;
+  }
+  free(entries);
+  return status;
+}
+
+/**
+ * @brief Receives a SYNC_APPS manifest, NAKing it if it is malformed or
+ *        can't be held in RAM.
+ * @param entries set to the apps, malloc'd, NULL if there are none
+ * @param count set to the number of apps
+ * @retval TRANSFER_OK if the manifest is received, -TRANSFER_CMD_FAIL if not.
+ */
+TRANSFER_STATUS Transfer_RcvManifest(TransferEntry **entries, uint8_t *count) {
+  uint8_t checksum, nameLen, ok = TRUE, i, j;
+  uint32_t chunks = 0;
+  TransferEntry *e;
+  
+  *count = USB_Receive();
+  checksum = *count;
+  *entries = NULL;
+  if (*count > TRANSFER_MANIFEST_MAX
+        || (*count > 0 && (*entries = (TransferEntry *)malloc(*count * sizeof(TransferEntry))) == NULL)) {
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
+  }
+  for (i = 0; i < *count; i++) {
+    e = &(*entries)[i];
+    e->op = USB_Receive();
+    nameLen = USB_Receive();
+    checksum += e->op + nameLen;
+    /* The rest of the manifest can't be found past a bad name length */
+    if (nameLen > FS_FILE_MAX_NAME_LEN-1) {
+      free(*entries);
+      USB_Send(TRANSFER_NAK);
+      return TRANSFER_CMD_FAIL;
+    }
+    for (j = 0; j < nameLen; j++) {
+      e->name[j] = USB_Receive();
+      checksum += e->name[j];
+    }
+    e->name[j] = '\0';
+    e->size = Transfer_ReceiveWord(&checksum);
+    e->crc = Transfer_ReceiveWord(&checksum);
+    e->addr = (uint32_t *)Transfer_ReceiveWord(&checksum);
+    if (e->op != RCV_APP_AT)
+      e->addr = NULL;
+    if ((e->op != RCV_APP && e->op != RCV_APP_AT && e->op != RCV_APP_LZ)
+          || (e->op == RCV_APP_AT && e->addr == NULL)
+          || e->size == 0 || FS_RoundPageUp(e->size) > 0xFF)
+      ok = FALSE;
+    chunks += (e->size + TRANSFER_CHUNK - 1)/TRANSFER_CHUNK;
+  }
+  checksum += USB_Receive();
+  if (checksum != 0xFF || !ok || chunks > TRANSFER_PACKED) {
+    free(*entries);
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
+  }
+  return TRANSFER_OK;
+}
+
+/**
+ * @brief Sends the listing a SYNC_APPS manifest is answered with, in one
+ *        go with one checksum: the number of files, then for each its id,
+ *        name, number of pages and CRC, then a byte per app in the
+ *        manifest, TRUE if it is held.
+ * @param entries the manifest's apps
+ * @param count the number of apps
+ * @retval None.
+ */
+void Transfer_SendListing(TransferEntry *entries, uint8_t count) {
+  uint8_t checksum, numFiles, i, j;
+  FS_File *file;
+  
+  numFiles = FS_GetNumFiles();
+  USB_Send(numFiles);
+  checksum = numFiles;
+  for (i = 0; i < numFiles; i++) {
+    file = FS_GetFile(i);
+    USB_Send(file->id);
+    checksum += file->id;
+    for (j = 0; j < FS_FILE_MAX_NAME_LEN; j++) {
+      USB_Send(file->name[j]);
+      checksum += file->name[j];
+    }
+    USB_Send(file->numPages);
+    checksum += file->numPages;
+    Transfer_SendWord(file->crc, &checksum);
+  }
+  for (i = 0; i < count; i++) {
+    USB_Send(entries[i].have);
+    checksum += entries[i].have;
+  }
+  USB_Send(0xFF-checksum);
+}
+
+/**
+ * @brief Finds the file an upload of an image goes into. A file of the
+ *        same name with another CRC, size or link address is replaced, and
+ *        one is created, recording the CRC, if there is none.
+ * @param name the name of the application
+ * @param numPages the pages the image takes up
+ * @param addr the link address, NULL if it can go anywhere
+ * @param crc Blox_CRC_Calc of the image zero-padded to whole pages
+ * @retval the file's id, FS_MAX_FILES if there is no room for it.
+ */
+uint8_t Transfer_OpenFile(char *name, uint32_t numPages, uint32_t *addr, uint32_t crc) {
+  FS_File *file = FS_GetFileFromName(name);
+  if (file != NULL && (file->crc != crc || file->numPages != numPages
+        || (addr != NULL && file->data != addr))) {
+    if (FS_DeleteFile(file->id) != FS_OK)
+      return FS_MAX_FILES;
+    file = NULL;
+  }
+  if (file != NULL)
+    return file->id;
+  return FS_CreateFileAt(name, numPages, addr, crc);
+}
+
+/**
+ * @brief Receives the chunks of a stream, without waiting for each page to
+ *        be stored. Each chunk is sent as TRANSFER_SYNC, its 16-bit
+ *        sequence number LSB first, TRANSFER_CHUNK bytes (fewer for the
+ *        last) and the CRC-32 of the chunk zero-padded to TRANSFER_CHUNK.
+ *        Every chunk is answered with TRANSFER_ACK or TRANSFER_NAK and its
+ *        sequence number, and the sender resends the ones NAKed or not
+ *        answered. The sender keeps at most TRANSFER_WINDOW chunks
+ *        unanswered, so they span two pages at most: one page is filled
+ *        while the other is stored. The USART is read by DMA into a ring,
+ *        so chunks keep arriving while the flash is programmed. Starts with
+ *        an ACK once the ring is set up, and ends with sequence number
+ *        TRANSFER_DONE, ACKed once the file is sealed or NAKed if it
+ *        couldn't be stored. A chunk may be sent packed instead, with
+ *        TRANSFER_PACKED set in its sequence number and its data replaced
+ *        by a length byte and that many bytes compressed by misc/lzss.py.
+ *        The CRC is still of the unpacked chunk.
+ * @param op the RCV_APP* opcode the stream is for
+ * @param id the file
+ * @param size the size of the application in bytes
+ * @param page the first page to receive, the ones before it are stored
+ * @param firstSeq the sequence number of the app's first chunk, chunks
+ *        numbered outside the app are ignored
+ * @retval TRANSFER_OK if the receive and application store succeed.
+ *         -TRANSFER_CMD_FAIL if the receive or store fail.
+ */
+TRANSFER_STATUS Transfer_RcvChunks(TRANSFER_OPCODE op, uint8_t id, uint32_t size, uint32_t page,
+                                   uint16_t firstSeq) {
+  uint8_t have, slot, packedLen, *ring, *pages, *packed, *base, *dst, got[2] = {0, 0};
+  uint16_t i, len, seq, numChunks;
+  uint32_t crc, numPages;
+  
+  numPages = FS_RoundPageUp(size);
+  numChunks = (size + TRANSFER_CHUNK - 1)/TRANSFER_CHUNK;
+  ring = (uint8_t *)malloc(TRANSFER_RING);
+  pages = (uint8_t *)malloc(2*PAGE_SIZE + TRANSFER_CHUNK);
+  if (ring == NULL || pages == NULL) {
+    free(ring);
+    free(pages);
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
+  }
+  memset(pages, 0, 2*PAGE_SIZE);
+  packed = pages + 2*PAGE_SIZE;
+  USB_StartRxDMA(ring, TRANSFER_RING);
+  USB_Send(TRANSFER_ACK);
+  
+  while (page < numPages) {
+    if (USB_ReceiveDMA() != TRANSFER_SYNC)
+      continue;
+    seq = USB_ReceiveDMA();
+    seq |= USB_ReceiveDMA() << 8;
+    packedLen = 0;
+    if (seq & TRANSFER_PACKED) {
+      seq &= ~TRANSFER_PACKED;
+      packedLen = USB_ReceiveDMA();
+    }
+    if (seq < firstSeq || seq - firstSeq >= numChunks)
+      continue;
+    seq -= firstSeq;
+    len = TRANSFER_CHUNK;
+    if (size - seq*TRANSFER_CHUNK < TRANSFER_CHUNK)
+      len = size - seq*TRANSFER_CHUNK;
+    /* Only the page being filled and the one after it have a buffer, and
+       chunks already received are only answered again */
+    have = seq/TRANSFER_PAGE_CHUNKS < page || (seq/TRANSFER_PAGE_CHUNKS <= page + 1
+        && (got[seq/TRANSFER_PAGE_CHUNKS % 2] & (1 << (seq % TRANSFER_PAGE_CHUNKS))));
+    if (have || seq/TRANSFER_PAGE_CHUNKS > page + 1) {
+      for (i = 0; i < (packedLen ? packedLen : len) + 4; i++)
+        USB_ReceiveDMA();
+      if (have)
+        Transfer_SendSeq(TRANSFER_ACK, firstSeq + seq);
+      continue;
+    }
+    slot = seq % TRANSFER_PAGE_CHUNKS;
+    base = pages + (seq/TRANSFER_PAGE_CHUNKS % 2)*PAGE_SIZE;
+    dst = base + slot*TRANSFER_CHUNK;
+    if (packedLen) {
+      for (i = 0; i < packedLen; i++)
+        packed[i] = USB_ReceiveDMA();
+    } else {
+      for (i = 0; i < len; i++)
+        dst[i] = USB_ReceiveDMA();
+    }
+    crc = 0;
+    for (i = 0; i < 4; i++)
+      crc |= (uint32_t)USB_ReceiveDMA() << (8*i);
+    /* A packed chunk may copy from the chunks before it in its page, so
+       it can only be unpacked once they are in */
+    if ((packedLen && ((got[seq/TRANSFER_PAGE_CHUNKS % 2] & ((1 << slot) - 1)) != (1 << slot) - 1
+                       || Transfer_Unpack(packed, packedLen, base, slot, len) != TRANSFER_OK))
+        || crc != Blox_CRC_Calc((uint32_t *)dst, TRANSFER_CHUNK/WORD_SIZE)) {
+      Transfer_SendSeq(TRANSFER_NAK, firstSeq + seq);
+      continue;
+    }
+    got[seq/TRANSFER_PAGE_CHUNKS % 2] |= 1 << (seq % TRANSFER_PAGE_CHUNKS);
+    Transfer_SendSeq(TRANSFER_ACK, firstSeq + seq);
+    
+    /* Store every page that is complete, while the DMA keeps receiving */
+    while (page < numPages && got[page % 2] == Transfer_PageMask(page, numChunks)) {
+      dst = pages + (page % 2)*PAGE_SIZE;
+      if (Transfer_StorePage(op, id, dst, page, size) != TRANSFER_OK) {
+        USB_StopRxDMA();
+        Transfer_SendSeq(TRANSFER_NAK, TRANSFER_DONE);
+        free(ring);
+        free(pages);
+        return TRANSFER_CMD_FAIL;
+      }
+      memset(dst, 0, PAGE_SIZE);
+      got[page % 2] = 0;
+      page++;
+    }
+  }
+  USB_StopRxDMA();
+  Transfer_SendSeq(TRANSFER_ACK, TRANSFER_DONE);
+  free(ring);
+  free(pages);
+  return TRANSFER_OK;
+}
+
+/**
+ * @brief Unpacks a packed chunk of a stream into its page. The chunks
+ *        before it in the page are the decoder's history, so the only RAM
+ *        it needs is the page.
+ * @param packed the chunk's data, compressed by misc/lzss.py
+ * @param packedLen the length of the compressed data
+ * @param page the page the chunk is in
+ * @param slot the chunk's number in the page
+ * @param len the length of the chunk unpacked
+ * @retval TRANSFER_OK if it unpacks to exactly len bytes,
+ *         -TRANSFER_CMD_FAIL if not.
+ */
+TRANSFER_STATUS Transfer_Unpack(const uint8_t *packed, uint8_t packedLen, uint8_t *page,
+                                uint8_t slot, uint16_t len) {
+  BloxLZ lz;
+  Blox_LZ_Init(&lz, packed, packedLen);
+  lz.pos = slot*TRANSFER_CHUNK;
+  if (Blox_LZ_Decode(&lz, page + lz.pos, len, page) != len || lz.error
+        || lz.matchLen != 0 || lz.in != lz.end)
+    return TRANSFER_CMD_FAIL;
+  return TRANSFER_OK;
+}
+
+/**
+ * @brief Receives the name and size of an application being uploaded, and
+ *        the link address for RCV_APP_AT. Sends a NAK if any of it fails,
+ *        but leaves the last ACK to the caller.
+ * @param op the RCV_APP* opcode being handled
+ * @param name set to the name of the application, FS_FILE_MAX_NAME_LEN long
+ * @param size set to the size of the application in bytes
+ * @param addr set to the link address, NULL unless RCV_APP_AT
+ * @retval TRANSFER_OK if the header is received, -TRANSFER_CMD_FAIL if not.
+ */
+TRANSFER_STATUS Transfer_RcvHeader(TRANSFER_OPCODE op, char *name, uint32_t *size,
+                                   uint32_t **addr) {
+  uint8_t checksum, name_len;
+  uint16_t i;
+  *addr = NULL;    
   /*** Get # of characters in filename ***/
   checksum = 0;
   name_len = USB_Receive();
@@ -116,53 +697,74 @@ TRANSFER_STATUS Cmd_RCV_APP(void) {
      
   /*** Get file size in pages ***/
   checksum = 0;
-  size = USB_Receive() 
-       | (USB_Receive() << 8)
-       | (USB_Receive() << 16)
-       | (USB_Receive() << 24);
-  checksum += size & 0xFF;
-  checksum += (size >> 8) & 0xFF;
-  checksum += (size >> 16) & 0xFF;
-  checksum += (size >> 24) & 0xFF;
+  *size = Transfer_ReceiveWord(&checksum);
   checksum += USB_Receive();
-  
-  numPages = FS_RoundPageUp(size); 
-  id = FS_CreateFile(name, numPages);
-  if (checksum != 0xFF || id == FS_MAX_FILES) {
-    USB_Send(TRANSFER_NAK);
-    return TRANSFER_CMD_FAIL;
-  }
-  USB_Send(TRANSFER_ACK);
-  
-  /*** Receive pages 1 at a time ***/
-  remaining = size;  
-  page = (uint8_t *)malloc(PAGE_SIZE);  
-  for(i = 0; i < numPages; i++) {
-    memset(page, 0, PAGE_SIZE); //Zero for funs
-    checksum = 0;
-    if(remaining < PAGE_SIZE)
-      read_amt = remaining; //Don't read too much on the last page
-    else
-      read_amt = PAGE_SIZE; 
-    for(j = 0; j < read_amt; j++) {
-      page[j] = USB_Receive();
-      checksum += page[j];
-    }
-    checksum += USB_Receive();
-    FS_WriteFilePage(id, (uint32_t *)page, i);
-    if (checksum != 0xFF || id == FS_MAX_FILES) {
+  if (op == RCV_APP_AT) {
+    if (checksum != 0xFF) {
       USB_Send(TRANSFER_NAK);
-      FS_DeleteFile(id);
-      free(page);
       return TRANSFER_CMD_FAIL;
     }
-    USB_Send(TRANSFER_ACK);        
-    remaining -= PAGE_SIZE;
+    USB_Send(TRANSFER_ACK);
+    checksum = 0;
+    *addr = (uint32_t *)Transfer_ReceiveWord(&checksum);
+    checksum += USB_Receive();
+  }
+  
+  if (checksum != 0xFF) {
+    USB_Send(TRANSFER_NAK);
+    return TRANSFER_CMD_FAIL;
   }
-  free(page);
   return TRANSFER_OK;
 }
 
+/**
+ * @brief Stores a received page of an application. The first page is
+ *        checked to be an image, RCV_APP_LZ ones starting with an
+ *        FS_LZHeader, and the file is sealed with its CRC once the last
+ *        page is stored.
+ * @param op the RCV_APP* opcode being handled
+ * @param id the file
+ * @param page the page, zero-padded to PAGE_SIZE
+ * @param i the page's number in the file
+ * @param size the size of the application in bytes
+ * @retval TRANSFER_OK if the page is stored, TRANSFER_CMD_FAIL if not.
+ */
+TRANSFER_STATUS Transfer_StorePage(TRANSFER_OPCODE op, uint8_t id, uint8_t *page,
+                                   uint32_t i, uint32_t size) {
+  if (i == 0 && (FS_ChkImage((uint32_t *)page, size) != FS_OK
+        || (op == RCV_APP_LZ && ((FS_LZHeader *)page)->magic != FS_LZ_MAGIC)))
+    return TRANSFER_CMD_FAIL;
+  if (FS_WriteFilePage(id, (uint32_t *)page, i) != FS_OK
+        || (i == FS_RoundPageUp(size)-1 && FS_SealFile(id) != FS_OK))
+    return TRANSFER_CMD_FAIL;
+  return TRANSFER_OK;
+}
+
+/**
+ * @brief Works out which chunks make up a page of a stream.
+ * @param page the page's number in the file
+ * @param numChunks the number of chunks in the file
+ * @retval a bit set for each of the page's chunks, in the order they come.
+ */
+uint8_t Transfer_PageMask(uint32_t page, uint16_t numChunks) {
+  uint32_t n = numChunks - page*TRANSFER_PAGE_CHUNKS;
+  if (n > TRANSFER_PAGE_CHUNKS)
+    n = TRANSFER_PAGE_CHUNKS;
+  return (1 << n) - 1;
+}
+
+/**
+ * @brief Answers a chunk of a stream.
+ * @param reply TRANSFER_ACK or TRANSFER_NAK
+ * @param seq the chunk's sequence number, or TRANSFER_DONE
+ * @retval None.
+ */
+void Transfer_SendSeq(uint8_t reply, uint16_t seq) {
+  USB_Send(reply);
+  USB_Send(seq & 0xFF);
+  USB_Send(seq >> 8);
+}
+
 /**
  * @brief Receives an app. id from a sender and removes it from the fs.
  * @retval TRANSFER_OK if the receive and delete succeed.
@@ -244,4 +846,80 @@ TRANSFER_STATUS Cmd_RUN_APP(void) {
   
   return TRANSFER_CMD_FAIL; //Shouldn't ever get here.
 }
+/**
+ * @brief  Sends a 32-bit word LSB first and adds its bytes to a checksum.
+ * @param  word the word to send
+ * @param  checksum the running checksum to update
+ * @retval None.
+ */
+void Transfer_SendWord(uint32_t word, uint8_t *checksum) {
+  uint8_t i;
+  for (i = 0; i < 4; i++) {
+    USB_Send(word & 0xFF);
+    *checksum += word & 0xFF;
+    word >>= 8;
+  }
+}
+
+/**
+ * @brief  Receives a 32-bit word LSB first and adds its bytes to a checksum.
+ * @param  checksum the running checksum to update
+ * @retval the word.
+ */
+uint32_t Transfer_ReceiveWord(uint8_t *checksum) {
+  uint32_t word = 0;
+  uint8_t i, byte;
+  for (i = 0; i < 4; i++) {
+    byte = USB_Receive();
+    *checksum += byte;
+    word |= (uint32_t)byte << (8*i);
+  }
+  return word;
+}
+
+/**
+ * @brief  Reports the heap and stack statistics to the host.
+ *         Sends the MemHeapStats words up to num_fails followed by the
+ *         MemStackStats words, then a checksum byte.
+ * @retval TRANSFER_OK.
+ */
+TRANSFER_STATUS Cmd_MEM_STATS(void) {
+  MemHeapStats heap;
+  MemStackStats stack;
+  uint8_t checksum = 0;
+
+  Blox_Mem_GetHeapStats(&heap);
+  Blox_Mem_GetStackStats(&stack);
+  Transfer_SendWord(heap.size, &checksum);
+  Transfer_SendWord(heap.current, &checksum);
+  Transfer_SendWord(heap.peak, &checksum);
+  Transfer_SendWord(heap.largest_free, &checksum);
+  Transfer_SendWord(heap.num_allocs, &checksum);
+  Transfer_SendWord(heap.num_fails, &checksum);
+  Transfer_SendWord(stack.size, &checksum);
+  Transfer_SendWord(stack.peak, &checksum);
+  Transfer_SendWord(stack.main_peak, &checksum);
+  Transfer_SendWord(stack.isr_peak, &checksum);
+  USB_Send(0xFF-checksum);
+
+  return TRANSFER_OK;
+}
+
+/**
+ * @brief  Reports how many times each page of flash has been erased.
+ *         Sends the number of pages, a word per page from the start of
+ *         flash, then a checksum byte.
+ * @retval TRANSFER_OK.
+ */
+TRANSFER_STATUS Cmd_WEAR_STATS(void) {
+  uint8_t checksum = 0;
+  uint32_t i;
+
+  Transfer_SendWord(FLASH_NUM_PAGES, &checksum);
+  for (i = 0; i < FLASH_NUM_PAGES; i++)
+    Transfer_SendWord(Blox_Flash_GetPageErases(MEM_MAP_START + i*PAGE_SIZE), &checksum);
+  USB_Send(0xFF-checksum);
+
+  return TRANSFER_OK;
+}
 /** @} */
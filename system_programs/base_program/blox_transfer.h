@@ -32,6 +32,7 @@
 #include "blox_system.h"
 #include "blox_usb.h"
 #include "blox_filesystem.h"
+#include "blox_mem.h"
 
 /**
  * @ingroup base_transfer
@@ -39,6 +40,14 @@
  */
 #define TRANSFER_ACK 0x79
 #define TRANSFER_NAK 0x1F
+#define TRANSFER_SYNC 0xA5        /**< Starts each chunk of a stream */
+#define TRANSFER_CHUNK 256        /**< Bytes of data in a chunk of a stream */
+#define TRANSFER_PAGE_CHUNKS (PAGE_SIZE/TRANSFER_CHUNK)
+#define TRANSFER_WINDOW TRANSFER_PAGE_CHUNKS  /**< Most chunks the sender leaves unanswered */
+#define TRANSFER_RING 4096        /**< Bytes of the DMA ring, more than a window of chunks */
+#define TRANSFER_DONE 0xFFFF      /**< Sequence number that ends a stream */
+#define TRANSFER_PACKED 0x8000    /**< Set in a chunk's sequence number when its data is compressed */
+#define TRANSFER_MANIFEST_MAX 16  /**< Most apps a SYNC_APPS manifest lists */
 
 /**
  * @brief Enum of the possible transfer statuses
@@ -58,9 +67,28 @@ typedef enum {
 	DEL_APP,
 	LST_APPS,
 	RUN_APP,
+  MEM_STATS,
+  RCV_APP_AT,
+  RCV_APP_LZ,
+  WEAR_STATS,
+  RCV_STREAM,
+  RESUME,
+  SYNC_APPS,
   OP_TOP
 } TRANSFER_OPCODE;
 
+/**
+ * @brief An app listed in a SYNC_APPS manifest
+ */
+typedef struct {
+  uint8_t op;                       /**< the RCV_APP* opcode it is uploaded as */
+  char name[FS_FILE_MAX_NAME_LEN];  /**< the name it is stored under */
+  uint32_t size;                    /**< the size of the image in bytes */
+  uint32_t crc;                     /**< Blox_CRC_Calc of the image zero-padded to whole pages */
+  uint32_t *addr;                   /**< the link address for RCV_APP_AT, NULL otherwise */
+  uint8_t have;                     /**< TRUE if the Blox already holds the image */
+} TransferEntry;
+
 void Transfer_Init(void);
 void Transfer_Slave(void);
 /** @} */
@@ -41,6 +41,7 @@
 #include "blox_led.h"
 #include "blox_base_ui.h"
 #include "blox_gesture.h"
+#include "blox_event.h"
 #include "string.h"
 #include "stdio.h"
 
@@ -54,7 +55,20 @@
 #define TEXT_LOCATION_LEFT_ALIGNED   16
 #define TEXT_LOCATION_OFFSET         14
 
+/**
+ * @brief The role request Base_RoleTask is answering: its opcode, EMPTY
+ *        when there is none, who sent it and the program it names.
+ */
+static volatile uint8_t role_request = EMPTY;
+static uint32_t role_src;
+static char role_name[FS_FILE_MAX_NAME_LEN];
+static BloxPT role_pt;
+
 void Base_RX(BloxFrame *frame);
+void Base_XBee_Handler(BloxEvent *event);
+void Base_Gesture_Handler(BloxEvent *event);
+PT_THREAD(Base_RoleTask(BloxPT *pt));
+void Base_RoleIdle(void);
 
 void Base_UI_MainMenu(void);
 void Base_UI_ApplicationsMenu(void);
@@ -72,53 +86,76 @@ void Base_UI_Loading(void);
  */
 int main(void)
 {
+  BloxPT oled_pt;
+  
   if (FS_GetAppFlag() == 1) {
-    FS_RunStage();
+    FS_RunApp();
   }
 
   Blox_System_Init();
+  SysTick_Init();
+  //Start the OLED's 2 second reset; the rest of init runs while it waits.
+  PT_INIT(&oled_pt);
+  Blox_OLED_InitTask(&oled_pt);
   FS_Init(1);
   Blox_LED_Init();
+  Blox_Event_Init();
+  Blox_Event_Register(EVENT_XBEE_FRAME, EVENT_PRIO_HIGH, &Base_XBee_Handler);
+  Blox_Event_Register(EVENT_GESTURE, EVENT_PRIO_NORMAL, &Base_Gesture_Handler);
+  Blox_Event_Register_Idle(&FS_PreErase);
+  Blox_Event_Register_Idle(&Blox_XBee_Idle);
+  PT_INIT(&role_pt);
+  Blox_Event_Register_Idle(&Base_RoleIdle);
   Blox_XBee_Init();
-  Blox_XBee_Register_RX_IRQ(&Base_RX);
+  Blox_XBee_Register_RX_IRQ(&Blox_Event_XBeeSource);
   Blox_XBee_Enable_RX_IRQ();
-  SysTick_Init();
   USB_Init();
-  Blox_OLED_Init();
   Blox_Gesture_Init();
+  Blox_Gesture_Register_IRQ(&Blox_Event_GestureSource);
+  while (PT_SCHEDULE(Blox_OLED_InitTask(&oled_pt))) ;
   
   Base_UI_MainMenu();
 
-  while(1) {
-    static uint32_t old_north_time, old_south_time, old_east_time, old_west_time;
+  Blox_Event_Run();
+}
 
-    if(Blox_Gesture_GetGesture(TOUCH_NORTH_ID) == TOUCH_GESTURE_TAP &&
-       Blox_Gesture_GetGestureTime(TOUCH_NORTH_ID) != old_north_time) {
-      Blox_UI_SelectEntryAbove();
-      old_north_time = Blox_Gesture_GetGestureTime(TOUCH_NORTH_ID);
-      Blox_LED_Toggle(LED_NORTH);
-    }
-    if(Blox_Gesture_GetGesture(TOUCH_SOUTH_ID) == TOUCH_GESTURE_TAP &&
-       Blox_Gesture_GetGestureTime(TOUCH_SOUTH_ID) != old_south_time) {
-      Blox_UI_SelectEntryBelow();
-      old_south_time = Blox_Gesture_GetGestureTime(TOUCH_SOUTH_ID);
-      Blox_LED_Toggle(LED_SOUTH);
-    }
-    if(Blox_Gesture_GetGesture(TOUCH_EAST_ID) == TOUCH_GESTURE_TAP &&
-       Blox_Gesture_GetGestureTime(TOUCH_EAST_ID) != old_east_time) {
-      Blox_UI_RunEntry();
-      old_east_time = Blox_Gesture_GetGestureTime(TOUCH_EAST_ID);
-      Blox_LED_Toggle(LED_EAST);
-    }
-    if(Blox_Gesture_GetGesture(TOUCH_WEST_ID) == TOUCH_GESTURE_TAP &&
-       Blox_Gesture_GetGestureTime(TOUCH_WEST_ID) != old_west_time) {
-      Blox_UI_Back();
-      old_west_time = Blox_Gesture_GetGestureTime(TOUCH_WEST_ID);
-      Blox_LED_Toggle(LED_WEST);
-    }
+/**
+ * @brief Moves through the menus on taps.
+ * @param event the EVENT_GESTURE event
+ * @retval None
+ */
+void Base_Gesture_Handler(BloxEvent *event) {
+  if(event->arg != TOUCH_GESTURE_TAP)
+    return;
+  switch(event->src) {
+  case TOUCH_NORTH_ID:
+    Blox_UI_SelectEntryAbove();
+    Blox_LED_Toggle(LED_NORTH);
+    break;
+  case TOUCH_SOUTH_ID:
+    Blox_UI_SelectEntryBelow();
+    Blox_LED_Toggle(LED_SOUTH);
+    break;
+  case TOUCH_EAST_ID:
+    Blox_UI_RunEntry();
+    Blox_LED_Toggle(LED_EAST);
+    break;
+  case TOUCH_WEST_ID:
+    Blox_UI_Back();
+    Blox_LED_Toggle(LED_WEST);
+    break;
   }
 }
 
+/**
+ * @brief Handles XBee frames from the event loop rather than the interrupt.
+ * @param event the EVENT_XBEE_FRAME event
+ * @retval None
+ */
+void Base_XBee_Handler(BloxEvent *event) {
+  Base_RX((BloxFrame *)event->data);
+}
+
 /**
  * @brief Draws the main menu
  * @retval None
@@ -269,7 +306,10 @@ void Base_UI_Loading(void) {
 }
 
 /**
- * @brief Listens for other Blox asking for new participants. 
+ * @brief Listens for other Blox asking for new participants. Requests that
+ *        need a reply are left for Base_RoleTask, so the event loop is not
+ *        held up for the hold period. Requests that come in while it is
+ *        busy are dropped; the sender repeats them for a hold period.
  * @retval None
  */
 void Base_RX(BloxFrame *frame) {
@@ -281,22 +321,15 @@ void Base_RX(BloxFrame *frame) {
       case PROG_QUERY:  
         Blox_LED_Toggle(LED1);
         //See if I have this application
-        if (FS_GetFileFromName(((QueryFrame *)&(rFrame->data))->name) != NULL) {
-          RoleFrame respFrame;
-          SysTick_Wait(XBEE_HOLD_PERIOD); //Wait for hold period.
-          respFrame.opcode = PROG_ACK;
-          Blox_LED_Toggle(LED2);
-          Blox_XBee_Send_Period((uint8_t *)&respFrame, sizeof(RoleFrame), FRAME_TYPE_ROLE, frame->src_id, XBEE_HOLD_PERIOD);
-        }
-        break;
+        if (FS_GetFileFromName(((QueryFrame *)&(rFrame->data))->name) == NULL)
+          break;
+        //Fall through, it is answered like a PROG_START.
       case PROG_START:
-      {
-        //Get the file
-        FS_File *file;
-        SysTick_Wait(XBEE_HOLD_PERIOD);
-        file = FS_GetFileFromName(((QueryFrame *)&(rFrame->data))->name);
-        FS_RunFile(file->id);
-      } 
+        if (role_request != EMPTY)
+          break;
+        role_src = frame->src_id;
+        memcpy(role_name, ((QueryFrame *)&(rFrame->data))->name, FS_FILE_MAX_NAME_LEN);
+        role_request = rFrame->opcode;
         break;
       case PARENT_QUERY:
         Blox_LED_Toggle(LED2);
@@ -305,4 +338,46 @@ void Base_RX(BloxFrame *frame) {
     }
   }
 }
+
+/**
+ * @brief Answers the request Base_RX left: after the hold period, either
+ *        ACKs a PROG_QUERY for a hold period or runs the program a
+ *        PROG_START names.
+ * @param pt the task's state
+ * @retval the PT_STATUS of the task, which never ends.
+ */
+PT_THREAD(Base_RoleTask(BloxPT *pt)) {
+  static RoleFrame respFrame;
+  FS_File *file;
+  
+  PT_BEGIN(pt);
+  while (1) {
+    PT_WAIT_UNTIL(pt, role_request != EMPTY);
+    PT_WAIT_MS(pt, XBEE_HOLD_PERIOD); //Wait for hold period.
+    if (role_request == PROG_QUERY) {
+      respFrame.opcode = PROG_ACK;
+      Blox_LED_Toggle(LED2);
+      PT_TIMER_SET(pt, XBEE_HOLD_PERIOD);
+      while (!PT_EXPIRED(pt)) {
+        //Keeps the transmit queue full; Blox_XBee_Idle drains it.
+        Blox_XBee_SendAsync((uint8_t *)&respFrame, ROLE_OPCODE_LEN, FRAME_TYPE_ROLE, role_src, NULL, NULL);
+        PT_YIELD(pt);
+      }
+    } else {
+      file = FS_GetFileFromName(role_name);
+      if (file != NULL)
+        FS_RunFile(file->id);
+    }
+    role_request = EMPTY;
+  }
+  PT_END(pt);
+}
+
+/**
+ * @brief Steps Base_RoleTask from the event loop's idle hooks.
+ * @retval None
+ */
+void Base_RoleIdle(void) {
+  Base_RoleTask(&role_pt);
+}
 /** @} */